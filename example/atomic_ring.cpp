@@ -0,0 +1,25 @@
+#include "../include/ir/quiet_atomic_ring.h"
+#include <stdio.h>
+#include <thread>
+
+int main()
+{
+	ir::QuietAtomicRing<int> ring(16);
+	std::thread producer([&ring]()
+	{
+		for (int i = 1; i <= 1000; i++)
+		{
+			while (!ring.write(i)) std::this_thread::yield();
+		}
+	});
+	int sum = 0, count = 0, buffer[8];
+	while (count < 1000)
+	{
+		size_t n = ring.read(8, buffer);
+		for (size_t i = 0; i < n; i++) sum += buffer[i];
+		count += (int)n;
+	}
+	producer.join();
+	printf("Sum(1..1000) = %d %s\n", sum, sum == 500500 ? "Test: ok" : "Test: error");
+	return 0;
+}
@@ -8,13 +8,33 @@
 	Reinventing bicycles since 2020
 */
 
+#define IR_INCLUDE 'a'
+#define IR_PARALLEL_IMPLEMENTATION 'o'
 #include "../include/ir/matrix.h"
+#include "../include/ir/parallel.h"
+#include <stdio.h>
+#include <math.h>
 #include <time.h>
+#include <chrono>
 
 #define TYPE float
 #define SIZE 1000
 #define ALIGN 16
 
+struct Product
+{
+	ir::Parallel *pool;
+	ir::Matrix<TYPE, ALIGN> *result;
+	const ir::Matrix<TYPE, ALIGN> *a;
+	const ir::Matrix<TYPE, ALIGN> *b;
+};
+
+void product(const void *user)
+{
+	const Product *p = (const Product*)user;
+	p->result->matrix_product(p->a, p->b, p->pool);
+}
+
 int _main()
 {
 	ir::Matrix<TYPE, ALIGN> a(SIZE, SIZE);
@@ -28,6 +48,9 @@ int _main()
 	ir::Matrix<TYPE, ALIGN> c(SIZE, SIZE);
 	if (!c.ok()) return 1;
 
+	ir::Matrix<TYPE, ALIGN> d(SIZE, SIZE);
+	if (!d.ok()) return 1;
+
 	//Scalar code:
 	clock_t cloc = clock();
 	for (size_t row = 0; row < SIZE; row++)
@@ -44,10 +67,66 @@ int _main()
 	}
 	printf("Scalar code done in %f seconds\n", (float)(clock() - cloc) / CLOCKS_PER_SEC);
 
-	//(Theoretically) vectorized code:
+	//Blocked vectorized code:
 	cloc = clock();
-	c.matrix_product_transposed(&a, &b);
-	printf("Vectrized code done in %f seconds\n", (float)(clock() - cloc) / CLOCKS_PER_SEC);
+	d.matrix_product_transposed(&a, &b);
+	float time = (float)(clock() - cloc) / CLOCKS_PER_SEC;
+	printf("Vectorized code done in %f seconds, %f GFLOPS\n", time, 2.0 * SIZE * SIZE * SIZE / time / 1e9);
+	TYPE error = 0.0;
+	for (size_t row = 0; row < SIZE; row++)
+	{
+		for (size_t column = 0; column < SIZE; column++) error = fmax(error, fabs(c(row, column) - d(row, column)));
+	}
+	printf("Maximal error %f %s\n", error, error < 1e-3 ? "Test: ok" : "Test: error");
+
+	//Non-transposed product, b is transposed manually
+	for (size_t row = 0; row < SIZE; row++)
+	{
+		for (size_t column = 0; column < SIZE; column++) a(row, column) = b(column, row);
+	}
+	d.matrix_product(&c, &a);
+	cloc = clock();
+	error = 0.0;
+	for (size_t row = 0; row < SIZE; row++)
+	{
+		for (size_t column = 0; column < SIZE; column++)
+		{
+			TYPE sum = 0.0;
+			for (size_t i = 0; i < SIZE; i++) sum += c(row, i) * b(column, i);
+			error = fmax(error, fabs(sum - d(row, column)));
+		}
+	}
+	printf("Maximal error of non-transposed product %f %s\n", error, error < 1e-2 ? "Test: ok" : "Test: error");
+
+	//Multithreaded code, clock() would count time of all threads
+	ir::Parallel parallel;
+	if (!parallel.init(ir::Parallel::processor_count())) return 1;
+	ir::Matrix<TYPE, ALIGN> e(SIZE, SIZE);
+	if (!e.ok()) return 1;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	e.matrix_product(&c, &a, &parallel);
+	time = std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count();
+	printf("Multithreaded code with %u threads done in %f seconds, %f GFLOPS\n", parallel.n(), time, 2.0 * SIZE * SIZE * SIZE / time / 1e9);
+	e.subtract(&d, &parallel);
+	error = 0.0;
+	for (size_t row = 0; row < SIZE; row++)
+	{
+		for (size_t column = 0; column < SIZE; column++) error = fmax(error, fabs(e(row, column)));
+	}
+	printf("Maximal difference of multithreaded product %f %s\n", error, error < 1e-3 ? "Test: ok" : "Test: error");
+
+	//Product called from task of the pool runs in thread of the task
+	Product task = { &parallel, &e, &c, &a };
+	parallel.spawn(product, &task);
+	parallel.sync();
+	e.subtract(&d, &parallel);
+	error = 0.0;
+	for (size_t row = 0; row < SIZE; row++)
+	{
+		for (size_t column = 0; column < SIZE; column++) error = fmax(error, fabs(e(row, column)));
+	}
+	printf("Maximal difference of product in task %f %s\n", error, error < 1e-3 ? "Test: ok" : "Test: error");
+	parallel.finalize();
 
 	getchar();
 	return 0;
@@ -1,13 +1,17 @@
 #define IR_INCLUDE 'a'
 #include "../include/ir/n2st_database.h"
 #include <stdio.h>
+#ifndef _WIN32
+	#include <unistd.h>
+	#include <sys/wait.h>
+#endif
 #include <string.h>
 
 ir::N2STDatabase *database;
 
 void test_insert(ir::uint32 key, const char *data, ir::Database::insert_mode mode, ir::ec rightcode)
 {
-	printf("Adding key = '%i', data = '%s'\n", key, data);
+	printf("Adding key = '%u', data = '%s'\n", key, data);
 	ir::Block bdata(data, strlen(data) + 1);
 	ir::ec code = database->insert(key, bdata, mode);
 	printf("Errorcode : %u\n", (unsigned int)code);
@@ -16,7 +20,7 @@ void test_insert(ir::uint32 key, const char *data, ir::Database::insert_mode mod
 
 void test_delete(ir::uint32 key, ir::Database::delete_mode mode, ir::ec rightcode)
 {
-	printf("Deleting key = '%i'\n", key);
+	printf("Deleting key = '%u'\n", key);
 	ir::ec code = database->delet(key, mode);
 	printf("Result : %u\n", (unsigned int)code);
 	printf("Test: %s\n\n", code == rightcode ? "ok" : "error");
@@ -24,7 +28,7 @@ void test_delete(ir::uint32 key, ir::Database::delete_mode mode, ir::ec rightcod
 
 void test_read(ir::uint32 key, const char *rightdata, ir::ec rightcode)
 {
-	printf("Reading key = '%i'\n", key);
+	printf("Reading key = '%u'\n", key);
 	ir::Block result;
 	ir::ec code = database->read(key, &result);
 	printf("Result : %u\n", (unsigned int)code);
@@ -35,6 +39,42 @@ void test_read(ir::uint32 key, const char *rightdata, ir::ec rightcode)
 	printf("Test: %s\n\n", testok ? "ok" : "error");
 }
 
+#ifndef _WIN32
+//Reader in child process sees records inserted before and after it attached while writer in this process is idle
+bool test_processes()
+{
+	int ready[2], inserted[2];
+	if (pipe(ready) != 0) return false;
+	if (pipe(inserted) != 0) { close(ready[0]); close(ready[1]); return false; }
+	bool ok = database->insert(9, ir::Block("Pinkie Pie", 11)) == ir::ec::ok;
+	fflush(stdout);
+	pid_t pid = fork();
+	if (pid == 0)
+	{
+		ir::ec code;
+		ir::N2STDatabase reader(SS("database"), ir::Database::create_mode::read, &code);
+		ir::Block result;
+		char c = 0;
+		bool childok = code == ir::ec::ok && reader.read(9, &result) == ir::ec::ok && strcmp((const char*)result.data(), "Pinkie Pie") == 0;
+		childok = write(ready[1], &c, 1) == 1 && childok;
+		childok = read(inserted[0], &c, 1) == 1 && childok;
+		childok = childok && reader.read(10, &result) == ir::ec::ok && strcmp((const char*)result.data(), "Gummy") == 0;
+		_exit(childok ? 0 : 1);
+	}
+	char c = 0;
+	ok = ok && pid > 0 && read(ready[0], &c, 1) == 1;
+	ok = ok && database->insert(10, ir::Block("Gummy", 6)) == ir::ec::ok;
+	ok = ok && write(inserted[1], &c, 1) == 1;
+	close(ready[0]);
+	close(ready[1]);
+	close(inserted[0]);
+	close(inserted[1]);
+	int status = 1;
+	if (pid > 0) waitpid(pid, &status, 0);
+	return ok && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+#endif
+
 int main()
 {
 	ir::ec code = ir::ec::ok;
@@ -56,6 +96,73 @@ int main()
 		test_insert(7, "Applejack", ir::Database::insert_mode::existing, ir::ec::key_not_exists);
 		test_insert(7, "Applejack", ir::Database::insert_mode::not_existing, ir::ec::ok);
 		test_insert(7, "Applejack", ir::Database::insert_mode::not_existing, ir::ec::key_already_exists);
+
+		printf("Appending to key = '7', value is grown in place\n");
+		ir::uint32 filesize = database->get_file_size();
+		code = database->append(7, ir::Block(" and Big McIntosh", 18), 64);
+		ir::Block head, tail;
+		if (code == ir::ec::ok) code = database->read_range(7, 0, 10, &head);
+		if (code == ir::ec::ok) code = database->read_range(7, 10, 18, &tail);
+		printf("Test: %s\n\n", code == ir::ec::ok && database->get_file_size() == filesize - 10 + 28 + 64
+			&& memcmp(head.data(), "Applejack", 10) == 0 && memcmp(tail.data(), " and Big McIntosh", 18) == 0 ? "ok" : "error");
+		printf("Writing range of key = '7'\n");
+		code = database->write_range(7, 9, ir::Block(" ", 1));
+		printf("Test: %s\n\n", code == ir::ec::ok ? "ok" : "error");
+		test_read(7, "Applejack  and Big McIntosh", ir::ec::ok);
+
+		printf("Appending to key = '1', value is moved\n");
+		code = database->append(1, ir::Block(" Cutie", 7));
+		if (code == ir::ec::ok) code = database->read_range(1, 0, 20, &head);
+		printf("Test: %s\n\n", code == ir::ec::ok && memcmp(head.data(), "Sweety Belle\0 Cutie", 20) == 0 ? "ok" : "error");
+
+		printf("Inserting and reading empty value of key = '5'\n");
+		ir::Block empty;
+		code = database->insert(5, ir::Block("", 0));
+		if (code == ir::ec::ok) code = database->read(5, &empty);
+		printf("Test: %s\n\n", code == ir::ec::ok && empty.size() == 0 ? "ok" : "error");
+
+		printf("Switching to sparse mode\n");
+		code = database->set_sparse_mode(true);
+		printf("Test: %s\n\n", code == ir::ec::ok ? "ok" : "error");
+		test_read(7, "Applejack  and Big McIntosh", ir::ec::ok);
+		test_insert(3000000000, "Twilight Sparkle", ir::Database::insert_mode::not_existing, ir::ec::ok);
+		test_delete(8, ir::Database::delete_mode::existing, ir::ec::ok);
+		test_read(8, nullptr, ir::ec::key_not_exists);
+		test_read(3000000000, "Twilight Sparkle", ir::ec::ok);
+		printf("Table size : %u\n", database->get_table_size());
+		printf("Test: %s\n\n", database->get_table_size() < 64 ? "ok" : "error");
+
+		printf("Inserting and deleting different keys\n");
+		for (ir::uint32 i = 0; i < 1000 && code == ir::ec::ok; i++)
+		{
+			code = database->insert(4000000000 + i, ir::Block("Rarity", 7));
+			if (code == ir::ec::ok) code = database->delet(4000000000 + i);
+		}
+		printf("Table size : %u\n", database->get_table_size());
+		printf("Test: %s\n\n", code == ir::ec::ok && database->get_table_size() < 64 ? "ok" : "error");
+
+		#ifndef _WIN32
+			printf("Reading in other process while writer is idle\n");
+			database->set_ram_mode(false, false);
+			printf("Test: %s\n\n", test_processes() ? "ok" : "error");
+		#endif
+
+		printf("Reopening with access log\n");
+		delete database;
+		database = new ir::N2STDatabase(SS("database"), ir::Database::create_mode::read, &code);
+		if (code == ir::ec::ok) code = database->hint(ir::Database::access_pattern::random);
+		if (code == ir::ec::ok) code = database->set_access_log(true);
+		printf("Test: %s\n\n", code == ir::ec::ok ? "ok" : "error");
+		test_read(7, "Applejack  and Big McIntosh", ir::ec::ok);
+
+		printf("Reopening with warm-up\n");
+		delete database;
+		database = new ir::N2STDatabase(SS("database"), ir::Database::create_mode::read, &code);
+		if (code == ir::ec::ok) code = database->warm_up(true);
+		printf("Test: %s\n\n", code == ir::ec::ok ? "ok" : "error");
+		test_read(3000000000, "Twilight Sparkle", ir::ec::ok);
+		code = database->read(5, &empty);
+		printf("Test: %s\n\n", code == ir::ec::ok && empty.size() == 0 ? "ok" : "error");
 	}
 	delete database;
 	getchar();
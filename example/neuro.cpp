@@ -9,10 +9,10 @@ int main()
 {
 	//simple net trying to learn xor operation
 
-	ir::uint32 lays[3] = { 2, 2, 1 };
+	ir::uint32 lays[3] = { 2, 4, 1 };
 	ir::Neuro<double> net(3, lays, 0.5, nullptr);
 	
-	net.set_coefficient(1.0);
+	net.set_coefficient(0.1);
 	
 	for (size_t i = 0; i < 100000; i++)
 	{
@@ -30,5 +30,66 @@ int main()
 	}
 
 	net.save(SS("xor.inr"));
+
+	//all four cases at once as mini-batch, mean of four corrections allows larger coefficient
+	if (net.set_batch(4) != ir::ec::ok) return 1;
+	net.set_coefficient(0.5);
+	for (ir::uint32 s = 0; s < 4; s++)
+	{
+		net.get_input()->at(s, 0) = (s & 1) ? 1 : -1;
+		net.get_input()->at(s, 1) = (s & 2) ? 1 : -1;
+		net.get_goal()->at(s, 0) = (((s & 1) != 0) ^ ((s & 2) != 0)) ? 1 : -1;
+	}
+
+	//few more epochs of training, samples are distributed between threads
+	ir::Parallel parallel;
+	if (!parallel.init(ir::Parallel::processor_count())) return 1;
+	if (net.set_parallel(&parallel) != ir::ec::ok) return 1;
+	for (size_t i = 0; i < 1000; i++)
+	{
+		net.forward();
+		net.backward();
+	}
+	net.set_parallel(nullptr);
+	parallel.finalize();
+	for (ir::uint32 s = 0; s < 4; s++)
+	{
+		const double output = net.get_output()->at(s, 0);
+		const double error = output - net.get_goal()->at(s, 0);
+		printf("batch %i %i -> %lf %s\n", (s & 1) ? 1 : -1, (s & 2) ? 1 : -1, output, error > -0.1 && error < 0.1 ? "Test: ok" : "Test: error");
+	}
+
+	//inference in own buffers, network is not modified and may be shared between threads
+	ir::Neuro<double>::Inference inference;
+	if (inference.init(&net, 1) != ir::ec::ok) return 1;
+	inference.get_input()->at(0, 0) = 1;
+	inference.get_input()->at(0, 1) = -1;
+	net.forward(&inference);
+	printf("inference 1 -1 -> %lf\n", inference.get_output()->at(0, 0));
+
+	//inference with 8-bit weights
+	ir::Int8Neuro<double> quantized;
+	if (quantized.init(&net) != ir::ec::ok) return 1;
+	quantized.get_input()->at(0, 0) = 1;
+	quantized.get_input()->at(0, 1) = -1;
+	quantized.forward();
+	printf("int8 inference 1 -1 -> %lf\n", quantized.get_output()->at(0, 0));
+
+	//inference with 16-bit weights
+	ir::HalfNeuro<double> compressed;
+	if (compressed.init(&net) != ir::ec::ok) return 1;
+	compressed.get_input()->at(0, 0) = 1;
+	compressed.get_input()->at(0, 1) = -1;
+	compressed.forward();
+	printf("fp16 inference 1 -1 -> %lf\n", compressed.get_output()->at(0, 0));
+
+	//saved network with weights mapped from file
+	ir::ec code;
+	ir::Neuro<double> mapped(SS("xor.inr"), true, &code);
+	if (code != ir::ec::ok) return 1;
+	mapped.get_input()->at(0, 0) = 1;
+	mapped.get_input()->at(0, 1) = -1;
+	mapped.forward();
+	printf("mapped 1 -1 -> %lf\n", mapped.get_output()->at(0, 0));
 	getchar();
 }
\ No newline at end of file
@@ -3,13 +3,200 @@
 #include "../include/ir/parallel.h"
 #include <stdio.h>
 
+struct Fibonacci
+{
+	ir::Parallel *pool;
+	ir::uint32 n;
+	ir::uint64 *result;
+};
+
+void fibonacci(const void *user)
+{
+	const Fibonacci *f = (const Fibonacci*)user;
+	if (f->n < 2) { *f->result = f->n; return; }
+	ir::uint64 result1, result2;
+	Fibonacci f1 = { f->pool, f->n - 1, &result1 };
+	Fibonacci f2 = { f->pool, f->n - 2, &result2 };
+	f->pool->spawn(fibonacci, &f1);
+	f->pool->spawn(fibonacci, &f2);
+	f->pool->sync();
+	*f->result = result1 + result2;
+}
+
+void sum(const void *user, size_t begin, size_t end, void *accumulator)
+{
+	const ir::uint32 *array = (const ir::uint32*)user;
+	for (size_t i = begin; i < end; i++) *(ir::uint64*)accumulator += array[i];
+}
+
+void add(void *accumulator, const void *other)
+{
+	*(ir::uint64*)accumulator += *(const ir::uint64*)other;
+}
+
+struct Nested
+{
+	ir::Parallel *pool;
+	const ir::uint32 *array;
+	ir::uint64 *total;
+};
+
+void nested_sum(const void *user)
+{
+	const Nested *n = (const Nested*)user;
+	*n->total = 0;
+	n->pool->parallel_reduce(0, 1000, 0, n->array, sum, add, n->total, sizeof(*n->total));
+}
+
+void nested_fill(const void *user)
+{
+	const Nested *n = (const Nested*)user;
+	n->pool->parallel_for(0, 1000, 10, n->array, [](const void *user, ir::uint32, size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++) ((ir::uint32*)user)[i] = (ir::uint32)(999 - i);
+	});
+}
+
+void *produce(const void *user)
+{
+	ir::uint32 *next = (ir::uint32*)user;
+	if (*next == 1000) return nullptr;
+	return &((ir::uint32*)user)[1 + (*next)++];
+}
+
+void *square(const void *, void *item)
+{
+	*(ir::uint32*)item *= *(ir::uint32*)item;
+	return item;
+}
+
+void *odd(const void *, void *item)
+{
+	return (*(ir::uint32*)item % 2 == 1) ? item : nullptr;
+}
+
+void fail(const void *user)
+{
+	((ir::Parallel*)user)->fail(ir::ec::invalid_input);
+}
+
+struct Search
+{
+	ir::Parallel *pool;
+	const ir::uint32 *array;
+	ir::uint32 value;
+	std::atomic<size_t> *found;
+};
+
+void search(const void *user, ir::uint32, size_t begin, size_t end)
+{
+	const Search *s = (const Search*)user;
+	for (size_t i = begin; i < end; i++)
+	{
+		if (s->array[i] == s->value)
+		{
+			*s->found = i;
+			s->pool->cancel();
+		}
+		if (s->pool->cancelled()) return;
+	}
+}
+
 int _main()
 {
-	ir::Parallel::init(8);
-	ir::Parallel::parallel(nullptr, [](const void *, ir::uint32 id, ir::uint32 n)
+	printf("Processors: %u, NUMA nodes: %u\n", ir::Parallel::processor_count(), ir::Parallel::node_count());
+	ir::Parallel parallel;
+	parallel.init(8);
+	parallel.set_affinity(ir::Parallel::affinity::nodes);
+	parallel.parallel(nullptr, [](const void *, ir::uint32 id, ir::uint32 n)
 	{
 		printf("Process %u here!\n", id);
 	});
+
+	ir::uint64 result;
+	Fibonacci f = { &parallel, 25, &result };
+	parallel.set_statistics(true);
+	parallel.set_trace(true);
+	parallel.spawn(fibonacci, &f);
+	parallel.sync();
+	printf("Fibonacci(25) = %llu %s\n", (unsigned long long)result, result == 75025 ? "Test: ok" : "Test: error");
+	ir::uint64 tasks = 0, steals = 0;
+	for (ir::uint32 i = 0; i < parallel.n(); i++)
+	{
+		ir::Parallel::Statistics statistics;
+		parallel.statistics(i, &statistics);
+		tasks += statistics.tasks;
+		steals += statistics.steals;
+	}
+	printf("Tasks executed: %llu, stolen: %llu\n", (unsigned long long)tasks, (unsigned long long)steals);
+	parallel.save_trace(SS("parallel_trace.json"));
+	parallel.set_trace(false);
+	parallel.set_statistics(false);
+
+	ir::uint32 array[1000];
+	ir::Parallel other;
+	other.init(4);
+	other.parallel_for(0, 1000, 10, array, [](const void *user, ir::uint32, size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++) ((ir::uint32*)user)[i] = (ir::uint32)i;
+	});
+	std::atomic<size_t> found(0);
+	Search s = { &other, array, 777, &found };
+	ir::Parallel::Job search_job;
+	other.parallel_for(0, 1000, 1, &s, search, &search_job);
+	printf("Found 777 at %u %s\n", (unsigned int)found, found == 777 && search_job.cancelled() ? "Test: ok" : "Test: error");
+	ir::Parallel::Job fail_job;
+	const bool failed = !other.parallel(&other, [](const void *user, ir::uint32 id, ir::uint32 n)
+	{
+		if (id == n - 1) ((ir::Parallel*)user)->fail(ir::ec::invalid_input);
+	}, &fail_job);
+	printf("Error %u %s\n", (unsigned int)fail_job.error(), failed && fail_job.error() == ir::ec::invalid_input ? "Test: ok" : "Test: error");
+	ir::Parallel::Job task_job;
+	other.spawn(fail, &other, &task_job);
+	other.sync();
+	printf("Task error %u %s\n", (unsigned int)task_job.error(), task_job.error() == ir::ec::invalid_input && other.parallel_for(0, 1000, 10, &s, search) ? "Test: ok" : "Test: error");
+	ir::uint64 total = 0;
+	parallel.parallel_reduce(0, 1000, 0, array, sum, add, &total, sizeof(total));
+	printf("Sum(0..999) = %llu %s\n", (unsigned long long)total, total == 499500 ? "Test: ok" : "Test: error");
+	ir::uint64 nested_total;
+	Nested nested = { &parallel, array, &nested_total };
+	parallel.spawn(nested_sum, &nested);
+	parallel.sync();
+	printf("Sum(0..999) in task = %llu %s\n", (unsigned long long)nested_total, nested_total == 499500 ? "Test: ok" : "Test: error");
+
+	ir::uint64 result1, result2;
+	Fibonacci f1 = { &parallel, 20, &result1 };
+	Fibonacci f2 = { &parallel, 21, &result2 };
+	ir::Parallel::Future future1, future2;
+	parallel.async(&future1, fibonacci, &f1);
+	future1.then(&future2, fibonacci, &f2);
+	printf("Main thread is free while Fibonacci is computed\n");
+	future2.wait();
+	printf("Fibonacci(20) + Fibonacci(21) = %llu %s\n", (unsigned long long)(result1 + result2), result1 + result2 == 17711 ? "Test: ok" : "Test: error");
+	ir::Parallel::Future future3;
+	parallel.async(&future3, fail, &parallel);
+	future3.wait();
+	printf("Future error %u %s\n", (unsigned int)future3.error(), future3.error() == ir::ec::invalid_input && future2.error() == ir::ec::ok ? "Test: ok" : "Test: error");
+	ir::uint32 reversed[1000];
+	Nested fill = { &parallel, reversed, nullptr };
+	ir::Parallel::Future future4;
+	parallel.async(&future4, nested_fill, &fill);
+	future4.wait();
+	bool filled = true;
+	for (ir::uint32 i = 0; i < 1000; i++) if (reversed[i] != 999 - i) filled = false;
+	printf("Loop in future %s\n", filled ? "Test: ok" : "Test: error");
+
+	ir::uint32 items[1001];
+	items[0] = 0;
+	for (ir::uint32 i = 0; i < 1000; i++) items[1 + i] = i;
+	ir::Parallel::Stage *stages[] = { square, odd };
+	parallel.pipeline(items, produce, stages, 2);
+	ir::uint64 squares = 0;
+	for (ir::uint32 i = 0; i < 1000; i++) squares += items[1 + i];
+	printf("Sum of squares(0..999) = %llu %s\n", (unsigned long long)squares, squares == 332833500 ? "Test: ok" : "Test: error");
+
+	other.finalize();
+	parallel.finalize();
 	printf("Finished\n");
 	getchar();
 	return 0;
@@ -18,4 +205,4 @@ int _main()
 int main()
 {
 	return _main();
-}
\ No newline at end of file
+}
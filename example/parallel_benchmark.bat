@@ -0,0 +1,22 @@
+@echo off
+rem Builds and runs parallel_benchmark.cpp with every implementation of ir::Parallel available on Windows
+rem Usage: parallel_benchmark [maximal number of threads]
+
+call :run %1
+call :run %1 /DIR_PARALLEL_IMPLEMENTATION='w'
+call :run %1 /DIR_PARALLEL_IMPLEMENTATION='o' /openmp
+
+del parallel_benchmark.exe
+del parallel_benchmark.obj
+pause
+exit /b
+
+:run
+	cl parallel_benchmark.cpp %2 %3 /O2 /W4 /EHsc /nologo
+	if ERRORLEVEL 1 (
+		echo Fail
+		exit /b 1
+	)
+	parallel_benchmark.exe %1
+	echo.
+	exit /b 0
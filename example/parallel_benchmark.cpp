@@ -0,0 +1,121 @@
+//Benchmark of ir::Parallel, compile once per implementation, see parallel_benchmark.sh and parallel_benchmark.bat
+//Usage: parallel_benchmark [maximal number of threads]
+#define IR_INCLUDE 'a'
+#include "../include/ir/parallel.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+
+#ifndef IR_PARALLEL_IMPLEMENTATION
+	#define IMPLEMENTATION "serial"
+#elif IR_PARALLEL_IMPLEMENTATION == 'w'
+	#define IMPLEMENTATION "windows"
+#elif IR_PARALLEL_IMPLEMENTATION == 'p'
+	#define IMPLEMENTATION "posix"
+#else
+	#define IMPLEMENTATION "openmp"
+#endif
+
+static const ir::uint32 dispatch_count = 10000;
+static const ir::uint32 repeat_count = 3;
+static const size_t loop_size = 0x400000;
+static const size_t imbalance_size = 0x2000;
+
+static double now()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+//Work of one element, cost is proportional to weight
+static double work(size_t i, size_t weight)
+{
+	double x = (double)i;
+	for (size_t j = 0; j < weight; j++) x = sqrt(x + 1.0);
+	return x;
+}
+
+static void uniform(const void *user, ir::uint32, size_t begin, size_t end)
+{
+	double *array = (double*)user;
+	for (size_t i = begin; i < end; i++) array[i] = work(i, 4);
+}
+
+//Element i costs i operations, so last chunks are much heavier than first ones
+static void imbalanced(const void *user, ir::uint32, size_t begin, size_t end)
+{
+	double *array = (double*)user;
+	for (size_t i = begin; i < end; i++) array[i] = work(i, i);
+}
+
+//Round-trip of empty parallel call, measures cost of waking and waiting for threads
+static double dispatch(ir::uint32 n, ir::uint32 spin)
+{
+	ir::Parallel parallel;
+	if (!parallel.init(n, spin)) return 0.0;
+	parallel.parallel(nullptr, [](const void *, ir::uint32, ir::uint32) {});
+	const double begin = now();
+	for (ir::uint32 i = 0; i < dispatch_count; i++) parallel.parallel(nullptr, [](const void *, ir::uint32, ir::uint32) {});
+	const double time = now() - begin;
+	parallel.finalize();
+	return time / dispatch_count;
+}
+
+//Best of several runs of parallel loop
+static double loop(ir::uint32 n, size_t size, size_t grain, ir::Parallel::Range *body, double *array)
+{
+	ir::Parallel parallel;
+	if (!parallel.init(n)) return 0.0;
+	double best = 0.0;
+	for (ir::uint32 i = 0; i < repeat_count; i++)
+	{
+		const double begin = now();
+		parallel.parallel_for(0, size, grain, array, body);
+		const double time = now() - begin;
+		if (i == 0 || time < best) best = time;
+	}
+	parallel.finalize();
+	return best;
+}
+
+int main(int argc, char **argv)
+{
+	ir::uint32 max_n = ir::Parallel::processor_count();
+	if (argc > 1) max_n = (ir::uint32)strtoul(argv[1], nullptr, 10);
+	if (max_n == 0) max_n = 1;
+	double *array = (double*)malloc(loop_size * sizeof(double));
+	if (array == nullptr) { printf("Not enough memory\n"); return 1; }
+	memset(array, 0, loop_size * sizeof(double));	//not to measure page faults
+	printf("Implementation: %s, processors: %u\n", IMPLEMENTATION, ir::Parallel::processor_count());
+
+	printf("\nDispatch latency, microseconds per empty parallel call\n");
+	printf("%8s %12s %12s\n", "threads", "spin", "no spin");
+	for (ir::uint32 n = 1; n <= max_n; n *= 2)
+	{
+		printf("%8u %12.3f %12.3f\n", n, 1e6 * dispatch(n, 0x8000), 1e6 * dispatch(n, 0));
+	}
+
+	printf("\nUniform loop of %u elements, milliseconds\n", (unsigned int)loop_size);
+	printf("%8s %12s %12s\n", "threads", "time", "speedup");
+	const double uniform_base = loop(1, loop_size, 0, uniform, array);
+	for (ir::uint32 n = 1; n <= max_n; n *= 2)
+	{
+		const double time = (n == 1) ? uniform_base : loop(n, loop_size, 0, uniform, array);
+		printf("%8u %12.3f %12.2f\n", n, 1e3 * time, uniform_base / time);
+	}
+
+	printf("\nImbalanced loop of %u elements, milliseconds\n", (unsigned int)imbalance_size);
+	printf("%8s %12s %12s %12s\n", "threads", "static", "dynamic", "speedup");
+	const double imbalance_base = loop(1, imbalance_size, 0, imbalanced, array);
+	for (ir::uint32 n = 1; n <= max_n; n *= 2)
+	{
+		//Static: one chunk per thread, dynamic: default grain, about eight chunks per thread
+		const double static_time = loop(n, imbalance_size, (imbalance_size + n - 1) / n, imbalanced, array);
+		const double dynamic_time = (n == 1) ? imbalance_base : loop(n, imbalance_size, 0, imbalanced, array);
+		printf("%8u %12.3f %12.3f %12.2f\n", n, 1e3 * static_time, 1e3 * dynamic_time, imbalance_base / dynamic_time);
+	}
+
+	free(array);
+	return 0;
+}
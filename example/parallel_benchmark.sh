@@ -0,0 +1,19 @@
+#!/bin/sh
+#Builds and runs parallel_benchmark.cpp with every implementation of ir::Parallel available on POSIX
+#Usage: ./parallel_benchmark.sh [maximal number of threads]
+run()
+{
+	if g++ parallel_benchmark.cpp $2 -O2 -Wall -Wextra -pedantic -std=c++11 -lpthread -o parallel_benchmark.exe
+	then
+		./parallel_benchmark.exe $1
+	else
+		printf "Compilation failed\n"
+	fi
+	printf "\n"
+}
+
+run "$1" ""
+run "$1" "-DIR_PARALLEL_IMPLEMENTATION='p'"
+run "$1" "-DIR_PARALLEL_IMPLEMENTATION='o' -fopenmp"
+
+rm parallel_benchmark.exe -f
@@ -1,6 +1,10 @@
 #define IR_INCLUDE 'a'
 #include "../include/ir/s2st_database.h"
 #include <stdio.h>
+#ifndef _WIN32
+	#include <unistd.h>
+	#include <sys/wait.h>
+#endif
 
 ir::S2STDatabase *database;
 
@@ -35,6 +39,42 @@ void test_read(const char *key, const char *rightdata, ir::ec rightcode)
 	printf("Test: %s\n\n", testok ? "ok" : "error");
 }
 
+#ifndef _WIN32
+//Reader in child process sees records inserted before and after it attached while writer in this process is idle
+bool test_processes()
+{
+	int ready[2], inserted[2];
+	if (pipe(ready) != 0) return false;
+	if (pipe(inserted) != 0) { close(ready[0]); close(ready[1]); return false; }
+	bool ok = database->insert(ir::Block("Pinkie Pie", 11), ir::Block("Gummy", 6)) == ir::ec::ok;
+	fflush(stdout);
+	pid_t pid = fork();
+	if (pid == 0)
+	{
+		ir::ec code;
+		ir::S2STDatabase reader(SS("database"), ir::Database::create_mode::read, &code);
+		ir::Block result;
+		char c = 0;
+		bool childok = code == ir::ec::ok && reader.read(ir::Block("Pinkie Pie", 11), &result) == ir::ec::ok && strcmp((const char*)result.data(), "Gummy") == 0;
+		childok = write(ready[1], &c, 1) == 1 && childok;
+		childok = read(inserted[0], &c, 1) == 1 && childok;
+		childok = childok && reader.read(ir::Block("Applejack", 10), &result) == ir::ec::ok && strcmp((const char*)result.data(), "Winona") == 0;
+		_exit(childok ? 0 : 1);
+	}
+	char c = 0;
+	ok = ok && pid > 0 && read(ready[0], &c, 1) == 1;
+	ok = ok && database->insert(ir::Block("Applejack", 10), ir::Block("Winona", 7)) == ir::ec::ok;
+	ok = ok && write(inserted[1], &c, 1) == 1;
+	close(ready[0]);
+	close(ready[1]);
+	close(inserted[0]);
+	close(inserted[1]);
+	int status = 1;
+	if (pid > 0) waitpid(pid, &status, 0);
+	return ok && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+#endif
+
 int main()
 {
 	ir::ec code = ir::ec::ok;
@@ -55,6 +95,53 @@ int main()
 		test_insert("Rarity", "Applejack", ir::Database::insert_mode::not_existing, ir::ec::key_already_exists);
 		test_insert("Rarity", "Applejack", ir::Database::insert_mode::existing, ir::ec::ok);
 		test_insert("Rarity", "Applejack", ir::Database::insert_mode::always, ir::ec::ok);
+
+		printf("Appending to key = 'Rarity', value is moved\n");
+		ir::Block key("Rarity", 7);
+		code = database->append(key, ir::Block(" and Big McIntosh", 18));
+		ir::Block head, tail;
+		if (code == ir::ec::ok) code = database->read_range(key, 0, 10, &head);
+		if (code == ir::ec::ok) code = database->read_range(key, 10, 18, &tail);
+		printf("Test: %s\n\n", code == ir::ec::ok && memcmp(head.data(), "Applejack", 10) == 0
+			&& memcmp(tail.data(), " and Big McIntosh", 18) == 0 ? "ok" : "error");
+		printf("Writing range of key = 'Rarity'\n");
+		code = database->write_range(key, 9, ir::Block(" ", 1));
+		printf("Test: %s\n\n", code == ir::ec::ok ? "ok" : "error");
+		test_read("Rarity", "Applejack  and Big McIntosh", ir::ec::ok);
+
+		test_insert("Fluttershy", "Angel", ir::Database::insert_mode::always, ir::ec::ok);
+		printf("Appending to key = 'Fluttershy', value is grown in place\n");
+		ir::uint32 filesize = database->get_file_size();
+		code = database->append(ir::Block("Fluttershy", 11), ir::Block(" Bunny", 7), 64);
+		printf("Test: %s\n\n", code == ir::ec::ok && database->get_file_size() == filesize - 6 + 13 + 64 ? "ok" : "error");
+		test_read("Fluttershy", "Angel", ir::ec::ok);
+		code = database->read_range(ir::Block("Fluttershy", 11), 6, 7, &tail);
+		printf("Test: %s\n\n", code == ir::ec::ok && memcmp(tail.data(), " Bunny", 7) == 0 ? "ok" : "error");
+
+		printf("Inserting empty value to key = 'Derpy' and optimizing\n");
+		ir::Block empty;
+		code = database->insert(ir::Block("Derpy", 6), ir::Block("", 0));
+		if (code == ir::ec::ok) code = database->read(ir::Block("Derpy", 6), &empty);
+		bool testok = code == ir::ec::ok && empty.size() == 0;
+		code = database->optimize();
+		if (code == ir::ec::ok) code = database->read(ir::Block("Derpy", 6), &empty);
+		printf("Test: %s\n\n", testok && code == ir::ec::ok && empty.size() == 0 ? "ok" : "error");
+		test_read("Rarity", "Applejack  and Big McIntosh", ir::ec::ok);
+
+		printf("Opening second writer and reader\n");
+		ir::S2STDatabase writer(SS("database"), ir::Database::create_mode::edit, &code);
+		testok = code == ir::ec::locked;
+		ir::S2STDatabase reader(SS("database"), ir::Database::create_mode::read, &code);
+		testok = testok && code == ir::ec::ok;
+		test_insert("Twilight", "Spike", ir::Database::insert_mode::always, ir::ec::ok);
+		ir::Block result;
+		testok = testok && reader.read(ir::Block("Twilight", 9), &result) == ir::ec::ok && strcmp((const char*)result.data(), "Spike") == 0;
+		printf("Test: %s\n\n", testok ? "ok" : "error");
+
+		#ifndef _WIN32
+			printf("Reading in other process while writer is idle\n");
+			printf("Test: %s\n\n", test_processes() ? "ok" : "error");
+		#endif
 	}
 	delete database;
 	getchar();
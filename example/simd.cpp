@@ -0,0 +1,36 @@
+#include "../include/ir/simd.h"
+#include <stdio.h>
+
+int main()
+{
+	const char *names[] = { "none", "sse2", "avx2", "avx512", "neon" };
+	printf("SIMD level: %s (set environment variable IR_SIMD to lower it)\n", names[(int)ir::simd_level()]);
+
+	float a[100], b[100];
+	for (int i = 0; i < 100; i++) { a[i] = (float)i; b[i] = 1.0f; }
+	const ir::Kernels<float> *kernels = ir::Kernels<float>::get();
+	const float dot = kernels->dot(100, a, b);
+	printf("Sum(0..99) = %f %s\n", dot, dot == 4950.0f ? "Test: ok" : "Test: error");
+	kernels->axpy(100, 2.0f, b, a);
+	printf("Sum(2..101) = %f %s\n", kernels->dot(100, a, b), kernels->dot(100, a, b) == 5150.0f ? "Test: ok" : "Test: error");
+
+	ir::int8 c[100], d[100];
+	for (int i = 0; i < 100; i++) { c[i] = (ir::int8)(i - 50); d[i] = (i % 2 == 0) ? 1 : -1; }
+	const ir::Int8Kernels *int8_kernels = ir::Int8Kernels::get();
+	const ir::int32 int8_dot = int8_kernels->dot(100, c, d);
+	printf("8-bit kernels: %s, alternating sum = %d %s\n", names[(int)int8_kernels->level], (int)int8_dot, int8_dot == -50 ? "Test: ok" : "Test: error");
+
+	float e[100], f[100];
+	for (int i = 0; i < 100; i++) { e[i] = (float)(i - 50); f[i] = (i % 2 == 0) ? 1.0f : -1.0f; }
+	ir::half g[100];
+	ir::bfloat16 h[100];
+	const ir::HalfKernels<ir::half> *half_kernels = ir::HalfKernels<ir::half>::get();
+	const ir::HalfKernels<ir::bfloat16> *bfloat16_kernels = ir::HalfKernels<ir::bfloat16>::get();
+	half_kernels->store(100, e, g);
+	bfloat16_kernels->store(100, e, h);
+	const float half_dot = half_kernels->dot(100, g, f);
+	const float bfloat16_dot = bfloat16_kernels->dot(100, h, f);
+	printf("Half kernels: %s, alternating sum = %f %s\n", names[(int)half_kernels->level], half_dot, half_dot == -50.0f ? "Test: ok" : "Test: error");
+	printf("bfloat16 kernels: %s, alternating sum = %f %s\n", names[(int)bfloat16_kernels->level], bfloat16_dot, bfloat16_dot == -50.0f ? "Test: ok" : "Test: error");
+	return 0;
+}
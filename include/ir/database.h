@@ -11,6 +11,13 @@
 #ifndef IR_DATABASE
 #define IR_DATABASE
 
+#include "mapping.h"
+#include "ec.h"
+#include "types.h"
+#include "quiet_vector.h"
+#include <stdio.h>
+#include <atomic>
+
 namespace ir
 {
 ///@addtogroup database Databases
@@ -38,13 +45,115 @@ namespace ir
 		///Creation mode
 		enum create_mode
 		{
-			read,		///< Open database with read access if files are not corrupted
-			edit,		///< Open database with read and write access if files are not corrupted
-			neww		///< Create empty database with read and write access, delete existing files
+			read,		///< Open database with read access if files are not corrupted. Changes made by writer in other process are seen on next read
+			edit,		///< Open database with read and write access if files are not corrupted. Fails with ir::ec::locked if database is already opened with write access
+			neww		///< Create empty database with read and write access, delete existing files. Fails with ir::ec::locked if database is already opened
+		};
+
+		///Access pattern, see `hint` methods of databases
+		typedef Mapping::access_pattern access_pattern;
+
+	protected:
+		struct LogHeader
+		{
+			unsigned char signature[7]	= { 'I', 'D', 'B', 'A', 'L', 'O', 'G' };
+			unsigned char version		= 1;
+			uint32 granularity			= 0;
+			uint32 count				= 0;
+		};
+
+		struct WarmContext
+		{
+			QuietVector<schar> path;	//path to database files ending with "~?"
+			schar meta;					//letter of meta file
+			schar file;					//letter of main file
+			bool data;					//defines if regions from access log need to be prefetched
+		};
+
+		struct SharedHeader
+		{
+			unsigned char signature[7]	= { 'I', 'D', 'B', 'S', 'H', 'R', 'D' };
+			unsigned char version		= 2;
+			std::atomic<uint32> generation;	//incremented before and after every modification, odd while files are being modified
+			std::atomic<uint32> beta;		//defines if opposite files are actual
+			std::atomic<uint32> filesize;	//size of main file, zero if nothing was published
+			std::atomic<uint32> metasize;	//size of table, in cells
+			std::atomic<uint32> count;
+			std::atomic<uint32> delcount;
+			std::atomic<uint32> used;
+			std::atomic<uint32> rebuild;	//incremented every time writer rebuilds database into new files
 		};
+
+		struct Shared
+		{
+			#ifdef _WIN32
+				HANDLE file			= INVALID_HANDLE_VALUE;
+				HANDLE mapping		= NULL;
+			#else
+				int file			= -1;
+			#endif
+			SharedHeader *header	= nullptr;	//mapped lock file, nullptr if not available
+			uint32 generation		= 0;		//generation seen by reader
+			uint32 depth			= 0;		//depth of nested modifications of writer
+			uint32 rebuild			= 0;		//rebuild count of writer or rebuild count seen by reader
+		};
+
+		static const uint32 _log_granularity	= 0x10000;	//size of main file region counted by access log, in bytes
+		static const uint32 _log_regions		= 0x100;	//maximal number of regions written to access log
+
+		//Access log & prefetching section
+		static void _log_touch(QuietVector<uint32> *log, uint32 offset, uint32 size)			noexcept;
+		static ec _log_save(QuietVector<schar> *path, const QuietVector<uint32> &log)			noexcept;
+		static ec _advise(FILE *file, access_pattern pattern)									noexcept;
+		static void _prefetch(FILE *file, uint32 offset, uint32 size)							noexcept;
+		static void _warm(WarmContext *context)													noexcept;
+		static ec _warm_up(QuietVector<schar> *path, schar meta, schar file, bool data)			noexcept;
+		#ifdef _WIN32
+			static DWORD WINAPI _warm_function(LPVOID context)									noexcept;
+		#else
+			static void *_warm_function(void *context)											noexcept;
+		#endif
+
+		//Multi-process section. Lock file (with suffix `~s`) has byte-range locks and is mapped as SharedHeader.
+		//Writer locks writer byte exclusively, readers lock reader byte shared. Writer in `neww` mode also locks reader byte exclusively until files are created
+		static const uint32 _shared_writer_lock	= 0x1000;	//offset of writer byte, lies beyond mapped header
+		static const uint32 _shared_reader_lock	= 0x1001;	//offset of reader byte
+		static bool _shared_lock(Shared *shared, uint32 offset, bool exclusive)				noexcept;
+		static void _shared_unlock(Shared *shared, uint32 offset)								noexcept;
+		static bool _shared_free(const Shared *shared, uint32 offset)							noexcept;
+		static ec _shared_open(QuietVector<schar> *path, create_mode mode, Shared *shared)		noexcept;
+		static void _shared_allow_readers(Shared *shared)										noexcept;
+		static void _shared_close(Shared *shared)												noexcept;
+		static void _shared_begin(Shared *shared)												noexcept;
+		static void _shared_end(Shared *shared)													noexcept;
+		static uint32 _shared_wait(const Shared *shared)										noexcept;
+		static bool _shared_changed(const Shared *shared)										noexcept;
+
+		//Publishing section, common for all databases. D is database that declares Database as friend and has members
+		//_shared, _file, _meta, _beta, _writeaccess, _mapping, _pattern and methods _check, _metaheadersize, set_ram_mode, hint, finalize
+		template<class D> struct Modification		//Modification of writer, is published to readers when outermost modification ends
+		{
+			D *database;	//nullptr if modification is not published to readers
+			Modification(D *database, bool publish)												noexcept;
+			~Modification()																		noexcept;
+		};
+		template<class D> static void _publish(D *database)										noexcept;
+		template<class D> static void _publish_all(D *database)									noexcept;
+		template<class D> static ec _refresh(D *database, bool force)							noexcept;
 	};
 
 ///@}
 }
 
-#endif	//#ifndef IR_DATABASE
\ No newline at end of file
+#endif	//#ifndef IR_DATABASE
+
+#if defined(IR_EXCLUDE) ? defined(IR_INCLUDE_DATABASE) : !defined(IR_EXCLUDE_DATABASE)
+	#ifndef IR_INCLUDE
+
+	#elif IR_INCLUDE == 'a'
+		#ifndef IR_DATABASE_SOURCE
+			#define IR_DATABASE_SOURCE
+			#include "../../source/database.h"
+		#endif
+	#endif
+#endif
@@ -50,6 +50,7 @@ namespace ir
 		//databases and registers sector
 		key_not_exists,			///< Identifier is not found in container (logical error)
 		key_already_exists,		///< Identifier is found in container (logical error)
+		locked,					///< Resource is locked by another process
 	};
 	
 ///@}
@@ -63,7 +64,7 @@ namespace ir
 
 @section Overview
 Here is a brief but full overview of features of the library:
- - Containers: `block.h`, `map.h`, `quiet_hash_map.h`, `quiet_list.h`, `quiet_map.h`, `quiet_ring.h`, `quiet_vector.h`, `string.h`, `vector.h`
+ - Containers: `block.h`, `map.h`, `quiet_atomic_ring.h`, `quiet_hash_map.h`, `quiet_list.h`, `quiet_map.h`, `quiet_ring.h`, `quiet_vector.h`, `string.h`, `vector.h`
  - Definitions: `constants.h`, `types.h`
  - Encoding library: `encoding.h`
  - Mathematics: `fft.h`, `gauss.h`
@@ -72,7 +73,7 @@ Here is a brief but full overview of features of the library:
  - Networking: `ip.h`, `tcp.h`, `udp.h`
  - Databases: `n2st_database.h`, `s2st_database.h`
  - Neuronal networks: `neuro.h`
- - High-performance computing: `parallel.h`, `matrix.h`
+ - High-performance computing: `parallel.h`, `matrix.h`, `simd.h`
  - RAII wrapper: `resource.h`
  - Source and sink abstractions: `sink.h`, `source.h`
  - Cross-platform versions of standard C functions: `str.h`, `print.h`
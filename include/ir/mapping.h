@@ -32,7 +32,16 @@ namespace ir
 		///Mapping mode
 		enum class map_mode
 		{
-			read
+			read,		///< Memory is read-only
+			copy		///< Memory is readable and writable, written pages become private copies and are not written to file. Pages that are not written are shared with other processes
+		};
+
+		///Access pattern
+		enum class access_pattern
+		{
+			normal,		///< No special access pattern
+			sequential,	///< Data is accessed sequentially, aggressive read-ahead is useful
+			random		///< Data is accessed randomly, read-ahead is useless
 		};
 
 	private:
@@ -50,6 +59,8 @@ namespace ir
 		
 		size_t _lowlimit			= 0;
 		size_t _highlimit			= 0;
+		map_mode _mode				= map_mode::read;
+		access_pattern _pattern		= access_pattern::normal;
 		
 		QuietVector<char> _emulated;
 
@@ -71,6 +82,9 @@ namespace ir
 			///@param hfile Native Windows file handle
 			void *map(HANDLE hfile, size_t offset, size_t size, map_mode mode)	noexcept;
 		#endif
+		///Tells operating system how mapped memory is going to be accessed. Applies to current and future mappings, does nothing if not supported
+		///@param pattern	Access pattern
+		void hint(access_pattern pattern)										noexcept;
 		///Closes file mapping
 		void close()															noexcept;
 		///Destroys mapping object
@@ -11,6 +11,8 @@
 #ifndef IR_MATRIX
 #define IR_MATRIX
 
+#include "types.h"
+#include "simd.h"
 #include <stddef.h>
 
 #ifndef IR_RESTRICT
@@ -22,14 +24,18 @@ namespace ir
 ///@defgroup hiperf Hight performance computing
 ///@{
 	
+	class Parallel;
+
 	///Group of `A` elements of type `T`@n
 	///Desires to represent SIMD register and force compiler to use SIMD instructions.
+	///Chunks of `float` and `double` that fit in SSE2, AVX, AVX-512 or NEON register are implemented with intrinsics if the compiler is allowed to generate these instructions
 	///@tparam T Basic type
 	///@tparam A Alignment in basic elements. For example, with `T = float` and `A = 4` compiler will theoretically generate SSE code
 	template <class T, size_t A> struct alignas(A * sizeof(T)) Chunk
 	{
 		T r[A];
 		inline void zero()											noexcept;
+		inline void fill(T value)									noexcept;
 		inline T sum()												const noexcept;
 		inline void operator+=(const Chunk & IR_RESTRICT another)	noexcept;
 		inline void operator-=(const Chunk & IR_RESTRICT another)	noexcept;
@@ -41,7 +47,8 @@ namespace ir
 		inline Chunk operator/(const Chunk & IR_RESTRICT another)	const noexcept;
 	};
 
-	///Two-dimensional array of type `T` optimized for performance
+	///Two-dimensional array of type `T` optimized for performance@n
+	///Operations that take `ir::Parallel` split work between its threads, `parallel.h` needs to be included to use them. If the pool is not initialized, they run serially in calling thread. If the pool executes operation of other thread, they wait for it. Called from functions and tasks of the pool, they run in calling thread
 	///@tparam T Basic type
 	///@tparam A Alignment in basic elements. For example, with `T = float` and `A = 4` compiler will theoretically generate SSE code
 	template <class T, size_t A> class Matrix
@@ -50,6 +57,52 @@ namespace ir
 		void *_data		= nullptr;
 		size_t _width	= 0;
 		size_t _height	= 0;
+		bool _external	= false;	//data is not owned by the matrix
+
+		//Data is aligned to cache line, so chunk ranges that start on cache lines can be processed by different threads without false sharing
+		static const size_t _alignment = (A * sizeof(T) > 64) ? A * sizeof(T) : 64;
+		static const size_t _line = _alignment / (A * sizeof(T));										//chunks in aligned cache line
+
+		//Type-erased call of ir::Parallel, keeps this header independent of parallel.h
+		typedef void Range(const void *user, uint32 id, size_t begin, size_t end);
+		typedef bool Runner(void *parallel, size_t count, size_t quantum, const void *user, Range *body);
+		template <class P> static bool _run(void *parallel, size_t count, size_t quantum, const void *user, Range *body)	noexcept;
+		template <class P> static uint32 _threads(void *parallel)													noexcept;
+
+		//Element-wise operations on whole storage in chunks:
+		enum class Operation { zero, add, subtract, multiply, sum, difference, product };
+		struct ElementContext
+		{
+			Operation operation;
+			Chunk<T, A> *c;
+			const Chunk<T, A> *a;
+			const Chunk<T, A> *b;
+		};
+		static void _element(const void *user, uint32 id, size_t begin, size_t end)									noexcept;
+		void _elementwise(Operation operation, const Matrix *IR_RESTRICT a, const Matrix *IR_RESTRICT b, void *parallel, Runner *runner)	noexcept;
+
+		//Blocked matrix product:
+		static const size_t _mr = 4;																	//rows of micro-kernel
+		static const size_t _nr = (A * sizeof(T) >= 64) ? A : (64 / (A * sizeof(T))) * A;				//columns of micro-kernel, multiple of A
+		static const size_t _kc = 0x100;																//depth of panels, B sliver should fit in L1
+		static const size_t _mc = 0x80;																//rows of packed A block, should fit in L2
+		static const size_t _nc = (0x800 + _nr - 1) / _nr * _nr;										//columns of packed B panel, should fit in L3
+		struct ProductContext
+		{
+			Matrix *c;
+			const Matrix *a;
+			const Matrix *b;
+			bool transposed;
+			const Kernels<T> *kernels;
+			bool dispatch;
+			T *packed_a;																				//one block per thread
+			T *packed_b;
+			size_t jc, nc, pc, kc;
+		};
+		static void _kernel(size_t depth, const T *IR_RESTRICT a, const Chunk<T, A> *IR_RESTRICT b, Chunk<T, A> *IR_RESTRICT c)	noexcept;
+		static void _pack(const void *user, uint32 id, size_t begin, size_t end)										noexcept;
+		static void _block(const void *user, uint32 id, size_t begin, size_t end)										noexcept;
+		void _product(const Matrix *IR_RESTRICT a, const Matrix *IR_RESTRICT b, bool transposed, void *parallel, Runner *runner, uint32 threads)	noexcept;
 
 		Matrix(const Matrix &other) noexcept;
 
@@ -63,10 +116,18 @@ namespace ir
 		Matrix(size_t height, size_t width)		noexcept;
 		///Initializes empty matrix
 		bool init(size_t height, size_t width)	noexcept;
+		///Initializes matrix on external memory without copying, the memory is not freed by the matrix@n
+		///Memory needs to be aligned to `ir::Matrix::alignment` and contain `height` rows, every row is `width` rounded up to multiple of `A` elements
+		///@return @c false if memory is not aligned
+		bool init(size_t height, size_t width, void *data)	noexcept;
+		///Returns alignment of data in bytes
+		static inline size_t alignment()		noexcept;
 		///Checks if matrix is successfully allocated
 		bool ok()								const noexcept;
 		///Finalizes matrix and frees resources
 		void finalize()							noexcept;
+		///Exchanges memory and sizes with other matrix without copying
+		void swap(Matrix *other)				noexcept;
 		///Destroys matrix
 		~Matrix()								noexcept;
 
@@ -101,26 +162,54 @@ namespace ir
 		inline Chunk<T, A> vertical_chunk_at(size_t row, size_t column)				const noexcept;
 		///Returns vertical chunk of matrix at the edge of matrix
 		inline Chunk<T, A> vertical_chunk_at_edge(size_t row, size_t column)		const noexcept;
+		///Returns chunk of matrix converted to `float`, makes matrixes of `ir::half` and `ir::bfloat16` usable in computations
+		inline Chunk<float, A> float_chunk_at(size_t row, size_t column)			const noexcept;
 		
 		//Operations:
 		///Assigns matrix to zero
-		void zero()																				noexcept;
+		void zero()																									noexcept;
+		///Assigns matrix to zero using threads of `parallel`
+		void zero(Parallel *parallel)																				noexcept;
+		///Assigns matrix to matrix of another type and same size, element by element@n
+		///Conversion between `float` and `ir::half` or `ir::bfloat16` rounds to nearest even and uses `ir::HalfKernels`
+		template<class S, size_t B> void convert(const Matrix<S, B> *IR_RESTRICT source)							noexcept;
 		///Assigns matrix to random value
-		void random(T low, T high)																noexcept;
+		void random(T low, T high)																					noexcept;
 		///Adds matrix to given matrix
-		void add(const Matrix *IR_RESTRICT b)													noexcept;
+		void add(const Matrix *IR_RESTRICT b)																		noexcept;
+		///Adds matrix to given matrix using threads of `parallel`
+		void add(const Matrix *IR_RESTRICT b, Parallel *parallel)													noexcept;
 		///Subtracts matrix from given matrix
-		void subtract(const Matrix *IR_RESTRICT b)												noexcept;
+		void subtract(const Matrix *IR_RESTRICT b)																	noexcept;
+		///Subtracts matrix from given matrix using threads of `parallel`
+		void subtract(const Matrix *IR_RESTRICT b, Parallel *parallel)												noexcept;
 		///Multiplies matrix with given matrix element-wise
-		void element_multiply(const Matrix *IR_RESTRICT b)										noexcept;
+		void element_multiply(const Matrix *IR_RESTRICT b)															noexcept;
+		///Multiplies matrix with given matrix element-wise using threads of `parallel`
+		void element_multiply(const Matrix *IR_RESTRICT b, Parallel *parallel)										noexcept;
 		///Assigns matrix to sum of matrixes
-		void sum(const Matrix *IR_RESTRICT a, const Matrix *IR_RESTRICT b)						noexcept;
+		void sum(const Matrix *IR_RESTRICT a, const Matrix *IR_RESTRICT b)											noexcept;
+		///Assigns matrix to sum of matrixes using threads of `parallel`
+		void sum(const Matrix *IR_RESTRICT a, const Matrix *IR_RESTRICT b, Parallel *parallel)						noexcept;
 		///Assigns matrix to difference of matrixes
-		void difference(const Matrix *IR_RESTRICT a, const Matrix *IR_RESTRICT b)				noexcept;
+		void difference(const Matrix *IR_RESTRICT a, const Matrix *IR_RESTRICT b)									noexcept;
+		///Assigns matrix to difference of matrixes using threads of `parallel`
+		void difference(const Matrix *IR_RESTRICT a, const Matrix *IR_RESTRICT b, Parallel *parallel)				noexcept;
 		///Assigns matrix to element-wise product of matrixes
-		void element_product(const Matrix *IR_RESTRICT a, const Matrix *IR_RESTRICT b)			noexcept;
-		///Assigns matrix to matrix product of matrix a and transposed matrix b
-		void matrix_product_transposed(const Matrix *IR_RESTRICT a, const Matrix *IR_RESTRICT b)noexcept;
+		void element_product(const Matrix *IR_RESTRICT a, const Matrix *IR_RESTRICT b)								noexcept;
+		///Assigns matrix to element-wise product of matrixes using threads of `parallel`
+		void element_product(const Matrix *IR_RESTRICT a, const Matrix *IR_RESTRICT b, Parallel *parallel)			noexcept;
+		///Assigns matrix to matrix product of matrixes a and b@n
+		///`b` may be wider than the matrix, excess columns of `b` are ignored
+		void matrix_product(const Matrix *IR_RESTRICT a, const Matrix *IR_RESTRICT b)								noexcept;
+		///Assigns matrix to matrix product of matrixes a and b using threads of `parallel`@n
+		///Blocks of rows are distributed between threads, every thread packs its own blocks of `a`
+		void matrix_product(const Matrix *IR_RESTRICT a, const Matrix *IR_RESTRICT b, Parallel *parallel)			noexcept;
+		///Assigns matrix to matrix product of matrix a and transposed matrix b@n
+		///`b` may be wider than `a`, excess columns of `b` are ignored
+		void matrix_product_transposed(const Matrix *IR_RESTRICT a, const Matrix *IR_RESTRICT b)					noexcept;
+		///Assigns matrix to matrix product of matrix a and transposed matrix b using threads of `parallel`
+		void matrix_product_transposed(const Matrix *IR_RESTRICT a, const Matrix *IR_RESTRICT b, Parallel *parallel)	noexcept;
 	};
 ///@}
 }
@@ -26,6 +26,7 @@ namespace ir
 
 	///Number to String Table Database
 	///String should be understood as any sequence of bytes
+	///Database can be opened by one writer and many readers, also in different processes. Changes of writer are visible to readers unless writer keeps files in RAM
 	class N2STDatabase : public Database
 	{
 	protected:
@@ -39,9 +40,18 @@ namespace ir
 		struct MetaHeader
 		{
 			unsigned char signature[7]	= { 'I', 'N', '2', 'S', 'T', 'D', 'M' };
-			unsigned char version		= 1;
+			unsigned char version		= 2;
+			uint32 used					= 0;
+			uint32 count				= 0;
+		};
+
+		struct SparseMetaHeader
+		{
+			unsigned char signature[7]	= { 'I', 'N', '2', 'S', 'T', 'D', 'S' };
+			unsigned char version		= 2;
 			uint32 used					= 0;
 			uint32 count				= 0;
+			uint32 delcount				= 0;
 		};
 
 		struct MetaCell
@@ -49,9 +59,17 @@ namespace ir
 			uint32 offset;
 			uint32 size : 31;
 			uint32 deleted : 1;
+			uint32 capacity;			//space reserved for value, not less than size
 			MetaCell() noexcept;
 		};
 
+		struct SparseMetaCell
+		{
+			uint32 index;
+			MetaCell cell;
+			SparseMetaCell() noexcept;
+		};
+
 		struct FileMetaCommon
 		{
 			bool hold		= false;	//defines if program holds file in RAM
@@ -59,6 +77,7 @@ namespace ir
 			uint32 size		= 0;		//if hold duplicates ram.size(), otherwise duplicates file size
 			FILE *file		= nullptr;	//if !hold is file, otherwise invalid
 			bool changed	= false;	//if hold defines if file was changed, otherwise invalid
+			bool written	= false;	//if !hold defines if last operation was write, so reading needs seeking, otherwise invalid
 		};
 
 		struct : FileMetaCommon
@@ -69,23 +88,52 @@ namespace ir
 
 		struct : FileMetaCommon
 		{
-			QuietVector<MetaCell> ram;	//valid if hold, otherwise empty
+			QuietVector<MetaCell> ram;				//valid if hold and not sparse, otherwise empty
+			QuietVector<SparseMetaCell> sparseram;	//valid if hold and sparse, otherwise empty
 			uint32 count	= 0;
-			uint32 delcount	= 0;
+			uint32 delcount	= 0;					//valid if sparse, otherwise zero
 		} _meta;
 
 		bool _ok			= false;
 		bool _writeaccess	= false;
 		bool _beta			= false;
+		bool _sparse		= false;
+		bool _legacy		= false;	//meta file is of version 1, its cells have no capacity
 		QuietVector<schar> _path;
 		ir::Mapping _mapping;
+		access_pattern _pattern	= access_pattern::normal;
+		bool _logging		= false;
+		QuietVector<uint32> _log;	//access counts of main file regions, valid if logging
+		Shared _shared;
+		QuietVector<char> _readbuffer;	//copy of data last read by reader
 
 		//Primitive read & write section
+		static uint32 _align(uint32 i)								noexcept;
 		ec _read(void *buffer, uint32 offset, uint32 size)			noexcept;
 		ec _write(const void *buffer, uint32 offset, uint32 size)	noexcept;
+		ec _copy(uint32 source, uint32 destination, uint32 size)	noexcept;
+		ec _reserve(uint32 end)										noexcept;
 		ec _readpointer(void **p, uint32 offset, uint32 size)		noexcept;
 		ec _metaread(MetaCell *cell, uint32 index)					noexcept;
 		ec _metawrite(MetaCell cell, uint32 index)					noexcept;
+		ec _sparsemetaread(SparseMetaCell *cell, uint32 slot)		noexcept;
+		ec _sparsemetawrite(SparseMetaCell cell, uint32 slot)		noexcept;
+		uint32 _metaheadersize()									const noexcept;
+		uint32 _metacellsize()										const noexcept;
+
+		//Complex section
+		ec _find(uint32 index, uint32 *slot, MetaCell *cell)		noexcept;
+		ec _store(uint32 index, uint32 slot, MetaCell cell)			noexcept;
+		ec _readslot(uint32 slot, uint32 *index, MetaCell *cell)	noexcept;
+		ec _rehash(uint32 newtablesize)								noexcept;
+		uint32 _growtablesize()										const noexcept;
+		ec _makesparse()											noexcept;
+		ec _rebuild(bool sparse)									noexcept;
+
+		//Multi-process section
+		friend class Database;
+		typedef Database::Modification<N2STDatabase> Modification;
+		bool _unstable()														const noexcept;
 
 		//Init section
 		ec _check()																noexcept;
@@ -114,25 +162,41 @@ namespace ir
 		///@param index Integer identifier
 		///@param data Pointer to ir::Block to receive result
 		ec read(uint32 index, Block *data)											noexcept;
+		///Reads part of value related to identifier. Only the requested part is read from main file. Is thread-safe if `set_ram_mode(true, true)` was done
+		///@param index Integer identifier
+		///@param offset Offset of the part in value, in bytes
+		///@param size Size of the part, in bytes
+		///@param data Pointer to ir::Block to receive result
+		ec read_range(uint32 index, uint32 offset, uint32 size, Block *data)		noexcept;
 		///Inserts value related to identifier into database
 		///@param index Integer identifier
 		///@param data Related value
 		///@param mode Insertion mode
 		ec insert(uint32 index, Block data, insert_mode mode = insert_mode::always)noexcept;
+		///Overwrites part of value related to identifier. The part must lie inside of the value
+		///@param index Integer identifier
+		///@param offset Offset of the part in value, in bytes
+		///@param data New content of the part
+		ec write_range(uint32 index, uint32 offset, Block data)						noexcept;
+		///Appends data to value related to identifier, or inserts it if identifier does not exist. Is done in place if value has enough reserved space or is last in main file, otherwise value is moved to the end of main file
+		///@param index Integer identifier
+		///@param data Data to append
+		///@param reserve Space to reserve after the value if it is moved or grown, in bytes. Makes next appends be done in place
+		ec append(uint32 index, Block data, uint32 reserve = 0)						noexcept;
 		///Deletes value from database
 		///@param index Integer identifier
 		///@param mode Deletion mode
 		ec delet(uint32 index, delete_mode mode = delete_mode::always)				noexcept;
 		///Gets number of elements stored in database
 		uint32 count()																const noexcept;
-		///Gets size of the table, in elements
+		///Gets size of the table, in elements. In sparse mode it is size of hash table, not the greatest identifier
 		uint32 get_table_size()														const noexcept;
 		///Gets size of main database (excluding table), in bytes
 		uint32 get_file_size()														const noexcept;
 		///Gets used size of main database. Database will have this size after optimizing
 		uint32 get_file_used_size()													const noexcept;
-		///Sets table size. It may be a good idea to set table size if you know number of elements explicitly
-		///@param newtablesize New table size, must be power of two
+		///Sets table size. It may be a good idea to set table size if you know number of elements explicitly. Implemented only in sparse mode
+		///@param newtablesize New table size, must be power of two and not less than current table size
 		ec set_table_size(uint32 newtablesize)										noexcept;
 		///Sets main file size. It may be a good idea to set file size if you know know it explicitly
 		///@param newfilesize New file size, in bytes
@@ -141,6 +205,20 @@ namespace ir
 		///@param holdfile Hold main file in RAM
 		///@param holdmeta Hold table in RAM
 		ec set_ram_mode(bool holdfile, bool holdmeta)								noexcept;
+		///Tells if table needs to be kept as hash table. Dense table is indexed directly by identifier, so it's size is defined by the greatest identifier. Sparse table has size proportional to number of elements, but costs hashing and probing on each access. Switching the mode rebuilds the database like `optimize` does
+		///@param sparse Keep table sparse
+		ec set_sparse_mode(bool sparse)												noexcept;
+		///Returns whether table is kept as hash table
+		bool get_sparse_mode()														const noexcept;
+		///Tells how values are going to be read, so operating system can adjust read-ahead for files and mappings of database. Is kept until `finalize`
+		///@param pattern Access pattern
+		ec hint(access_pattern pattern)												noexcept;
+		///Tells if reads of main file need to be counted. If they are, the most accessed regions are written to access log file (with suffix `~l`) on `finalize`, and `warm_up` can prefetch them next time
+		///@param log Count reads
+		ec set_access_log(bool log)													noexcept;
+		///Starts background thread that prefetches table into operating system cache. Is useful right after `init` if database is not kept in RAM. Does not block
+		///@param data Also prefetch the most accessed regions of main file recorded in access log
+		ec warm_up(bool data = true)												noexcept;
 		///Optimizes database for size
 		ec optimize()																noexcept;
 		///Finalizes database and write files kept in RAM to hard drive
@@ -39,6 +39,11 @@ namespace ir
 		static inline T derivative(const T output)	noexcept;	///< Derivative of ReLU calculated from it's result
 	};
 
+	class File;
+	class Mapping;
+	template <class T, size_t A, class F> class Int8Neuro;
+	template <class T, size_t A, class F, class H> class HalfNeuro;
+
 	///Ultra-lite neural network with teacher, provides no GPU acceleration. Kind of CPU version of [NeuroG](https://github.com/Meta-chan/NeuroG)
 	///@tparam T Type of numbers the network operates with
 	///@tparam A Alignment of input, output, goal and internal buffers in T's, used for SIMD acceleration
@@ -46,40 +51,137 @@ namespace ir
 	template <class T = float, size_t A = 1, class F = Tanh<T>> class Neuro
 	{
 	private:
+		template <class, size_t, class> friend class Int8Neuro;
+		template <class, size_t, class, class> friend class HalfNeuro;
+
 		struct FileHeader
 		{
 			char signature[3]		= { 'I', 'N', 'R' };
-			unsigned char version	= 4;
+			unsigned char version	= 5;
+		};
+
+		//Version 5 stores weights in type T in layout of ir::Matrix, every matrix starts on aligned offset, so the file can be mapped
+		//Version 4 stores weights as doubles without padding
+		struct FileLayout
+		{
+			uint32 type_size		= sizeof(T);
+			uint32 alignment		= A;
+			uint32 nlayers			= 0;
 		};
 
 		bool _ok = false;
+		uint32 _batch = 1;
 		std::vector<uint32> _layers;
 		std::vector<Matrix<T, A>> _vectors;
 		std::vector<Matrix<T, A>> _errors;
 		Matrix<T, A> _goal;
 		std::vector<Matrix<T, A>> _weights; 
 		T _coefficient = 0.0;
+		Mapping *_mapping = nullptr;		//mapping of file if weights are mapped
+
+		//Buffers of mini-batch correction, empty if batch is 1
+		//Transposed vectors have additional row of ones, so gradients contain bias in last column
+		std::vector<Matrix<T, A>> _transposed_vectors;
+		std::vector<Matrix<T, A>> _transposed_errors;
+		std::vector<Matrix<T, A>> _gradients;
+
+		//Data-parallel training, every thread processes its rows of batch in its own buffers
+		struct Worker
+		{
+			uint32 begin = 0;
+			uint32 end = 0;
+			std::vector<Matrix<T, A>> vectors;
+			std::vector<Matrix<T, A>> errors;
+			Matrix<T, A> goal;
+			std::vector<Matrix<T, A>> transposed_vectors;
+			std::vector<Matrix<T, A>> transposed_errors;
+			std::vector<Matrix<T, A>> gradients;
+		};
+		Parallel *_parallel = nullptr;
+		bool _hogwild = false;
+		std::vector<Worker> _workers;
 		
 		static void _forward(const Matrix<T, A> *w, const Matrix<T, A> *pv, Matrix<T, A> *nv)							noexcept;
 		static void _lastbackward(const Matrix<T, A> *g, const Matrix<T, A> *l, Matrix<T, A> *e)						noexcept;
 		static void _backward(const Matrix<T, A> *w, const Matrix<T, A> *ne, const Matrix<T, A> *pv, Matrix<T, A> *pe)	noexcept;
 		static void _corrigate(T coef, const Matrix<T, A> *pv, const Matrix<T, A> *ne, Matrix<T, A> *w)					noexcept;
+		static void _backward_corrigate(T coef, Matrix<T, A> *w, const Matrix<T, A> *ne, const Matrix<T, A> *pv, Matrix<T, A> *pe)	noexcept;
+		static void _transpose(const Matrix<T, A> *source, Matrix<T, A> *destination)									noexcept;
+		static void _corrigate_batch(T coef, const Matrix<T, A> *pv, const Matrix<T, A> *ne,
+			Matrix<T, A> *pvt, Matrix<T, A> *net, Matrix<T, A> *g, Matrix<T, A> *w)										noexcept;
+		static void _gradient(const Matrix<T, A> *pv, const Matrix<T, A> *ne, Matrix<T, A> *pvt, Matrix<T, A> *net, Matrix<T, A> *g)	noexcept;
+		static void _copy(const Matrix<T, A> *source, size_t source_row, Matrix<T, A> *destination, size_t destination_row, size_t count)	noexcept;
+		static void _forward_worker(const void *user, uint32 id, uint32 n)												noexcept;
+		static void _backward_worker(const void *user, uint32 id, uint32 n)												noexcept;
+		static void _reduce(const void *user, uint32 id, size_t begin, size_t end)										noexcept;
+		ec _init_correction(uint32 batch, std::vector<Matrix<T, A>> *pvt, std::vector<Matrix<T, A>> *net, std::vector<Matrix<T, A>> *g)	const noexcept;
+		ec _init_workers(uint32 batch, Parallel *parallel, std::vector<Worker> *workers)								const noexcept;
+		ec _init_buffers()																								noexcept;
 		ec _init(T amplitude, FILE *file)																				noexcept;
+		static void _offsets(uint32 type_size, uint32 alignment, const std::vector<uint32> &layers, uint64 *offsets)	noexcept;
+		ec _load(File *file, bool map)																					noexcept;
 
 	public:
+		///Activation buffers of `ir::Neuro::forward(Inference*) const`@n
+		///Weights of the network are only read during inference, so many threads can share one network, every thread needs its own buffers
+		class Inference
+		{
+		private:
+			friend class Neuro;
+			std::vector<Matrix<T, A>> _vectors;
+			uint32 _batch = 0;
+			Inference(const Inference &other) noexcept;
+
+		public:
+			///Creates empty buffers
+			Inference()												noexcept;
+			///Allocates buffers for the network
+			///@param neuro Network the buffers are used with
+			///@param batch Number of samples processed at once
+			ec init(const Neuro *neuro, uint32 batch)				noexcept;
+			///Returns if buffers were allocated properly
+			bool ok()												const noexcept;
+			///Returns number of samples processed at once
+			uint32 get_batch()										const noexcept;
+			///Gets input, one sample per row
+			Matrix<T, A> *get_input()								noexcept;
+			///Gets output, one sample per row
+			Matrix<T, A> *get_output()								noexcept;
+			///Frees buffers
+			void finalize()											noexcept;
+		};
+
 		///Creates the network based on number of neurons in each layer,
 		///where 0 is input layer and `nlayers - 1` is output layer.
 		///Initializes weights with random values from `-amplitude` to `amplitude`
 		Neuro(size_t nlayers, const uint32 *layers, T amplitude, ec *code)	noexcept;
-		///Loads the network from file
+		///Loads the network from file of version 4 or 5
 		Neuro(const schar *filepath, ec *code)								noexcept;
+		///Loads the network from file of version 4 or 5
+		///@param map If @c true and file is of version 5 with same `T` and `A`, weights are used directly from copy-on-write mapping of the file, without parsing or copying.
+		///Pages of weights are shared with other processes that map the file until the network learns
+		Neuro(const schar *filepath, bool map, ec *code)					noexcept;
 		///Returns if `ir::Neuro` was created properly
 		bool ok()															const noexcept;
-		///Gets input
+		///Sets number of samples processed at once. Input, output and goal become matrixes with one sample per row, their contents are lost@n
+		///Batches are processed with matrix-matrix products, so weights are reused by all samples of the batch.
+		///Weights are corrected by mean of corrections of all samples, so learning coefficient keeps its meaning@n
+		///If allocation fails, `ir::ec::alloc` is returned and previous batch is kept
+		ec set_batch(uint32 batch)											noexcept;
+		///Returns number of samples processed at once
+		uint32 get_batch()													const noexcept;
+		///Distributes samples of batch between threads of `parallel`. Every thread gets its own buffers, gradients of threads are summed by tree reduction before correction@n
+		///Reallocates buffers on `ir::Neuro::set_batch`. The pool needs to be alive while it is set
+		///@param parallel Pool of threads, `nullptr` to compute in calling thread
+		///@param hogwild If @c true, threads correct weights without reduction and synchronization as soon as their gradients are ready (Hogwild).
+		///Weights are read and written concurrently, so results are not deterministic. It is faster if updates are sparse@n
+		///If allocation fails, `ir::ec::alloc` is returned and previous pool is kept
+		ec set_parallel(Parallel *parallel, bool hogwild = false)			noexcept;
+		///Gets input, one sample per row
 		Matrix<T, A> *get_input()											noexcept;
-		///Gets output
+		///Gets output, one sample per row
 		Matrix<T, A> *get_output()											noexcept;
-		///Gets goal
+		///Gets goal, one sample per row
 		Matrix<T, A> *get_goal()											noexcept;
 		///Sets learning coefficient
 		void set_coefficient(T coefficient)									noexcept;
@@ -87,13 +189,97 @@ namespace ir
 		T get_coefficient()													const noexcept;
 		///Performs forward calculation
 		void forward()														noexcept;
+		///Performs forward calculation in given buffers without modifying the network, may be called from several threads at once
+		void forward(Inference *inference)									const noexcept;
 		///Performs backward learning. Needs to be called after forward
 		void backward()														noexcept;
-		///Saves the network to file, does not modify error code
+		///Saves the network to file of version 5, does not modify error code@n
+		///Weights are stored in type `T` with rows padded and aligned like in memory, so the file can be mapped on loading
 		ec save(const schar *filepath)										const noexcept;
 		///Destroys the network
 		~Neuro()															noexcept;
 	};
+
+	///Inference-only network with 8-bit weights, converted from trained `ir::Neuro`@n
+	///Every row of weights has its own scale. Inputs of layers are quantized with one scale per sample, products are accumulated in 32-bit integers with `ir::Int8Kernels`.
+	///Weights take four times less memory than `float` weights
+	///@tparam T Type of inputs and outputs
+	///@tparam A Alignment of input and output in T's
+	///@tparam F Activation function of the network
+	template <class T = float, size_t A = 1, class F = Tanh<T>> class Int8Neuro
+	{
+	private:
+		bool _ok = false;
+		std::vector<uint32> _layers;
+		std::vector<Matrix<int8, 64>> _weights;		//without bias, rows are padded to cache lines
+		std::vector<std::vector<T>> _scales;
+		std::vector<std::vector<T>> _biases;
+		std::vector<Matrix<T, A>> _vectors;
+		Matrix<int8, 64> _quantized;
+		
+		static inline int8 _quantize(T value)								noexcept;
+		Int8Neuro(const Int8Neuro &other)									noexcept;
+
+	public:
+		///Creates empty network
+		Int8Neuro()															noexcept;
+		///Quantizes weights of the network
+		///@param neuro Trained network
+		///@param batch Number of samples processed at once
+		ec init(const Neuro<T, A, F> *neuro, uint32 batch = 1)				noexcept;
+		///Returns if `ir::Int8Neuro` was created properly
+		bool ok()															const noexcept;
+		///Returns number of samples processed at once
+		uint32 get_batch()													const noexcept;
+		///Gets input, one sample per row
+		Matrix<T, A> *get_input()											noexcept;
+		///Gets output, one sample per row
+		Matrix<T, A> *get_output()											noexcept;
+		///Performs forward calculation
+		void forward()														noexcept;
+		///Frees resources
+		void finalize()														noexcept;
+	};
+
+	///Inference-only network with 16-bit weights, converted from trained `ir::Neuro`@n
+	///Weights are converted to `float` on load by `ir::HalfKernels`, products and biases are computed in `float`.
+	///Weights take two times less memory and bandwidth than `float` weights
+	///@tparam T Type of inputs and outputs
+	///@tparam A Alignment of input and output in T's
+	///@tparam F Activation function of the network
+	///@tparam H Storage type of weights, `ir::half` or `ir::bfloat16`
+	template <class T = float, size_t A = 1, class F = Tanh<T>, class H = half> class HalfNeuro
+	{
+	private:
+		bool _ok = false;
+		std::vector<uint32> _layers;
+		std::vector<Matrix<H, 32>> _weights;		//without bias, rows are aligned to cache lines
+		std::vector<std::vector<float>> _biases;
+		std::vector<Matrix<T, A>> _vectors;
+		Matrix<float, 16> _input;					//input of layer converted to float
+		
+		HalfNeuro(const HalfNeuro &other)									noexcept;
+
+	public:
+		///Creates empty network
+		HalfNeuro()															noexcept;
+		///Converts weights of the network
+		///@param neuro Trained network
+		///@param batch Number of samples processed at once
+		ec init(const Neuro<T, A, F> *neuro, uint32 batch = 1)				noexcept;
+		///Returns if `ir::HalfNeuro` was created properly
+		bool ok()															const noexcept;
+		///Returns number of samples processed at once
+		uint32 get_batch()													const noexcept;
+		///Gets input, one sample per row
+		Matrix<T, A> *get_input()											noexcept;
+		///Gets output, one sample per row
+		Matrix<T, A> *get_output()											noexcept;
+		///Performs forward calculation
+		void forward()														noexcept;
+		///Frees resources
+		void finalize()														noexcept;
+	};
 	
 ///@}
 }
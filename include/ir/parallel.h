@@ -12,6 +12,11 @@
 #define IR_PARALLEL
 
 #include "types.h"
+#include "ec.h"
+#include "quiet_vector.h"
+#include "quiet_atomic_ring.h"
+#include <stddef.h>
+#include <atomic>
 
 //IR_PARALLEL_IMPLEMENTATION can be
 //nothing for noting
@@ -22,10 +27,8 @@
 #ifndef IR_PARALLEL_IMPLEMENTATION
 #elif IR_PARALLEL_IMPLEMENTATION == 'w'
 	#include <Windows.h>
-#elif IR_PARALLEL_IMPLEMENTATION == 'a'
-	#include <atomic>
-#elif IR_PARALLEL_IMPLEMENTATION == 'o'
-	#include <atomic>
+#elif IR_PARALLEL_IMPLEMENTATION == 'p'
+	#include <pthread.h>
 #endif
 
 namespace ir
@@ -33,50 +36,368 @@ namespace ir
 ///@addtogroup hiperf Hight performance computing
 ///@{
 	
-	///Object to perform parallel operations
+	///Pool of threads to perform parallel operations. Pools are independent, every pool has its own threads and can be used from several threads
 	class Parallel
 	{
 	public:
 		///Type of function to be performed
 		///@param user Pointer given to `ir::Parallel::parallel`
-		///@param id Thread number, from `0` to`n - 1`, where `n - 1` corresponds main thread
+		///@param id Thread number, from `0` to`n - 1`, where `0` corresponds calling thread
 		typedef void Function(const void *user, uint32 id, uint32 n);
+		///Type of task executed by work-stealing scheduler
+		///@param user Pointer given to `ir::Parallel::spawn`
+		typedef void Task(const void *user);
+		///Type of function that processes range of `ir::Parallel::parallel_for`
+		///@param user Pointer given to `ir::Parallel::parallel_for`
+		///@param id Thread number, from `0` to `n - 1`
+		///@param begin First index of range
+		///@param end Index after last index of range
+		typedef void Range(const void *user, uint32 id, size_t begin, size_t end);
+		///Type of function that processes range of `ir::Parallel::parallel_reduce` and accumulates the result
+		///@param user Pointer given to `ir::Parallel::parallel_reduce`
+		///@param begin First index of range
+		///@param end Index after last index of range
+		///@param accumulator Accumulator of the thread
+		typedef void Reduce(const void *user, size_t begin, size_t end, void *accumulator);
+		///Type of function that combines two accumulators
+		///@param accumulator Accumulator that receives the result
+		///@param other Accumulator to combine with
+		typedef void Combine(void *accumulator, const void *other);
+		///Type of function that produces items for `ir::Parallel::pipeline`
+		///@param user Pointer given to `ir::Parallel::pipeline`
+		///@return Next item or `nullptr` if there are no more items
+		typedef void *Source(const void *user);
+		///Type of stage of `ir::Parallel::pipeline`
+		///@param user Pointer given to `ir::Parallel::pipeline`
+		///@param item Item returned by previous stage or source
+		///@return Item for next stage or `nullptr` if item is dropped. Return value of last stage is ignored
+		typedef void *Stage(const void *user, void *item);
+		///Statistics of one thread of pool, see `ir::Parallel::set_statistics`
+		struct Statistics
+		{
+			uint64 tasks;		///< Number of executed tasks
+			uint64 chunks;		///< Number of processed chunks of loops and batches of pipelines
+			uint64 steals;		///< Number of tasks stolen from other threads
+			uint64 busy;		///< Time spent in functions, tasks and chunks, in nanoseconds
+			uint64 spin;		///< Time spent spinning while waiting, in nanoseconds
+			uint64 parked;		///< Time spent sleeping while waiting, in nanoseconds
+			uint64 deque;		///< Number of tasks currently waiting in deque of the thread
+		};
+		///Placement of threads on processors
+		enum class affinity
+		{
+			none,		///< Threads may run on any processor
+			cores,		///< Every thread is pinned to its own processor, processors of one NUMA node are taken first
+			nodes		///< Threads are split into groups of consecutive numbers, every group is pinned to processors of one NUMA node
+		};
+
+		///Cancellation token and first error of one operation. Functions and tasks of the operation reach it with `ir::Parallel::cancel`, `ir::Parallel::fail` and `ir::Parallel::cancelled`
+		class Job
+		{
+			friend class Parallel;
+			std::atomic<bool> _cancelled;
+			std::atomic<uint32> _error;			//first error reported with fail
+			void _reset()											noexcept;
+
+		public:
+			///Creates job that is not cancelled and has no error
+			Job()													noexcept;
+			///Stops operation early. Functions and tasks are expected to check `cancelled` and return, loops stop giving out chunks, tasks that are not started yet are skipped
+			void cancel()											noexcept;
+			///Reports error and cancels operation. Only first error is kept
+			///@param code Error code
+			void fail(ec code)										noexcept;
+			///Returns if operation is cancelled
+			bool cancelled()										const noexcept;
+			///Returns first error reported with `fail`, `ir::ec::ok` if there was none
+			ec error()												const noexcept;
+		};
+
+		///Handle of task started with `ir::Parallel::async`. Must exist until the task is finished
+		class Future
+		{
+			friend class Parallel;
+			Parallel *_pool = nullptr;
+			Task *_task = nullptr;
+			const void *_user = nullptr;
+			Future *_next = nullptr;			//future started after this one is finished
+			std::atomic<uint32> _state;			//0 if nothing was started, 1 if running, 2 if finished
+			std::atomic_flag _lock;
+			Job _job;							//job of the task and its subtasks
+
+		public:
+			///Creates empty future
+			Future()												noexcept;
+			///Returns if task is finished or was not started
+			bool try_wait()											noexcept;
+			///Waits until task is finished. Waiting thread executes other tasks of pool if it can
+			void wait()												noexcept;
+			///Starts another task after the task is finished
+			///@param next Future of the next task, must not be running
+			///@param task Task to execute
+			///@param user Pointer to pass to the task
+			bool then(Future *next, Task *task, const void *user)	noexcept;
+			///Cancels task. Task that is not started yet is skipped, the next task is still started
+			void cancel()											noexcept;
+			///Returns first error reported with `ir::Parallel::fail` by the task or its subtasks, `ir::ec::ok` if there was none. Is reset when task starts
+			ec error()												const noexcept;
+			///Waits until task is finished
+			~Future()												noexcept;
+		};
 
 	private:
-		static bool _ok;
-		
+		bool _ok = false;
+		uint32 _n = 0;
+		std::atomic_flag _call_lock;		//locked while parallel operation is in progress
+		Job *_call_job = nullptr;			//job of function in progress
+		bool _parallel(const void *user, Function *function, Job *job)	noexcept;
+		bool _operation(const void *user, Function *function, Job *job)	noexcept;
+
+		//Work-stealing scheduler
+		struct Frame
+		{
+			std::atomic<uint32> pending;		//number of unfinished tasks spawned in frame
+		};
+		struct Record
+		{
+			Task *task;
+			const void *user;
+			Frame *parent;
+			Job *job;
+		};
+		struct Slot
+		{
+			std::atomic<Task*> task;
+			std::atomic<const void*> user;
+			std::atomic<Frame*> parent;
+			std::atomic<Job*> job;
+		};
+		static const uint32 _deque_size = 0x1000;
+		struct Deque								//Chase-Lev deque, owner works with bottom, thieves with top
+		{
+			std::atomic<int64> top;
+			char padding1[64 - sizeof(std::atomic<int64>)];
+			std::atomic<int64> bottom;
+			char padding2[64 - sizeof(std::atomic<int64>)];
+			Slot slots[_deque_size];
+		};
+		struct Member								//Makes current thread member of pool while exists
+		{
+			Parallel *pool;
+			uint32 id;
+			Frame *frame;
+			Job *job;
+			Member(Parallel *pool, uint32 id)						noexcept;
+			~Member()												noexcept;
+		};
+		Deque *_deques = nullptr;
+		Frame _root;							//frame of tasks spawned outside of tasks
+		std::atomic<bool> _done;
+		QuietVector<Record> _queue;				//tasks spawned by threads that are not members of pool
+		size_t _queue_head = 0;
+		std::atomic<uint32> _queued;
+		std::atomic_flag _queue_lock;
+		static thread_local Parallel *_pool;	//pool the thread is member of
+		static thread_local uint32 _id;
+		static thread_local Frame *_frame;		//frame of executed task
+		static thread_local Job *_job;			//job of executed function or task
+		static thread_local uint32 _random;
+		static void _acquire(std::atomic_flag *lock)				noexcept;
+		bool _scheduler_init(uint32 n)								noexcept;
+		void _scheduler_finalize()									noexcept;
+		bool _spawn(Task *task, const void *user, Job *job)			noexcept;
+		bool _push(const Record &record)							noexcept;
+		bool _pop(Record *record)									noexcept;
+		bool _steal(uint32 victim, Record *record)					noexcept;
+		bool _enqueue(const Record &record)							noexcept;
+		bool _dequeue(Record *record)								noexcept;
+		bool _find(Record *record)									noexcept;
+		void _execute(const Record &record)							noexcept;
+		void _help(Frame *frame)									noexcept;
+		static void _schedule(const void *user, uint32 id, uint32)	noexcept;
+
+		//Loops
+		struct ForContext;
+		struct ReduceContext;
+		size_t _grain(size_t begin, size_t end, size_t grain)		const noexcept;
+		static void _for(const void *user, uint32 id, uint32)		noexcept;
+		static void _reduce(const void *user, uint32 id, uint32)	noexcept;
+
+		//Topology
+		struct AffinityContext;
+		QuietVector<void*> _scratch;			//scratch block of each thread, allocated by the thread
+		size_t _scratch_size = 0;
+		static bool _pin(const uint32 *processors, uint32 count)	noexcept;
+		static void _affinity_function(const void *user, uint32 id, uint32 n)	noexcept;
+		static void _scratch_function(const void *user, uint32 id, uint32)		noexcept;
+		void _free_scratch()										noexcept;
+
+		//Pipelines
+		struct PipelineContext;
+		static const size_t _pipeline_batch = 0x10;
+		static void _pipeline_pass(PipelineContext *context, uint32 stage, void *item)	noexcept;
+		static void _pipeline_stage(PipelineContext *context, uint32 stage, void **items, size_t count)	noexcept;
+		static void _pipeline_function(const void *user, uint32 id, uint32)				noexcept;
+
+		//Statistics
+		static const uint32 _event_function	= 0;
+		static const uint32 _event_task		= 1;
+		static const uint32 _event_chunk	= 2;
+		static const uint32 _event_spin		= 3;
+		static const uint32 _event_parked	= 4;
+		struct Event
+		{
+			uint32 kind;
+			uint64 begin;						//nanoseconds since set_trace
+			uint64 end;
+		};
+		struct Counters;
+		struct ProfileContext;
+		Counters *_counters = nullptr;			//for each thread
+		std::atomic<bool> _statistics;
+		std::atomic<bool> _tracing;
+		uint64 _epoch = 0;
+		static uint64 _now()										noexcept;
+		bool _profiling()											const noexcept;
+		void _record(uint32 kind, uint64 begin, uint64 end)			const noexcept;
+		static void _profile_function(const void *user, uint32 id, uint32 n)	noexcept;
+
+		//Futures
+		static void _async_function(const void *user)				noexcept;
+		void _start(Future *future)									noexcept;
+		void _wait_future(Future *future)							noexcept;
+
 		#ifndef IR_PARALLEL_IMPLEMENTATION
-			static uint32 _n;
 		#elif IR_PARALLEL_IMPLEMENTATION == 'w'
-			static Function * volatile _function;
-			static const void * volatile _user;
-			static uint32 _n;
-			static volatile uint32 _finished;
-			static volatile uint32 _task;
-			static DWORD WINAPI _windows_function(LPVOID) noexcept;
+			Function * volatile _function = nullptr;
+			const void * volatile _user = nullptr;
+			uint32 _spin = 0;
+			volatile LONG _finished = 0;
+			volatile LONG _task = 0;
+			volatile LONG _parked = 0;			//number of threads sleeping on condition variable
+			SRWLOCK _lock;
+			CONDITION_VARIABLE _condition;
+			QuietVector<HANDLE> _threads;
+			void _wait(volatile LONG *value, LONG expected)			noexcept;
+			void _wait(const std::atomic<uint32> *value, uint32 expected)	noexcept;
+			void _idle(LONG task)									noexcept;
+			void _wake()											noexcept;
+			void _stop(uint32 count)								noexcept;
+			static DWORD WINAPI _windows_function(LPVOID pool)		noexcept;
 		#elif IR_PARALLEL_IMPLEMENTATION == 'p'
-			static Function * volatile _function;
-			static const void * volatile _user;
-			static uint32 _n;
-			static volatile std::atomic<uint32> _finished;
-			static volatile std::atomic<uint32> _task;
-			static void *_posix_function(void *) noexcept;
-		#elif IR_PARALLEL_IMPLEMENTATION == 'o'
-			static uint32 _n;
+			Function * volatile _function = nullptr;
+			const void * volatile _user = nullptr;
+			uint32 _spin = 0;
+			std::atomic<uint32> _finished;
+			std::atomic<uint32> _task;
+			std::atomic<uint32> _parked;		//number of threads sleeping on condition variable
+			pthread_mutex_t _mutex;
+			pthread_cond_t _condition;
+			QuietVector<pthread_t> _threads;
+			void _wait(const std::atomic<uint32> *value, uint32 expected)	noexcept;
+			void _idle(uint32 task)									noexcept;
+			void _wake()											noexcept;
+			void _stop(uint32 count)								noexcept;
+			static void *_posix_function(void *pool)				noexcept;
 		#endif
 		
 	public:
-		///Initializes parallel system
-		///@param n Number of threads including main thread
-		static bool init(uint32 n)									noexcept;
-		///Finalizes parallel system
-		static void finalize()										noexcept;
-		///Returns if parallel system is ok
-		static bool ok()											noexcept;
-		///Executes function in parallel, returns after all threads have finished
+		///Creates uninitialized pool
+		Parallel()													noexcept;
+		///Initializes pool and starts its threads
+		///@param n Number of threads including calling thread
+		///@param spin Number of checks a waiting thread makes before it goes to sleep. Bigger values reduce latency of `parallel`, smaller values free processor sooner. Is used by Windows and Posix implementations
+		bool init(uint32 n, uint32 spin = 0x8000)					noexcept;
+		///Waits for spawned tasks and stops threads of pool
+		void finalize()												noexcept;
+		///Returns if pool is ok
+		bool ok()													const noexcept;
+		///Returns number of threads including calling thread
+		uint32 n()													const noexcept;
+		///Pins threads of pool to processors. Calling thread (number `0`) is not pinned. Is supported on Windows and Linux. Fails if called by thread of the pool
+		///@param mode Placement of threads
+		bool set_affinity(affinity mode)							noexcept;
+		///Allocates zeroed scratch block for every thread. Every block is allocated and touched by its own thread, so its memory is placed on NUMA node of the thread. Previous blocks are freed. Fails if called by thread of the pool
+		///@param size Size of one block in bytes
+		bool set_scratch(size_t size)								noexcept;
+		///Returns scratch block of thread allocated with `set_scratch`
+		///@param id Thread number, from `0` to `n - 1`
+		void *scratch(uint32 id)									const noexcept;
+		///Enables or disables counting of statistics for every thread and resets counters. Must be called while pool is idle
+		///@param enable Count statistics
+		bool set_statistics(bool enable)							noexcept;
+		///Enables or disables recording of trace and clears recorded trace. Must be called while pool is idle
+		///@param enable Record trace
+		bool set_trace(bool enable)									noexcept;
+		///Returns snapshot of statistics of thread
+		///@param id Thread number, from `0` to `n - 1`
+		///@param statistics Structure that receives statistics
+		bool statistics(uint32 id, Statistics *statistics)			const noexcept;
+		///Returns number of tasks waiting in queue of tasks spawned outside of pool
+		size_t queued()												const noexcept;
+		///Saves recorded trace in Chrome trace format (JSON), the file can be opened with `chrome://tracing` or Perfetto. Must be called while pool is idle
+		///@param path Path to file
+		ec save_trace(const schar *path)							const noexcept;
+		///Returns number of logical processors
+		static uint32 processor_count()								noexcept;
+		///Returns number of NUMA nodes
+		static uint32 node_count()									noexcept;
+		///Returns NUMA node of logical processor
+		///@param processor Processor number, from `0` to `processor_count() - 1`
+		static uint32 node(uint32 processor)						noexcept;
+		///Cancels job of the function or task executed by calling thread, see `ir::Parallel::Job::cancel`. Does nothing if it has no job
+		void cancel()												noexcept;
+		///Reports error to job of the function or task executed by calling thread and cancels it, see `ir::Parallel::Job::fail`. Does nothing if it has no job
+		///@param code Error code
+		void fail(ec code)											noexcept;
+		///Returns if job of the function or task executed by calling thread is cancelled. Is cheap enough to be checked in inner loops
+		bool cancelled()											const noexcept;
+		///Executes function in parallel, returns after all threads have finished. Calls from different threads are executed one after another. Calls from functions and tasks of the same pool are executed by calling thread alone, with every thread number in turn. Returns false if error was reported with `fail`
 		///@param user Pointer to pass to the function
 		///@param function Function to execute
-		static bool parallel(const void *user, Function *function)	noexcept;
+		///@param job Job that receives cancellation and error of the operation, `nullptr` to use temporary one
+		bool parallel(const void *user, Function *function, Job *job = nullptr)	noexcept;
+		///Adds task to work-stealing scheduler. Is thread-safe. Tasks spawned outside of tasks are queued and are started by idle threads immediately (Windows and Posix implementations) or on `sync`
+		///@param task Task to execute
+		///@param user Pointer to pass to the task
+		///@param job Job of the task, `nullptr` to take job of the function or task executed by calling thread. Errors of the job are read with `ir::Parallel::Job::error` after `sync`
+		bool spawn(Task *task, const void *user, Job *job = nullptr)	noexcept;
+		///Waits until all tasks spawned by current task and their subtasks are finished. If called outside of tasks, waits for all tasks spawned outside of tasks. Waiting threads execute other tasks
+		bool sync()													noexcept;
+		///Executes pipeline. Calling thread produces items with source, all threads pass them through stages. Stages are connected with lock-free rings, items are passed between stages in batches. If ring is full, the thread passes the item through the following stages itself, so producers are slowed down to speed of consumers. One stage may be executed by several threads, so order of items is not preserved. Calls from functions and tasks of the same pool are executed by calling thread, see `parallel`
+		///@param user Pointer to pass to source and stages
+		///@param source Function that produces items
+		///@param stages Array of stages
+		///@param count Number of stages
+		///@param capacity Size of ring between two stages
+		///@param job Job that receives cancellation and error of the operation, `nullptr` to use temporary one
+		bool pipeline(const void *user, Source *source, Stage *const *stages, uint32 count, size_t capacity = 0x100, Job *job = nullptr)	noexcept;
+		///Starts task asynchronously and returns without waiting. Windows and Posix implementations start the task on idle threads immediately, other implementations start it on `ir::Parallel::Future::wait` or `sync`. Task and its subtasks get job of the future. Task may call operations of the pool, they are executed by the thread that executes the task
+		///@param future Future that receives the handle, must not be running
+		///@param task Task to execute
+		///@param user Pointer to pass to the task
+		bool async(Future *future, Task *task, const void *user)	noexcept;
+		///Executes loop in parallel. Threads claim chunks of the range one after another, so uneven iterations are balanced. Calls from functions and tasks of the same pool are executed by calling thread, see `parallel`
+		///@param begin First index
+		///@param end Index after last index
+		///@param grain Number of indices in one chunk, `0` to choose automatically
+		///@param user Pointer to pass to the body
+		///@param body Function that processes a chunk
+		///@param job Job that receives cancellation and error of the operation, `nullptr` to use temporary one
+		bool parallel_for(size_t begin, size_t end, size_t grain, const void *user, Range *body, Job *job = nullptr)	noexcept;
+		///Executes reduction in parallel. Every thread accumulates its chunks in its own accumulator, accumulators are combined after the loop. Calls from functions and tasks of the same pool are executed by calling thread, see `parallel`
+		///@param begin First index
+		///@param end Index after last index
+		///@param grain Number of indices in one chunk, `0` to choose automatically
+		///@param user Pointer to pass to the body
+		///@param body Function that processes a chunk
+		///@param combine Function that combines accumulators
+		///@param result Accumulator that contains identity value on input and result on output. Accumulators of threads are its bytewise copies
+		///@param size Size of accumulator in bytes
+		///@param job Job that receives cancellation and error of the operation, `nullptr` to use temporary one
+		bool parallel_reduce(size_t begin, size_t end, size_t grain, const void *user, Reduce *body, Combine *combine, void *result, size_t size, Job *job = nullptr)	noexcept;
+		///Finalizes pool
+		~Parallel()													noexcept;
 	};
 
 ///@}
@@ -0,0 +1,92 @@
+/*
+	Part of the Ironic Project. Distributed under MIT License, which means:
+		- Do whatever you want
+		- Keep this notice and include the license file to your project
+		- I provide no warranty
+	To get help with installation, visit README
+	Created by Kyrylo Sovailo, github.com/Meta-chan, k.sovailo@gmail.com
+	Reinventing bicycles since 2020
+*/
+
+#ifndef IR_QUIET_ATOMIC_RING
+#define IR_QUIET_ATOMIC_RING
+
+#include <stddef.h>
+#include <atomic>
+
+namespace ir
+{
+///@addtogroup container Containers
+///@{
+	
+	///Ironic library's bounded FIFO ring buffer that can be written and read by many threads at the same time without locks.
+	///Is useful to connect producer and consumer threads. Is not copyable
+	template<class T> class QuietAtomicRing
+	{
+	private:
+		struct Cell
+		{
+			std::atomic<size_t> sequence;	//position the cell is ready for: equal to position if cell is free, position + 1 if cell is written
+			T data;
+		};
+		Cell *_data = nullptr;
+		size_t _size = 0;
+		char _padding1[64];
+		std::atomic<size_t> _head;			//position of next write
+		char _padding2[64];
+		std::atomic<size_t> _tail;			//position of next read
+		char _padding3[64];
+
+	public:
+		///Creates empty ring
+		QuietAtomicRing()									noexcept;
+		///Creates quiet atomic ring
+		///@param size Minimal size of ring buffer, is rounded to power of two
+		QuietAtomicRing(size_t size)						noexcept;
+		///Initializes quiet atomic ring. Must not be called while ring is used
+		///@param size Minimal size of ring buffer, is rounded to power of two
+		bool init(size_t size)								noexcept;
+		///Returns if ring is properly initialized
+		bool ok()											const noexcept;
+		///Writes one element to ring, returns `false` if ring is full
+		///@param data Element to write
+		bool write(const T &data)							noexcept;
+		///Writes as many elements as possible in one step, returns number of written elements
+		///@param count Number of elements
+		///@param data Elements to write
+		size_t write(size_t count, const T *data)			noexcept;
+		///Reads one element from ring, returns `false` if ring is empty
+		///@param data Buffer to read element
+		bool read(T *data)									noexcept;
+		///Reads as many elements as possible in one step, returns number of read elements
+		///@param count Maximal number of elements to read
+		///@param data Buffer to read elements
+		size_t read(size_t count, T *data)					noexcept;
+		///Returns approximate number of currently stored elements
+		size_t count()										const noexcept;
+		///Returns size of ring
+		size_t size()										const noexcept;
+		///Clears ring and frees resources. Must not be called while ring is used
+		void clear()										noexcept;
+		///Destroys ring
+		~QuietAtomicRing()									noexcept;
+	};
+
+///@}
+}
+
+#endif //#ifndef IR_QUIET_ATOMIC_RING
+
+#if defined(IR_EXCLUDE) ? defined(IR_INCLUDE_QUIET_ATOMIC_RING) : !defined(IR_EXCLUDE_QUIET_ATOMIC_RING)
+	#ifndef IR_INCLUDE
+		#ifndef IR_QUIET_ATOMIC_RING_TEMPLATE_SOURCE
+			#define IR_QUIET_ATOMIC_RING_TEMPLATE_SOURCE
+			#include "../../source/template/quiet_atomic_ring.h"
+		#endif
+	#elif IR_INCLUDE == 't' || IR_INCLUDE == 'a'
+		#ifndef IR_QUIET_ATOMIC_RING_TEMPLATE_SOURCE
+			#define IR_QUIET_ATOMIC_RING_TEMPLATE_SOURCE
+			#include "../../source/template/quiet_atomic_ring.h"
+		#endif
+	#endif
+#endif
@@ -21,11 +21,14 @@
 
 namespace ir
 {
+	class Parallel;
+
 ///@addtogroup database Databases
 ///@{
 
 	///String to String Table Database
 	///String should be understood as any sequence of bytes
+	///Database can be opened by one writer and many readers, also in different processes. Changes of writer are visible to readers unless writer keeps files in RAM
 	class S2STDatabase : public Database
 	{
 	protected:	
@@ -39,7 +42,7 @@ namespace ir
 		struct MetaHeader
 		{
 			unsigned char signature[7]	= { 'I', 'S', '2', 'S', 'T', 'D', 'M' };
-			unsigned char version		= 1;
+			unsigned char version		= 2;
 			uint32 count				= 0;
 			uint32 delcount				= 0;
 			uint32 used					= 0;
@@ -51,6 +54,7 @@ namespace ir
 			uint32 keysize : 31;
 			uint32 deleted : 1;
 			uint32 datasize;
+			uint32 datacapacity;		//space reserved for value, not less than datasize
 			MetaCell() noexcept;
 		};
 
@@ -61,6 +65,7 @@ namespace ir
 			uint32 size		= 0;		//if hold duplicates ram.size(), otherwise duplicates file size
 			FILE *file		= nullptr;	//if !hold is file, otherwise invalid
 			bool changed	= false;	//if hold defines if file was changed, otherwise invalid
+			bool written	= false;	//if !hold defines if last operation was write, so reading needs seeking, otherwise invalid
 		};
 
 		struct : FileMetaCommon
@@ -80,20 +85,49 @@ namespace ir
 		bool _beta			= false;
 		bool _ok			= false;
 		bool _writeaccess	= false;
+		bool _legacy		= false;	//meta file is of version 1, its cells have no capacity
 		ir::Mapping _mapping;
+		access_pattern _pattern	= access_pattern::normal;
+		bool _logging		= false;
+		QuietVector<uint32> _log;	//access counts of main file regions, valid if logging
+		Shared _shared;
+		QuietVector<char> _readbuffer;	//copy of data last read by reader
+		Parallel *_parallel	= nullptr;
 		
 		//Primitive read & write section
 		static uint32 _align(uint32 i)											noexcept;
 		ec _read(void *buffer, uint32 offset, uint32 size)						noexcept;
 		ec _write(const void *buffer, uint32 offset, uint32 size)				noexcept;
+		ec _copy(uint32 source, uint32 destination, uint32 size)				noexcept;
+		ec _reserve(uint32 end)													noexcept;
 		ec _readpointer(void **p, uint32 offset, uint32 size)					noexcept;
 		ec _metaread(MetaCell *cell, uint32 index)								noexcept;
 		ec _metawrite(MetaCell cell, uint32 index)								noexcept;
+		uint32 _metaheadersize()												const noexcept;
+		uint32 _metacellsize()													const noexcept;
 
 		//Complex section
 		ec _find(Block key, uint32 *metaoffset, MetaCell *cell)					noexcept;
 		ec _rehash(uint32 newmetasize)											noexcept;
 
+		//Parallel section, used if database is kept in RAM and pool is given with set_parallel
+		static const uint32 _parallel_threshold = 0x10000;
+		struct RehashContext;
+		struct OptimizeContext;
+		static uint32 _parallel_part(const RehashContext *context, uint32 home)			noexcept;
+		static void _parallel_hash(const void *user, uint32, size_t begin, size_t end)	noexcept;
+		static void _parallel_bucket(const void *user, uint32, size_t begin, size_t end)	noexcept;
+		static void _parallel_place(const void *user, uint32, size_t begin, size_t end)	noexcept;
+		static void _parallel_copy(const void *user, uint32, size_t begin, size_t end)	noexcept;
+		bool _parallel_possible()												const noexcept;
+		ec _parallel_rehash(uint32 newmetasize)									noexcept;
+		ec _parallel_optimize(S2STDatabase *beta)								noexcept;
+
+		//Multi-process section
+		friend class Database;
+		typedef Database::Modification<S2STDatabase> Modification;
+		bool _unstable()														const noexcept;
+
 		//Init section
 		ec _check()																noexcept;
 		ec _reopen_write(bool createnew)										noexcept;
@@ -120,6 +154,12 @@ namespace ir
 		///@param key String identifier
 		///@param data Pointer to ir::Block to receive result
 		ec read(Block key, Block *data)											noexcept;
+		///Reads part of value related to identifier. Only the requested part is read from main file. Is thread-safe if `set_ram_mode(true, true)` was done
+		///@param key String identifier
+		///@param offset Offset of the part in value, in bytes
+		///@param size Size of the part, in bytes
+		///@param data Pointer to ir::Block to receive result
+		ec read_range(Block key, uint32 offset, uint32 size, Block *data)		noexcept;
 		///Reads value of given index from table. May be used to search in database
 		///@param index Index in table
 		///@param key Pointer to ir::Block to receive identifier, may be `nullptr`
@@ -130,6 +170,16 @@ namespace ir
 		///@param data Related value
 		///@param mode Insertion mode
 		ec insert(Block key, Block data, insert_mode mode = insert_mode::always)noexcept;
+		///Overwrites part of value related to identifier. The part must lie inside of the value
+		///@param key String identifier
+		///@param offset Offset of the part in value, in bytes
+		///@param data New content of the part
+		ec write_range(Block key, uint32 offset, Block data)					noexcept;
+		///Appends data to value related to identifier, or inserts it if identifier does not exist. Is done in place if value has enough reserved space or is last in main file, otherwise value is moved to the end of main file
+		///@param key String identifier
+		///@param data Data to append
+		///@param reserve Space to reserve after the value if it is moved or grown, in bytes. Makes next appends be done in place
+		ec append(Block key, Block data, uint32 reserve = 0)					noexcept;
 		///Delete value from database
 		///@param key String identifier
 		///@param mode Deletion mode
@@ -152,7 +202,19 @@ namespace ir
 		///@param holdfile Hold main file in RAM
 		///@param holdmeta Hold table in RAM
 		ec set_ram_mode(bool holdfile, bool holdmeta)							noexcept;
-		///Optimizes database for size
+		///Tells how values are going to be read, so operating system can adjust read-ahead for files and mappings of database. Is kept until `finalize`
+		///@param pattern Access pattern
+		ec hint(access_pattern pattern)											noexcept;
+		///Tells if reads of main file need to be counted. If they are, the most accessed regions are written to access log file (with suffix `~l`) on `finalize`, and `warm_up` can prefetch them next time
+		///@param log Count reads
+		ec set_access_log(bool log)												noexcept;
+		///Starts background thread that prefetches table into operating system cache. Is useful right after `init` if database is not kept in RAM. Does not block
+		///@param data Also prefetch the most accessed regions of main file recorded in access log
+		ec warm_up(bool data = true)											noexcept;
+		///Tells which pool of threads to use for rehashing and `optimize`. Pool is used only if `set_ram_mode(true, true)` was done. Databases with main or meta file on hard drive are rehashed and optimized in calling thread, because all reads and writes of a file go through its single file position. Is kept until `finalize`
+		///@param parallel Initialized pool or `nullptr` to work in calling thread only
+		ec set_parallel(Parallel *parallel)										noexcept;
+		///Optimizes database for size. Is done in parallel if pool was given with `set_parallel` and `set_ram_mode(true, true)` was done
 		ec optimize()															noexcept;
 		///Finalized database and frees resources
 		void finalize()															noexcept;
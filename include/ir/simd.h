@@ -0,0 +1,117 @@
+/*
+	Part of the Ironic Project. Distributed under MIT License, which means:
+		- Do whatever you want
+		- Keep this notice and include the license file to your project
+		- I provide no warranty
+	To get help with installation, visit README
+	Created by Kyrylo Sovailo, github.com/Meta-chan, k.sovailo@gmail.com
+	Reinventing bicycles since 2020
+*/
+
+#ifndef IR_SIMD
+#define IR_SIMD
+
+#include "types.h"
+#include <stddef.h>
+
+#ifndef IR_RESTRICT
+	#define IR_RESTRICT __restrict
+#endif
+
+namespace ir
+{
+///@addtogroup hiperf Hight performance computing
+///@{
+
+	///Instruction set extensions used by kernels of `ir::Matrix` and `ir::Neuro`
+	enum class simd
+	{
+		none,		///< Portable C++ code
+		sse2,		///< x86 SSE2, 128 bits
+		avx2,		///< x86 AVX2 and FMA, 256 bits
+		avx512,		///< x86 AVX-512F, 512 bits
+		neon		///< ARMv8 NEON, 128 bits
+	};
+
+	///Returns widest instruction set extension supported by processor, operating system and compiler@n
+	///The extension is detected once. Environment variable `IR_SIMD` with value `none`, `sse2`, `avx2`, `avx512` or `neon` may lower it, which is useful for testing and benchmarking
+	inline simd simd_level()																noexcept;
+
+	///Table of kernels for type `T`, selected once according to `ir::simd_level`@n
+	///Kernels for `float` and `double` use SIMD instructions, kernels for other types are portable C++ code
+	///@tparam T Basic type
+	template<class T> struct Kernels
+	{
+		simd level;																			///< Instruction set extension used by kernels
+		T (*dot)(size_t n, const T *IR_RESTRICT a, const T *IR_RESTRICT b);					///< Returns dot product of arrays `a` and `b`
+		void (*axpy)(size_t n, T alpha, const T *IR_RESTRICT x, T *IR_RESTRICT y);			///< Adds array `x` multiplied by `alpha` to array `y`
+		///Assigns `4 x nr` row-major array `c` to product of packed slivers: `c[r][j] = sum(a[p][r] * b[p][j])`, where `a` is `depth x 4` and `b` is `depth x nr`. `nr` must be multiple of 64 bytes
+		void (*block)(size_t depth, const T *IR_RESTRICT a, const T *IR_RESTRICT b, size_t nr, T *IR_RESTRICT c);
+		///Returns kernels for current processor
+		static inline const Kernels *get()													noexcept;
+	};
+	template<> inline const Kernels<float> *Kernels<float>::get()							noexcept;
+	template<> inline const Kernels<double> *Kernels<double>::get()							noexcept;
+
+	///Table of 8-bit integer kernels used by quantized inference, selected once according to `ir::simd_level`@n
+	///With AVX-512, kernels use VNNI if processor supports it
+	struct Int8Kernels
+	{
+		simd level;																			///< Instruction set extension used by kernels
+		///Returns dot product of arrays `a` and `b`, values need to be from `-127` to `127`
+		int32 (*dot)(size_t n, const int8 *IR_RESTRICT a, const int8 *IR_RESTRICT b);
+		///Returns kernels for current processor
+		static inline const Int8Kernels *get()												noexcept;
+	};
+
+	///Half-precision floating point number (IEEE 754 binary16), used only for storage
+	struct half { uint16 bits; };
+	///Brain floating point number (upper half of IEEE 754 binary32), used only for storage
+	struct bfloat16 { uint16 bits; };
+	///Converts `float` to `ir::half`, rounds to nearest even
+	inline half to_half(float value)														noexcept;
+	///Converts `float` to `ir::bfloat16`, rounds to nearest even
+	inline bfloat16 to_bfloat16(float value)												noexcept;
+	///Converts `ir::half` to `float`
+	inline float to_float(half value)														noexcept;
+	///Converts `ir::bfloat16` to `float`
+	inline float to_float(bfloat16 value)													noexcept;
+
+	///Table of kernels for 16-bit floating point storage, selected once according to `ir::simd_level`@n
+	///Numbers are converted to `float` on load, computations are done in `float`. Conversion of `ir::half` uses F16C on x86 and is always available on ARMv8
+	///@tparam H `ir::half` or `ir::bfloat16`
+	template<class H> struct HalfKernels
+	{
+		simd level;																			///< Instruction set extension used by kernels
+		void (*load)(size_t n, const H *IR_RESTRICT source, float *IR_RESTRICT destination);	///< Converts array to `float`
+		void (*store)(size_t n, const float *IR_RESTRICT source, H *IR_RESTRICT destination);	///< Converts array from `float`, rounds to nearest even
+		float (*dot)(size_t n, const H *IR_RESTRICT a, const float *IR_RESTRICT b);			///< Returns dot product of arrays, accumulated in `float`
+		///Returns kernels for current processor
+		static inline const HalfKernels *get()												noexcept;
+	};
+	template<> inline const HalfKernels<half> *HalfKernels<half>::get()						noexcept;
+	template<> inline const HalfKernels<bfloat16> *HalfKernels<bfloat16>::get()				noexcept;
+
+///@}
+}
+
+#endif	//#ifndef IR_SIMD
+
+#if defined(IR_EXCLUDE) ? defined(IR_INCLUDE_SIMD) : !defined(IR_EXCLUDE_SIMD)
+	#ifndef IR_INCLUDE
+		#ifndef IR_SIMD_INLINE_SOURCE
+			#define IR_SIMD_INLINE_SOURCE
+			#include "../../source/inline/simd.h"
+		#endif
+	#elif IR_INCLUDE == 'i'
+		#ifndef IR_SIMD_INLINE_SOURCE
+			#define IR_SIMD_INLINE_SOURCE
+			#include "../../source/inline/simd.h"
+		#endif
+	#elif IR_INCLUDE == 't' || IR_INCLUDE == 'a'
+		#ifndef IR_SIMD_INLINE_SOURCE
+			#define IR_SIMD_INLINE_SOURCE
+			#include "../../source/inline/simd.h"
+		#endif
+	#endif
+#endif
\ No newline at end of file
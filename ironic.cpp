@@ -27,6 +27,7 @@
 #include "ir/include/neuro.h"
 #include "ir/include/parallel.h"
 #include "ir/include/print.h"
+#include "ir/include/quiet_atomic_ring.h"
 #include "ir/include/quiet_hash_map.h"
 #include "ir/include/quiet_list.h"
 #include "ir/include/quiet_map.h"
@@ -34,6 +35,7 @@
 #include "ir/include/quiet_vector.h"
 #include "ir/include/resource.h"
 #include "ir/include/s2st_database.h"
+#include "ir/include/simd.h"
 #include "ir/include/sink.h"
 #include "ir/include/source.h"
 #include "ir/include/str.h"
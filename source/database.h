@@ -0,0 +1,543 @@
+/*
+	Part of the Ironic Project. Distributed under MIT License, which means:
+		- Do whatever you want
+		- Keep this notice and include the license file to your project
+		- I provide no warranty
+	To get help with installation, visit README
+	Created by Kyrylo Sovailo, github.com/Meta-chan, k.sovailo@gmail.com
+	Reinventing bicycles since 2020
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+	#include <share.h>
+#else
+	#include <fcntl.h>
+	#include <pthread.h>
+	#include <sched.h>
+	#include <unistd.h>
+	#include <sys/stat.h>
+	#include <sys/mman.h>
+#endif
+
+void ir::Database::_log_touch(QuietVector<uint32> *log, uint32 offset, uint32 size) noexcept
+{
+	uint32 first = offset / _log_granularity;
+	uint32 last = (size == 0 ? offset : offset + size - 1) / _log_granularity;
+	if (last >= log->size() && !log->resize(last + 1)) return;
+	for (uint32 i = first; i <= last; i++)
+	{
+		if ((*log)[i] != 0xFFFFFFFF) (*log)[i]++;
+	}
+}
+
+//Writes numbers of the most accessed regions to access log file, sorted by position in main file
+ir::ec ir::Database::_log_save(QuietVector<schar> *path, const QuietVector<uint32> &log) noexcept
+{
+	struct Region
+	{
+		uint32 count;
+		uint32 number;
+	};
+
+	QuietVector<Region> regions;
+	for (uint32 i = 0; i < log.size(); i++)
+	{
+		if (log[i] == 0) continue;
+		Region region;
+		region.count = log[i];
+		region.number = i;
+		if (!regions.push_back(region)) return ec::alloc;
+	}
+
+	if (regions.size() > _log_regions)
+	{
+		qsort(regions.data(), regions.size(), sizeof(Region), [](const void *a, const void *b) -> int
+		{
+			uint32 acount = ((const Region*)a)->count, bcount = ((const Region*)b)->count;
+			return acount > bcount ? -1 : acount < bcount ? 1 : 0;
+		});
+		regions.resize(_log_regions);
+		qsort(regions.data(), regions.size(), sizeof(Region), [](const void *a, const void *b) -> int
+		{
+			uint32 anumber = ((const Region*)a)->number, bnumber = ((const Region*)b)->number;
+			return anumber < bnumber ? -1 : anumber > bnumber ? 1 : 0;
+		});
+	}
+
+	(*path)[path->size() - 2] = 'l';
+	#ifdef _WIN32
+		FILE *file = _wfsopen(path->data(), L"wb", _SH_DENYNO);
+	#else
+		FILE *file = fopen(path->data(), "wb");
+	#endif
+	if (file == nullptr) return ec::create_file;
+
+	LogHeader header;
+	header.granularity = _log_granularity;
+	header.count = (uint32)regions.size();
+	bool ok = fwrite(&header, sizeof(LogHeader), 1, file) != 0;
+	for (uint32 i = 0; ok && i < regions.size(); i++)
+	{
+		ok = fwrite(&regions[i].number, sizeof(uint32), 1, file) != 0;
+	}
+	fclose(file);
+	return ok ? ec::ok : ec::write_file;
+}
+
+ir::ec ir::Database::_advise(FILE *file, access_pattern pattern) noexcept
+{
+	if (file == nullptr) return ec::ok;
+	#if !defined(_WIN32) && defined(POSIX_FADV_NORMAL)
+		int advice = POSIX_FADV_NORMAL;
+		if (pattern == access_pattern::sequential) advice = POSIX_FADV_SEQUENTIAL;
+		else if (pattern == access_pattern::random) advice = POSIX_FADV_RANDOM;
+		if (posix_fadvise(fileno(file), 0, 0, advice) != 0) return ec::other;
+	#else
+		(void)pattern;
+	#endif
+	return ec::ok;
+}
+
+void ir::Database::_prefetch(FILE *file, uint32 offset, uint32 size) noexcept
+{
+	#if !defined(_WIN32) && defined(POSIX_FADV_WILLNEED)
+		posix_fadvise(fileno(file), offset, size, POSIX_FADV_WILLNEED);
+	#else
+		//No asynchronous read-ahead, read through the file to fill the cache
+		char buffer[4096];
+		if (fseek(file, offset, SEEK_SET) != 0) return;
+		while (size > 0)
+		{
+			uint32 portion = size < sizeof(buffer) ? size : sizeof(buffer);
+			if (fread(buffer, portion, 1, file) == 0) return;
+			size -= portion;
+		}
+	#endif
+}
+
+void ir::Database::_warm(WarmContext *context) noexcept
+{
+	QuietVector<schar> &path = context->path;
+
+	//META
+	path[path.size() - 2] = context->meta;
+	#ifdef _WIN32
+		FILE *meta = _wfsopen(path.data(), L"rb", _SH_DENYNO);
+	#else
+		FILE *meta = fopen(path.data(), "rb");
+	#endif
+	if (meta == nullptr) return;
+	if (fseek(meta, 0, SEEK_END) == 0) _prefetch(meta, 0, (uint32)ftell(meta));
+	fclose(meta);
+	if (!context->data) return;
+
+	//LOG
+	path[path.size() - 2] = 'l';
+	#ifdef _WIN32
+		FILE *log = _wfsopen(path.data(), L"rb", _SH_DENYNO);
+	#else
+		FILE *log = fopen(path.data(), "rb");
+	#endif
+	if (log == nullptr) return;
+	LogHeader header, sample;
+	QuietVector<uint32> regions;
+	bool ok = fread(&header, sizeof(LogHeader), 1, log) != 0
+		&& memcmp(header.signature, sample.signature, 7) == 0
+		&& header.version == sample.version
+		&& header.granularity != 0
+		&& header.count <= _log_regions
+		&& regions.resize(header.count)
+		&& (header.count == 0 || fread(regions.data(), sizeof(uint32), header.count, log) == header.count);
+	fclose(log);
+	if (!ok) return;
+
+	//FILE
+	path[path.size() - 2] = context->file;
+	#ifdef _WIN32
+		FILE *file = _wfsopen(path.data(), L"rb", _SH_DENYNO);
+	#else
+		FILE *file = fopen(path.data(), "rb");
+	#endif
+	if (file == nullptr) return;
+	if (fseek(file, 0, SEEK_END) == 0)
+	{
+		uint64 filesize = (uint64)ftell(file);
+		for (uint32 i = 0; i < regions.size(); i++)
+		{
+			uint64 offset = (uint64)regions[i] * header.granularity;
+			if (offset >= filesize) break;
+			uint64 size = filesize - offset < header.granularity ? filesize - offset : header.granularity;
+			_prefetch(file, (uint32)offset, (uint32)size);
+		}
+	}
+	fclose(file);
+}
+
+#ifdef _WIN32
+	DWORD WINAPI ir::Database::_warm_function(LPVOID context) noexcept
+	{
+		_warm((WarmContext*)context);
+		((WarmContext*)context)->~WarmContext();
+		free(context);
+		return 0;
+	}
+#else
+	void *ir::Database::_warm_function(void *context) noexcept
+	{
+		_warm((WarmContext*)context);
+		((WarmContext*)context)->~WarmContext();
+		free(context);
+		return nullptr;
+	}
+#endif
+
+//Starts detached thread that prefetches database files. Thread works with it's own copy of path and own file handles
+ir::ec ir::Database::_warm_up(QuietVector<schar> *path, schar meta, schar file, bool data) noexcept
+{
+	WarmContext *context = (WarmContext*)malloc(sizeof(WarmContext));
+	if (context == nullptr) return ec::alloc;
+	new(context) WarmContext;
+	if (!context->path.resize(path->size()))
+	{
+		context->~WarmContext();
+		free(context);
+		return ec::alloc;
+	}
+	memcpy(context->path.data(), path->data(), path->size() * sizeof(schar));
+	context->meta = meta;
+	context->file = file;
+	context->data = data;
+
+	#ifdef _WIN32
+		HANDLE thread = CreateThread(nullptr, 0, _warm_function, context, 0, nullptr);
+		if (thread == NULL)
+		{
+			context->~WarmContext();
+			free(context);
+			return ec::other;
+		}
+		CloseHandle(thread);
+	#else
+		pthread_t thread;
+		if (pthread_create(&thread, nullptr, _warm_function, context) != 0)
+		{
+			context->~WarmContext();
+			free(context);
+			return ec::other;
+		}
+		pthread_detach(thread);
+	#endif
+	return ec::ok;
+}
+
+#ifdef _WIN32
+
+bool ir::Database::_shared_lock(Shared *shared, uint32 offset, bool exclusive) noexcept
+{
+	OVERLAPPED overlapped;
+	memset(&overlapped, 0, sizeof(OVERLAPPED));
+	overlapped.Offset = offset;
+	DWORD flags = LOCKFILE_FAIL_IMMEDIATELY | (exclusive ? LOCKFILE_EXCLUSIVE_LOCK : 0);
+	return LockFileEx(shared->file, flags, 0, 1, 0, &overlapped) != FALSE;
+}
+
+void ir::Database::_shared_unlock(Shared *shared, uint32 offset) noexcept
+{
+	OVERLAPPED overlapped;
+	memset(&overlapped, 0, sizeof(OVERLAPPED));
+	overlapped.Offset = offset;
+	UnlockFileEx(shared->file, 0, 1, 0, &overlapped);
+}
+
+bool ir::Database::_shared_free(const Shared *shared, uint32 offset) noexcept
+{
+	OVERLAPPED overlapped;
+	memset(&overlapped, 0, sizeof(OVERLAPPED));
+	overlapped.Offset = offset;
+	if (LockFileEx(shared->file, LOCKFILE_FAIL_IMMEDIATELY | LOCKFILE_EXCLUSIVE_LOCK, 0, 1, 0, &overlapped) == FALSE) return false;
+	UnlockFileEx(shared->file, 0, 1, 0, &overlapped);
+	return true;
+}
+
+ir::ec ir::Database::_shared_open(QuietVector<schar> *path, create_mode mode, Shared *shared) noexcept
+{
+	(*path)[path->size() - 2] = 's';
+	shared->file = CreateFileW(path->data(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+		nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (shared->file == INVALID_HANDLE_VALUE) return mode == create_mode::read ? ec::ok : ec::create_file;
+
+	bool locked = (mode == create_mode::read) ?
+		_shared_lock(shared, _shared_reader_lock, false) :
+		_shared_lock(shared, _shared_writer_lock, true) && (mode == create_mode::edit || _shared_lock(shared, _shared_reader_lock, true));
+	if (!locked)
+	{
+		_shared_close(shared);
+		return ec::locked;
+	}
+
+	shared->mapping = CreateFileMappingW(shared->file, nullptr, PAGE_READWRITE, 0, sizeof(SharedHeader), nullptr);
+	void *view = (shared->mapping == NULL) ? nullptr : MapViewOfFile(shared->mapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(SharedHeader));
+	if (view == nullptr)
+	{
+		_shared_close(shared);
+		return ec::mapping;
+	}
+	shared->header = (SharedHeader*)view;
+#else
+
+bool ir::Database::_shared_lock(Shared *shared, uint32 offset, bool exclusive) noexcept
+{
+	struct flock lock;
+	memset(&lock, 0, sizeof(struct flock));
+	lock.l_type = exclusive ? F_WRLCK : F_RDLCK;
+	lock.l_whence = SEEK_SET;
+	lock.l_start = offset;
+	lock.l_len = 1;
+	#ifdef F_OFD_SETLK
+		return fcntl(shared->file, F_OFD_SETLK, &lock) == 0;
+	#else
+		return fcntl(shared->file, F_SETLK, &lock) == 0;
+	#endif
+}
+
+void ir::Database::_shared_unlock(Shared *shared, uint32 offset) noexcept
+{
+	struct flock lock;
+	memset(&lock, 0, sizeof(struct flock));
+	lock.l_type = F_UNLCK;
+	lock.l_whence = SEEK_SET;
+	lock.l_start = offset;
+	lock.l_len = 1;
+	#ifdef F_OFD_SETLK
+		fcntl(shared->file, F_OFD_SETLK, &lock);
+	#else
+		fcntl(shared->file, F_SETLK, &lock);
+	#endif
+}
+
+bool ir::Database::_shared_free(const Shared *shared, uint32 offset) noexcept
+{
+	struct flock lock;
+	memset(&lock, 0, sizeof(struct flock));
+	lock.l_type = F_WRLCK;
+	lock.l_whence = SEEK_SET;
+	lock.l_start = offset;
+	lock.l_len = 1;
+	#ifdef F_OFD_GETLK
+		if (fcntl(shared->file, F_OFD_GETLK, &lock) != 0) return false;
+	#else
+		if (fcntl(shared->file, F_GETLK, &lock) != 0) return false;
+	#endif
+	return lock.l_type == F_UNLCK;
+}
+
+ir::ec ir::Database::_shared_open(QuietVector<schar> *path, create_mode mode, Shared *shared) noexcept
+{
+	(*path)[path->size() - 2] = 's';
+	shared->file = open(path->data(), O_RDWR | O_CREAT, 0666);
+	if (shared->file < 0) return mode == create_mode::read ? ec::ok : ec::create_file;
+
+	bool locked = (mode == create_mode::read) ?
+		_shared_lock(shared, _shared_reader_lock, false) :
+		_shared_lock(shared, _shared_writer_lock, true) && (mode == create_mode::edit || _shared_lock(shared, _shared_reader_lock, true));
+	if (!locked)
+	{
+		_shared_close(shared);
+		return ec::locked;
+	}
+
+	//Extending with zeros is safe even if other process has already written the header
+	struct stat status;
+	if (fstat(shared->file, &status) != 0 || (status.st_size < (off_t)sizeof(SharedHeader) && ftruncate(shared->file, sizeof(SharedHeader)) != 0))
+	{
+		_shared_close(shared);
+		return ec::write_file;
+	}
+	void *view = mmap(nullptr, sizeof(SharedHeader), PROT_READ | PROT_WRITE, MAP_SHARED, shared->file, 0);
+	if (view == MAP_FAILED)
+	{
+		_shared_close(shared);
+		return ec::mapping;
+	}
+	shared->header = (SharedHeader*)view;
+#endif
+
+	//Writer initializes header. Odd generation is left by crashed writer
+	SharedHeader sample;
+	if (mode != create_mode::read)
+	{
+		if (memcmp(shared->header->signature, sample.signature, 7) != 0 || shared->header->version != sample.version)
+		{
+			memcpy(shared->header->signature, sample.signature, 7);
+			shared->header->version = sample.version;
+			shared->header->generation = 0;
+			shared->header->filesize = 0;
+			shared->header->rebuild = 0;
+		}
+		if ((shared->header->generation & 1) != 0) shared->header->generation++;
+	}
+	shared->generation = shared->header->generation;
+	shared->rebuild = shared->header->rebuild;
+	return ec::ok;
+}
+
+void ir::Database::_shared_allow_readers(Shared *shared) noexcept
+{
+	#ifdef _WIN32
+		if (shared->file != INVALID_HANDLE_VALUE) _shared_unlock(shared, _shared_reader_lock);
+	#else
+		if (shared->file >= 0) _shared_unlock(shared, _shared_reader_lock);
+	#endif
+}
+
+void ir::Database::_shared_close(Shared *shared) noexcept
+{
+	#ifdef _WIN32
+		if (shared->header != nullptr) UnmapViewOfFile(shared->header);
+		if (shared->mapping != NULL) CloseHandle(shared->mapping);
+		if (shared->file != INVALID_HANDLE_VALUE) CloseHandle(shared->file);
+		shared->mapping = NULL;
+		shared->file = INVALID_HANDLE_VALUE;
+	#else
+		if (shared->header != nullptr) munmap(shared->header, sizeof(SharedHeader));
+		if (shared->file >= 0) close(shared->file);
+		shared->file = -1;
+	#endif
+	shared->header = nullptr;
+	shared->generation = 0;
+	shared->depth = 0;
+	shared->rebuild = 0;
+}
+
+void ir::Database::_shared_begin(Shared *shared) noexcept
+{
+	if (shared->header != nullptr && shared->depth++ == 0) shared->header->generation++;
+}
+
+void ir::Database::_shared_end(Shared *shared) noexcept
+{
+	if (shared->header != nullptr && --shared->depth == 0) shared->header->generation++;
+}
+
+ir::uint32 ir::Database::_shared_wait(const Shared *shared) noexcept
+{
+	while (true)
+	{
+		uint32 generation = shared->header->generation;
+		if ((generation & 1) == 0 || _shared_free(shared, _shared_writer_lock)) return generation;
+		#ifdef _WIN32
+			Sleep(0);
+		#else
+			sched_yield();
+		#endif
+	}
+}
+
+bool ir::Database::_shared_changed(const Shared *shared) noexcept
+{
+	return shared->header != nullptr && shared->header->generation != shared->generation;
+}
+
+template<class D> ir::Database::Modification<D>::Modification(D *database, bool publish) noexcept
+{
+	this->database = (publish && database->_shared.header != nullptr) ? database : nullptr;
+	if (this->database != nullptr) _shared_begin(&database->_shared);
+}
+
+template<class D> ir::Database::Modification<D>::~Modification() noexcept
+{
+	if (database == nullptr) return;
+	if (database->_shared.depth == 1) _publish(database);
+	_shared_end(&database->_shared);
+}
+
+//Makes files and sizes visible to readers, must be called inside modification. Files kept in RAM are published when they are written back
+//Flushing buffers that were already flushed costs nothing, so every modification is published and readers never wait for writer
+template<class D> void ir::Database::_publish(D *database) noexcept
+{
+	SharedHeader *header = database->_shared.header;
+	if (header == nullptr || database->_file.hold || database->_meta.hold) return;
+	fflush(database->_file.file);
+	fflush(database->_meta.file);
+	header->beta = database->_beta ? 1 : 0;
+	header->filesize = database->_file.size;
+	header->metasize = database->_meta.size;
+	header->count = database->_meta.count;
+	header->delcount = database->_meta.delcount;
+	header->used = database->_file.used;
+	header->rebuild = database->_shared.rebuild;
+}
+
+//Publishes state of writer as separate modification
+template<class D> void ir::Database::_publish_all(D *database) noexcept
+{
+	if (database->_shared.header == nullptr || database->_shared.depth != 0) return;
+	_shared_begin(&database->_shared);
+	_publish(database);
+	_shared_end(&database->_shared);
+}
+
+//Brings reader up to date with writer if writer published something since last time
+template<class D> ir::ec ir::Database::_refresh(D *database, bool force) noexcept
+{
+	Shared *shared = &database->_shared;
+	if (shared->header == nullptr || database->_writeaccess) return ec::ok;
+	if (!force && !_shared_changed(shared)) return ec::ok;
+	SharedHeader *header = shared->header;
+	uint32 generation, beta, filesize, metasize, count, delcount, used, rebuild;
+	do
+	{
+		generation = _shared_wait(shared);
+		beta = header->beta;
+		rebuild = header->rebuild;
+		filesize = header->filesize;
+		metasize = header->metasize;
+		count = header->count;
+		delcount = header->delcount;
+		used = header->used;
+	} while (header->generation != generation);
+	shared->generation = generation;
+	if (filesize == 0) return ec::ok;
+
+	bool holdfile = database->_file.hold;
+	bool holdmeta = database->_meta.hold;
+	ec code = database->set_ram_mode(false, false);
+	if (code != ec::ok) return code;
+	database->_mapping.close();
+	if (rebuild != shared->rebuild || (beta != 0) != database->_beta)
+	{
+		//Writer has rebuilt database into new files, old ones might be already deleted
+		fclose(database->_file.file);
+		database->_file.file = nullptr;
+		fclose(database->_meta.file);
+		database->_meta.file = nullptr;
+		database->_beta = beta != 0;
+		code = database->_check();
+		if (code != ec::ok)
+		{
+			database->finalize();
+			return code;
+		}
+		if (database->_pattern != access_pattern::normal) database->hint(database->_pattern);
+	}
+	else
+	{
+		//Seeking may reuse buffered data that writer has changed, flushing input streams discards it
+		fflush(database->_file.file);
+		fflush(database->_meta.file);
+		if (fseek(database->_file.file, 0, SEEK_SET) != 0 || fseek(database->_meta.file, database->_metaheadersize(), SEEK_SET) != 0) return ec::seek_file;
+		database->_file.pointer = 0;
+		database->_file.written = false;
+		database->_meta.pointer = 0;
+		database->_meta.written = false;
+	}
+	shared->rebuild = rebuild;
+	database->_file.size = filesize;
+	database->_file.used = used;
+	database->_meta.size = metasize;
+	database->_meta.count = count;
+	database->_meta.delcount = delcount;
+	return database->set_ram_mode(holdfile, holdmeta);
+}
@@ -85,9 +85,10 @@ void ir::File::close() noexcept
 bool ir::File::seek(uint64 position, int mode) noexcept
 {
 	assert(ok());
-	if (fseek(_header->file, (long)position, mode) == 0) return true;
-	_header->position = (uint64)-1;
-	return false;
+	//Position is known only after seeking from beginning, otherwise it is requested lazily
+	const bool success = fseek(_header->file, (long)position, mode) == 0;
+	_header->position = (success && mode == SEEK_SET) ? position : (uint64)-1;
+	return success;
 }
 
 ir::uint64 ir::File::tell() const noexcept
@@ -101,9 +102,9 @@ ir::uint64 ir::File::tell() const noexcept
 ir::uint64 ir::File::size() noexcept
 {
 	uint64 position = tell();
-	assert(seek(0, SEEK_END));
+	if (!seek(0, SEEK_END)) return 0;
 	uint64 size = tell();
-	assert(seek(position, SEEK_SET));
+	seek(position, SEEK_SET);
 	return size;
 }
 
@@ -122,7 +123,7 @@ size_t ir::File::read(void *data, size_t size) noexcept
 {
 	assert(ok());
 	size_t read = fread(data, 1, size, _header->file);
-	_header->position += read;
+	if (_header->position != (uint64)-1) _header->position += read;
 	return read;
 }
 
@@ -130,7 +131,7 @@ size_t ir::File::write(const void *data, size_t size) noexcept
 {
 	assert(ok());
 	size_t wrote = fwrite(data, 1, size, _header->file);
-	_header->position += wrote;
+	if (_header->position != (uint64)-1) _header->position += wrote;
 	return wrote;
 }
 
@@ -9,6 +9,11 @@
 */
 
 #include <assert.h>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#include <immintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+	#include <arm_neon.h>
+#endif
 
 template<class T, size_t A>
 inline void ir::Chunk<T, A>::zero() noexcept
@@ -16,6 +21,12 @@ inline void ir::Chunk<T, A>::zero() noexcept
 	for (size_t a = 0; a < A; a++) r[a] = (T)0;
 }
 
+template<class T, size_t A>
+inline void ir::Chunk<T, A>::fill(T value) noexcept
+{
+	for (size_t a = 0; a < A; a++) r[a] = value;
+}
+
 template<class T, size_t A>
 inline T ir::Chunk<T, A>::sum() const noexcept
 {
@@ -80,6 +91,628 @@ inline ir::Chunk<T, A> ir::Chunk<T, A>::operator/(const Chunk<T, A> & IR_RESTRIC
 	return b;
 }
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+//SSE2 specializations, used if compiler is allowed to generate them
+
+template<>
+inline void ir::Chunk<float, 4>::zero() noexcept
+{
+	_mm_store_ps(r, _mm_setzero_ps());
+}
+
+template<>
+inline void ir::Chunk<float, 4>::fill(float value) noexcept
+{
+	_mm_store_ps(r, _mm_set1_ps(value));
+}
+
+template<>
+inline float ir::Chunk<float, 4>::sum() const noexcept
+{
+	__m128 v = _mm_load_ps(r);
+	v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+	v = _mm_add_ss(v, _mm_shuffle_ps(v, v, 1));
+	return _mm_cvtss_f32(v);
+}
+
+template<>
+inline void ir::Chunk<float, 4>::operator+=(const Chunk<float, 4> & IR_RESTRICT another) noexcept
+{
+	_mm_store_ps(r, _mm_add_ps(_mm_load_ps(r), _mm_load_ps(another.r)));
+}
+
+template<>
+inline void ir::Chunk<float, 4>::operator-=(const Chunk<float, 4> & IR_RESTRICT another) noexcept
+{
+	_mm_store_ps(r, _mm_sub_ps(_mm_load_ps(r), _mm_load_ps(another.r)));
+}
+
+template<>
+inline void ir::Chunk<float, 4>::operator*=(const Chunk<float, 4> & IR_RESTRICT another) noexcept
+{
+	_mm_store_ps(r, _mm_mul_ps(_mm_load_ps(r), _mm_load_ps(another.r)));
+}
+
+template<>
+inline void ir::Chunk<float, 4>::operator/=(const Chunk<float, 4> & IR_RESTRICT another) noexcept
+{
+	_mm_store_ps(r, _mm_div_ps(_mm_load_ps(r), _mm_load_ps(another.r)));
+}
+
+template<>
+inline ir::Chunk<float, 4> ir::Chunk<float, 4>::operator+(const Chunk<float, 4> & IR_RESTRICT another) const noexcept
+{
+	Chunk<float, 4> b;
+	_mm_store_ps(b.r, _mm_add_ps(_mm_load_ps(r), _mm_load_ps(another.r)));
+	return b;
+}
+
+template<>
+inline ir::Chunk<float, 4> ir::Chunk<float, 4>::operator-(const Chunk<float, 4> & IR_RESTRICT another) const noexcept
+{
+	Chunk<float, 4> b;
+	_mm_store_ps(b.r, _mm_sub_ps(_mm_load_ps(r), _mm_load_ps(another.r)));
+	return b;
+}
+
+template<>
+inline ir::Chunk<float, 4> ir::Chunk<float, 4>::operator*(const Chunk<float, 4> & IR_RESTRICT another) const noexcept
+{
+	Chunk<float, 4> b;
+	_mm_store_ps(b.r, _mm_mul_ps(_mm_load_ps(r), _mm_load_ps(another.r)));
+	return b;
+}
+
+template<>
+inline ir::Chunk<float, 4> ir::Chunk<float, 4>::operator/(const Chunk<float, 4> & IR_RESTRICT another) const noexcept
+{
+	Chunk<float, 4> b;
+	_mm_store_ps(b.r, _mm_div_ps(_mm_load_ps(r), _mm_load_ps(another.r)));
+	return b;
+}
+
+template<>
+inline void ir::Chunk<double, 2>::zero() noexcept
+{
+	_mm_store_pd(r, _mm_setzero_pd());
+}
+
+template<>
+inline void ir::Chunk<double, 2>::fill(double value) noexcept
+{
+	_mm_store_pd(r, _mm_set1_pd(value));
+}
+
+template<>
+inline double ir::Chunk<double, 2>::sum() const noexcept
+{
+	const __m128d v = _mm_load_pd(r);
+	return _mm_cvtsd_f64(_mm_add_sd(v, _mm_unpackhi_pd(v, v)));
+}
+
+template<>
+inline void ir::Chunk<double, 2>::operator+=(const Chunk<double, 2> & IR_RESTRICT another) noexcept
+{
+	_mm_store_pd(r, _mm_add_pd(_mm_load_pd(r), _mm_load_pd(another.r)));
+}
+
+template<>
+inline void ir::Chunk<double, 2>::operator-=(const Chunk<double, 2> & IR_RESTRICT another) noexcept
+{
+	_mm_store_pd(r, _mm_sub_pd(_mm_load_pd(r), _mm_load_pd(another.r)));
+}
+
+template<>
+inline void ir::Chunk<double, 2>::operator*=(const Chunk<double, 2> & IR_RESTRICT another) noexcept
+{
+	_mm_store_pd(r, _mm_mul_pd(_mm_load_pd(r), _mm_load_pd(another.r)));
+}
+
+template<>
+inline void ir::Chunk<double, 2>::operator/=(const Chunk<double, 2> & IR_RESTRICT another) noexcept
+{
+	_mm_store_pd(r, _mm_div_pd(_mm_load_pd(r), _mm_load_pd(another.r)));
+}
+
+template<>
+inline ir::Chunk<double, 2> ir::Chunk<double, 2>::operator+(const Chunk<double, 2> & IR_RESTRICT another) const noexcept
+{
+	Chunk<double, 2> b;
+	_mm_store_pd(b.r, _mm_add_pd(_mm_load_pd(r), _mm_load_pd(another.r)));
+	return b;
+}
+
+template<>
+inline ir::Chunk<double, 2> ir::Chunk<double, 2>::operator-(const Chunk<double, 2> & IR_RESTRICT another) const noexcept
+{
+	Chunk<double, 2> b;
+	_mm_store_pd(b.r, _mm_sub_pd(_mm_load_pd(r), _mm_load_pd(another.r)));
+	return b;
+}
+
+template<>
+inline ir::Chunk<double, 2> ir::Chunk<double, 2>::operator*(const Chunk<double, 2> & IR_RESTRICT another) const noexcept
+{
+	Chunk<double, 2> b;
+	_mm_store_pd(b.r, _mm_mul_pd(_mm_load_pd(r), _mm_load_pd(another.r)));
+	return b;
+}
+
+template<>
+inline ir::Chunk<double, 2> ir::Chunk<double, 2>::operator/(const Chunk<double, 2> & IR_RESTRICT another) const noexcept
+{
+	Chunk<double, 2> b;
+	_mm_store_pd(b.r, _mm_div_pd(_mm_load_pd(r), _mm_load_pd(another.r)));
+	return b;
+}
+
+#endif
+
+#ifdef __AVX__
+//AVX specializations, used if compiler is allowed to generate them
+
+template<>
+inline void ir::Chunk<float, 8>::zero() noexcept
+{
+	_mm256_store_ps(r, _mm256_setzero_ps());
+}
+
+template<>
+inline void ir::Chunk<float, 8>::fill(float value) noexcept
+{
+	_mm256_store_ps(r, _mm256_set1_ps(value));
+}
+
+template<>
+inline float ir::Chunk<float, 8>::sum() const noexcept
+{
+	const __m256 v = _mm256_load_ps(r);
+	__m128 h = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+	h = _mm_add_ps(h, _mm_movehl_ps(h, h));
+	h = _mm_add_ss(h, _mm_shuffle_ps(h, h, 1));
+	return _mm_cvtss_f32(h);
+}
+
+template<>
+inline void ir::Chunk<float, 8>::operator+=(const Chunk<float, 8> & IR_RESTRICT another) noexcept
+{
+	_mm256_store_ps(r, _mm256_add_ps(_mm256_load_ps(r), _mm256_load_ps(another.r)));
+}
+
+template<>
+inline void ir::Chunk<float, 8>::operator-=(const Chunk<float, 8> & IR_RESTRICT another) noexcept
+{
+	_mm256_store_ps(r, _mm256_sub_ps(_mm256_load_ps(r), _mm256_load_ps(another.r)));
+}
+
+template<>
+inline void ir::Chunk<float, 8>::operator*=(const Chunk<float, 8> & IR_RESTRICT another) noexcept
+{
+	_mm256_store_ps(r, _mm256_mul_ps(_mm256_load_ps(r), _mm256_load_ps(another.r)));
+}
+
+template<>
+inline void ir::Chunk<float, 8>::operator/=(const Chunk<float, 8> & IR_RESTRICT another) noexcept
+{
+	_mm256_store_ps(r, _mm256_div_ps(_mm256_load_ps(r), _mm256_load_ps(another.r)));
+}
+
+template<>
+inline ir::Chunk<float, 8> ir::Chunk<float, 8>::operator+(const Chunk<float, 8> & IR_RESTRICT another) const noexcept
+{
+	Chunk<float, 8> b;
+	_mm256_store_ps(b.r, _mm256_add_ps(_mm256_load_ps(r), _mm256_load_ps(another.r)));
+	return b;
+}
+
+template<>
+inline ir::Chunk<float, 8> ir::Chunk<float, 8>::operator-(const Chunk<float, 8> & IR_RESTRICT another) const noexcept
+{
+	Chunk<float, 8> b;
+	_mm256_store_ps(b.r, _mm256_sub_ps(_mm256_load_ps(r), _mm256_load_ps(another.r)));
+	return b;
+}
+
+template<>
+inline ir::Chunk<float, 8> ir::Chunk<float, 8>::operator*(const Chunk<float, 8> & IR_RESTRICT another) const noexcept
+{
+	Chunk<float, 8> b;
+	_mm256_store_ps(b.r, _mm256_mul_ps(_mm256_load_ps(r), _mm256_load_ps(another.r)));
+	return b;
+}
+
+template<>
+inline ir::Chunk<float, 8> ir::Chunk<float, 8>::operator/(const Chunk<float, 8> & IR_RESTRICT another) const noexcept
+{
+	Chunk<float, 8> b;
+	_mm256_store_ps(b.r, _mm256_div_ps(_mm256_load_ps(r), _mm256_load_ps(another.r)));
+	return b;
+}
+
+template<>
+inline void ir::Chunk<double, 4>::zero() noexcept
+{
+	_mm256_store_pd(r, _mm256_setzero_pd());
+}
+
+template<>
+inline void ir::Chunk<double, 4>::fill(double value) noexcept
+{
+	_mm256_store_pd(r, _mm256_set1_pd(value));
+}
+
+template<>
+inline double ir::Chunk<double, 4>::sum() const noexcept
+{
+	const __m256d v = _mm256_load_pd(r);
+	const __m128d h = _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+	return _mm_cvtsd_f64(_mm_add_sd(h, _mm_unpackhi_pd(h, h)));
+}
+
+template<>
+inline void ir::Chunk<double, 4>::operator+=(const Chunk<double, 4> & IR_RESTRICT another) noexcept
+{
+	_mm256_store_pd(r, _mm256_add_pd(_mm256_load_pd(r), _mm256_load_pd(another.r)));
+}
+
+template<>
+inline void ir::Chunk<double, 4>::operator-=(const Chunk<double, 4> & IR_RESTRICT another) noexcept
+{
+	_mm256_store_pd(r, _mm256_sub_pd(_mm256_load_pd(r), _mm256_load_pd(another.r)));
+}
+
+template<>
+inline void ir::Chunk<double, 4>::operator*=(const Chunk<double, 4> & IR_RESTRICT another) noexcept
+{
+	_mm256_store_pd(r, _mm256_mul_pd(_mm256_load_pd(r), _mm256_load_pd(another.r)));
+}
+
+template<>
+inline void ir::Chunk<double, 4>::operator/=(const Chunk<double, 4> & IR_RESTRICT another) noexcept
+{
+	_mm256_store_pd(r, _mm256_div_pd(_mm256_load_pd(r), _mm256_load_pd(another.r)));
+}
+
+template<>
+inline ir::Chunk<double, 4> ir::Chunk<double, 4>::operator+(const Chunk<double, 4> & IR_RESTRICT another) const noexcept
+{
+	Chunk<double, 4> b;
+	_mm256_store_pd(b.r, _mm256_add_pd(_mm256_load_pd(r), _mm256_load_pd(another.r)));
+	return b;
+}
+
+template<>
+inline ir::Chunk<double, 4> ir::Chunk<double, 4>::operator-(const Chunk<double, 4> & IR_RESTRICT another) const noexcept
+{
+	Chunk<double, 4> b;
+	_mm256_store_pd(b.r, _mm256_sub_pd(_mm256_load_pd(r), _mm256_load_pd(another.r)));
+	return b;
+}
+
+template<>
+inline ir::Chunk<double, 4> ir::Chunk<double, 4>::operator*(const Chunk<double, 4> & IR_RESTRICT another) const noexcept
+{
+	Chunk<double, 4> b;
+	_mm256_store_pd(b.r, _mm256_mul_pd(_mm256_load_pd(r), _mm256_load_pd(another.r)));
+	return b;
+}
+
+template<>
+inline ir::Chunk<double, 4> ir::Chunk<double, 4>::operator/(const Chunk<double, 4> & IR_RESTRICT another) const noexcept
+{
+	Chunk<double, 4> b;
+	_mm256_store_pd(b.r, _mm256_div_pd(_mm256_load_pd(r), _mm256_load_pd(another.r)));
+	return b;
+}
+
+#endif
+
+#ifdef __AVX512F__
+//AVX-512 specializations, used if compiler is allowed to generate them
+
+template<>
+inline void ir::Chunk<float, 16>::zero() noexcept
+{
+	_mm512_store_ps(r, _mm512_setzero_ps());
+}
+
+template<>
+inline void ir::Chunk<float, 16>::fill(float value) noexcept
+{
+	_mm512_store_ps(r, _mm512_set1_ps(value));
+}
+
+template<>
+inline float ir::Chunk<float, 16>::sum() const noexcept
+{
+	return simd_kernels::reduce_avx512(_mm512_load_ps(r));
+}
+
+template<>
+inline void ir::Chunk<float, 16>::operator+=(const Chunk<float, 16> & IR_RESTRICT another) noexcept
+{
+	_mm512_store_ps(r, _mm512_add_ps(_mm512_load_ps(r), _mm512_load_ps(another.r)));
+}
+
+template<>
+inline void ir::Chunk<float, 16>::operator-=(const Chunk<float, 16> & IR_RESTRICT another) noexcept
+{
+	_mm512_store_ps(r, _mm512_sub_ps(_mm512_load_ps(r), _mm512_load_ps(another.r)));
+}
+
+template<>
+inline void ir::Chunk<float, 16>::operator*=(const Chunk<float, 16> & IR_RESTRICT another) noexcept
+{
+	_mm512_store_ps(r, _mm512_mul_ps(_mm512_load_ps(r), _mm512_load_ps(another.r)));
+}
+
+template<>
+inline void ir::Chunk<float, 16>::operator/=(const Chunk<float, 16> & IR_RESTRICT another) noexcept
+{
+	_mm512_store_ps(r, _mm512_div_ps(_mm512_load_ps(r), _mm512_load_ps(another.r)));
+}
+
+template<>
+inline ir::Chunk<float, 16> ir::Chunk<float, 16>::operator+(const Chunk<float, 16> & IR_RESTRICT another) const noexcept
+{
+	Chunk<float, 16> b;
+	_mm512_store_ps(b.r, _mm512_add_ps(_mm512_load_ps(r), _mm512_load_ps(another.r)));
+	return b;
+}
+
+template<>
+inline ir::Chunk<float, 16> ir::Chunk<float, 16>::operator-(const Chunk<float, 16> & IR_RESTRICT another) const noexcept
+{
+	Chunk<float, 16> b;
+	_mm512_store_ps(b.r, _mm512_sub_ps(_mm512_load_ps(r), _mm512_load_ps(another.r)));
+	return b;
+}
+
+template<>
+inline ir::Chunk<float, 16> ir::Chunk<float, 16>::operator*(const Chunk<float, 16> & IR_RESTRICT another) const noexcept
+{
+	Chunk<float, 16> b;
+	_mm512_store_ps(b.r, _mm512_mul_ps(_mm512_load_ps(r), _mm512_load_ps(another.r)));
+	return b;
+}
+
+template<>
+inline ir::Chunk<float, 16> ir::Chunk<float, 16>::operator/(const Chunk<float, 16> & IR_RESTRICT another) const noexcept
+{
+	Chunk<float, 16> b;
+	_mm512_store_ps(b.r, _mm512_div_ps(_mm512_load_ps(r), _mm512_load_ps(another.r)));
+	return b;
+}
+
+template<>
+inline void ir::Chunk<double, 8>::zero() noexcept
+{
+	_mm512_store_pd(r, _mm512_setzero_pd());
+}
+
+template<>
+inline void ir::Chunk<double, 8>::fill(double value) noexcept
+{
+	_mm512_store_pd(r, _mm512_set1_pd(value));
+}
+
+template<>
+inline double ir::Chunk<double, 8>::sum() const noexcept
+{
+	return simd_kernels::reduce_avx512(_mm512_load_pd(r));
+}
+
+template<>
+inline void ir::Chunk<double, 8>::operator+=(const Chunk<double, 8> & IR_RESTRICT another) noexcept
+{
+	_mm512_store_pd(r, _mm512_add_pd(_mm512_load_pd(r), _mm512_load_pd(another.r)));
+}
+
+template<>
+inline void ir::Chunk<double, 8>::operator-=(const Chunk<double, 8> & IR_RESTRICT another) noexcept
+{
+	_mm512_store_pd(r, _mm512_sub_pd(_mm512_load_pd(r), _mm512_load_pd(another.r)));
+}
+
+template<>
+inline void ir::Chunk<double, 8>::operator*=(const Chunk<double, 8> & IR_RESTRICT another) noexcept
+{
+	_mm512_store_pd(r, _mm512_mul_pd(_mm512_load_pd(r), _mm512_load_pd(another.r)));
+}
+
+template<>
+inline void ir::Chunk<double, 8>::operator/=(const Chunk<double, 8> & IR_RESTRICT another) noexcept
+{
+	_mm512_store_pd(r, _mm512_div_pd(_mm512_load_pd(r), _mm512_load_pd(another.r)));
+}
+
+template<>
+inline ir::Chunk<double, 8> ir::Chunk<double, 8>::operator+(const Chunk<double, 8> & IR_RESTRICT another) const noexcept
+{
+	Chunk<double, 8> b;
+	_mm512_store_pd(b.r, _mm512_add_pd(_mm512_load_pd(r), _mm512_load_pd(another.r)));
+	return b;
+}
+
+template<>
+inline ir::Chunk<double, 8> ir::Chunk<double, 8>::operator-(const Chunk<double, 8> & IR_RESTRICT another) const noexcept
+{
+	Chunk<double, 8> b;
+	_mm512_store_pd(b.r, _mm512_sub_pd(_mm512_load_pd(r), _mm512_load_pd(another.r)));
+	return b;
+}
+
+template<>
+inline ir::Chunk<double, 8> ir::Chunk<double, 8>::operator*(const Chunk<double, 8> & IR_RESTRICT another) const noexcept
+{
+	Chunk<double, 8> b;
+	_mm512_store_pd(b.r, _mm512_mul_pd(_mm512_load_pd(r), _mm512_load_pd(another.r)));
+	return b;
+}
+
+template<>
+inline ir::Chunk<double, 8> ir::Chunk<double, 8>::operator/(const Chunk<double, 8> & IR_RESTRICT another) const noexcept
+{
+	Chunk<double, 8> b;
+	_mm512_store_pd(b.r, _mm512_div_pd(_mm512_load_pd(r), _mm512_load_pd(another.r)));
+	return b;
+}
+
+#endif
+
+#if defined(__aarch64__) || defined(_M_ARM64)
+//NEON specializations, used if compiler is allowed to generate them
+
+template<>
+inline void ir::Chunk<float, 4>::zero() noexcept
+{
+	vst1q_f32(r, vdupq_n_f32(0.0f));
+}
+
+template<>
+inline void ir::Chunk<float, 4>::fill(float value) noexcept
+{
+	vst1q_f32(r, vdupq_n_f32(value));
+}
+
+template<>
+inline float ir::Chunk<float, 4>::sum() const noexcept
+{
+	return vaddvq_f32(vld1q_f32(r));
+}
+
+template<>
+inline void ir::Chunk<float, 4>::operator+=(const Chunk<float, 4> & IR_RESTRICT another) noexcept
+{
+	vst1q_f32(r, vaddq_f32(vld1q_f32(r), vld1q_f32(another.r)));
+}
+
+template<>
+inline void ir::Chunk<float, 4>::operator-=(const Chunk<float, 4> & IR_RESTRICT another) noexcept
+{
+	vst1q_f32(r, vsubq_f32(vld1q_f32(r), vld1q_f32(another.r)));
+}
+
+template<>
+inline void ir::Chunk<float, 4>::operator*=(const Chunk<float, 4> & IR_RESTRICT another) noexcept
+{
+	vst1q_f32(r, vmulq_f32(vld1q_f32(r), vld1q_f32(another.r)));
+}
+
+template<>
+inline void ir::Chunk<float, 4>::operator/=(const Chunk<float, 4> & IR_RESTRICT another) noexcept
+{
+	vst1q_f32(r, vdivq_f32(vld1q_f32(r), vld1q_f32(another.r)));
+}
+
+template<>
+inline ir::Chunk<float, 4> ir::Chunk<float, 4>::operator+(const Chunk<float, 4> & IR_RESTRICT another) const noexcept
+{
+	Chunk<float, 4> b;
+	vst1q_f32(b.r, vaddq_f32(vld1q_f32(r), vld1q_f32(another.r)));
+	return b;
+}
+
+template<>
+inline ir::Chunk<float, 4> ir::Chunk<float, 4>::operator-(const Chunk<float, 4> & IR_RESTRICT another) const noexcept
+{
+	Chunk<float, 4> b;
+	vst1q_f32(b.r, vsubq_f32(vld1q_f32(r), vld1q_f32(another.r)));
+	return b;
+}
+
+template<>
+inline ir::Chunk<float, 4> ir::Chunk<float, 4>::operator*(const Chunk<float, 4> & IR_RESTRICT another) const noexcept
+{
+	Chunk<float, 4> b;
+	vst1q_f32(b.r, vmulq_f32(vld1q_f32(r), vld1q_f32(another.r)));
+	return b;
+}
+
+template<>
+inline ir::Chunk<float, 4> ir::Chunk<float, 4>::operator/(const Chunk<float, 4> & IR_RESTRICT another) const noexcept
+{
+	Chunk<float, 4> b;
+	vst1q_f32(b.r, vdivq_f32(vld1q_f32(r), vld1q_f32(another.r)));
+	return b;
+}
+
+template<>
+inline void ir::Chunk<double, 2>::zero() noexcept
+{
+	vst1q_f64(r, vdupq_n_f64(0.0));
+}
+
+template<>
+inline void ir::Chunk<double, 2>::fill(double value) noexcept
+{
+	vst1q_f64(r, vdupq_n_f64(value));
+}
+
+template<>
+inline double ir::Chunk<double, 2>::sum() const noexcept
+{
+	return vaddvq_f64(vld1q_f64(r));
+}
+
+template<>
+inline void ir::Chunk<double, 2>::operator+=(const Chunk<double, 2> & IR_RESTRICT another) noexcept
+{
+	vst1q_f64(r, vaddq_f64(vld1q_f64(r), vld1q_f64(another.r)));
+}
+
+template<>
+inline void ir::Chunk<double, 2>::operator-=(const Chunk<double, 2> & IR_RESTRICT another) noexcept
+{
+	vst1q_f64(r, vsubq_f64(vld1q_f64(r), vld1q_f64(another.r)));
+}
+
+template<>
+inline void ir::Chunk<double, 2>::operator*=(const Chunk<double, 2> & IR_RESTRICT another) noexcept
+{
+	vst1q_f64(r, vmulq_f64(vld1q_f64(r), vld1q_f64(another.r)));
+}
+
+template<>
+inline void ir::Chunk<double, 2>::operator/=(const Chunk<double, 2> & IR_RESTRICT another) noexcept
+{
+	vst1q_f64(r, vdivq_f64(vld1q_f64(r), vld1q_f64(another.r)));
+}
+
+template<>
+inline ir::Chunk<double, 2> ir::Chunk<double, 2>::operator+(const Chunk<double, 2> & IR_RESTRICT another) const noexcept
+{
+	Chunk<double, 2> b;
+	vst1q_f64(b.r, vaddq_f64(vld1q_f64(r), vld1q_f64(another.r)));
+	return b;
+}
+
+template<>
+inline ir::Chunk<double, 2> ir::Chunk<double, 2>::operator-(const Chunk<double, 2> & IR_RESTRICT another) const noexcept
+{
+	Chunk<double, 2> b;
+	vst1q_f64(b.r, vsubq_f64(vld1q_f64(r), vld1q_f64(another.r)));
+	return b;
+}
+
+template<>
+inline ir::Chunk<double, 2> ir::Chunk<double, 2>::operator*(const Chunk<double, 2> & IR_RESTRICT another) const noexcept
+{
+	Chunk<double, 2> b;
+	vst1q_f64(b.r, vmulq_f64(vld1q_f64(r), vld1q_f64(another.r)));
+	return b;
+}
+
+template<>
+inline ir::Chunk<double, 2> ir::Chunk<double, 2>::operator/(const Chunk<double, 2> & IR_RESTRICT another) const noexcept
+{
+	Chunk<double, 2> b;
+	vst1q_f64(b.r, vdivq_f64(vld1q_f64(r), vld1q_f64(another.r)));
+	return b;
+}
+
+#endif
+
 template <class T, size_t A>
 inline size_t ir::Matrix<T, A>::width() const noexcept
 {
@@ -87,6 +720,12 @@ inline size_t ir::Matrix<T, A>::width() const noexcept
 	return _width;
 }
 
+template <class T, size_t A>
+inline size_t ir::Matrix<T, A>::alignment() noexcept
+{
+	return _alignment;
+}
+
 template <class T, size_t A>
 inline size_t ir::Matrix<T, A>::height() const noexcept
 {
@@ -99,7 +738,7 @@ inline T * IR_RESTRICT ir::Matrix<T, A>::data(size_t row) noexcept
 {
 	assert(_data != nullptr);
 	assert(row < _height);
-	T *aligned_data = (T*)(((size_t)_data + A * sizeof(T) - 1) / (A * sizeof(T)) * (A * sizeof(T)));
+	T *aligned_data = (T*)(((size_t)_data + _alignment - 1) / _alignment * _alignment);
 	size_t aligned_width = (_width + A - 1) / A * A;
 	return aligned_data + row * aligned_width;
 }
@@ -109,7 +748,7 @@ inline const T * IR_RESTRICT ir::Matrix<T, A>::data(size_t row) const noexcept
 {
 	assert(_data != nullptr);
 	assert(row < _height);
-	const T *aligned_data = (const T*)(((size_t)_data + A * sizeof(T) - 1) / (A * sizeof(T)) * (A * sizeof(T)));
+	const T *aligned_data = (const T*)(((size_t)_data + _alignment - 1) / _alignment * _alignment);
 	size_t aligned_width = (_width + A - 1) / A * A;
 	return aligned_data + row * aligned_width;
 }
@@ -193,4 +832,12 @@ inline ir::Chunk<T, A> ir::Matrix<T, A>::vertical_chunk_at_edge(size_t row, size
 		for (size_t a = 0; a < _height - row; a++) b.r[a] = at(row + a, column);
 		return b;
 	}
+}
+
+template <class T, size_t A>
+inline ir::Chunk<float, A> ir::Matrix<T, A>::float_chunk_at(size_t row, size_t column) const noexcept
+{
+	Chunk<float, A> b;
+	simd_kernels::convert(A, chunk_at(row, column).r, b.r);
+	return b;
 }
\ No newline at end of file
@@ -0,0 +1,1211 @@
+/*
+	Part of the Ironic Project. Distributed under MIT License, which means:
+		- Do whatever you want
+		- Keep this notice and include the license file to your project
+		- I provide no warranty
+	To get help with installation, visit README
+	Created by Kyrylo Sovailo, github.com/Meta-chan, k.sovailo@gmail.com
+	Reinventing bicycles since 2020
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+	#define IR_SIMD_X86
+	#ifdef _MSC_VER
+		#include <intrin.h>
+	#else
+		#include <cpuid.h>
+	#endif
+	#include <immintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+	#define IR_SIMD_NEON
+	#include <arm_neon.h>
+#endif
+
+//Kernels are compiled for their instruction set regardless of compiler options and are called only if processor supports it
+#if defined(__GNUC__) || defined(__clang__)
+	#define IR_SIMD_TARGET(TARGET) __attribute__((target(TARGET)))
+#else
+	#define IR_SIMD_TARGET(TARGET)
+#endif
+
+namespace ir
+{
+	namespace simd_kernels
+	{
+		//Portable kernels
+		template<class T> T dot(size_t n, const T *IR_RESTRICT a, const T *IR_RESTRICT b) noexcept
+		{
+			T sum = (T)0;
+			for (size_t i = 0; i < n; i++) sum += a[i] * b[i];
+			return sum;
+		}
+
+		template<class T> void axpy(size_t n, T alpha, const T *IR_RESTRICT x, T *IR_RESTRICT y) noexcept
+		{
+			for (size_t i = 0; i < n; i++) y[i] += alpha * x[i];
+		}
+
+		template<class T> void block(size_t depth, const T *IR_RESTRICT a, const T *IR_RESTRICT b, size_t nr, T *IR_RESTRICT c) noexcept
+		{
+			for (size_t i = 0; i < 4 * nr; i++) c[i] = (T)0;
+			for (size_t p = 0; p < depth; p++)
+			{
+				for (size_t r = 0; r < 4; r++)
+				{
+					for (size_t j = 0; j < nr; j++) c[r * nr + j] += a[r] * b[j];
+				}
+				a += 4;
+				b += nr;
+			}
+		}
+
+		inline int32 dot_int8(size_t n, const int8 *IR_RESTRICT a, const int8 *IR_RESTRICT b) noexcept
+		{
+			int32 sum = 0;
+			for (size_t i = 0; i < n; i++) sum += (int32)a[i] * (int32)b[i];
+			return sum;
+		}
+
+		//16-bit floating point kernels, portable versions
+		inline void load_half(size_t n, const half *IR_RESTRICT source, float *IR_RESTRICT destination) noexcept
+		{
+			for (size_t i = 0; i < n; i++) destination[i] = to_float(source[i]);
+		}
+
+		inline void store_half(size_t n, const float *IR_RESTRICT source, half *IR_RESTRICT destination) noexcept
+		{
+			for (size_t i = 0; i < n; i++) destination[i] = to_half(source[i]);
+		}
+
+		inline float dot_half(size_t n, const half *IR_RESTRICT a, const float *IR_RESTRICT b) noexcept
+		{
+			float sum = 0.0f;
+			for (size_t i = 0; i < n; i++) sum += to_float(a[i]) * b[i];
+			return sum;
+		}
+
+		inline void load_bfloat16(size_t n, const bfloat16 *IR_RESTRICT source, float *IR_RESTRICT destination) noexcept
+		{
+			for (size_t i = 0; i < n; i++) destination[i] = to_float(source[i]);
+		}
+
+		inline void store_bfloat16(size_t n, const float *IR_RESTRICT source, bfloat16 *IR_RESTRICT destination) noexcept
+		{
+			for (size_t i = 0; i < n; i++) destination[i] = to_bfloat16(source[i]);
+		}
+
+		inline float dot_bfloat16(size_t n, const bfloat16 *IR_RESTRICT a, const float *IR_RESTRICT b) noexcept
+		{
+			float sum = 0.0f;
+			for (size_t i = 0; i < n; i++) sum += to_float(a[i]) * b[i];
+			return sum;
+		}
+
+		//Conversion between storage types, used by ir::Matrix
+		template<class S, class T> void convert(size_t n, const S *IR_RESTRICT source, T *IR_RESTRICT destination) noexcept
+		{
+			for (size_t i = 0; i < n; i++) destination[i] = (T)source[i];
+		}
+
+		inline void convert(size_t n, const half *IR_RESTRICT source, float *IR_RESTRICT destination) noexcept
+		{
+			HalfKernels<half>::get()->load(n, source, destination);
+		}
+
+		inline void convert(size_t n, const float *IR_RESTRICT source, half *IR_RESTRICT destination) noexcept
+		{
+			HalfKernels<half>::get()->store(n, source, destination);
+		}
+
+		inline void convert(size_t n, const bfloat16 *IR_RESTRICT source, float *IR_RESTRICT destination) noexcept
+		{
+			HalfKernels<bfloat16>::get()->load(n, source, destination);
+		}
+
+		inline void convert(size_t n, const float *IR_RESTRICT source, bfloat16 *IR_RESTRICT destination) noexcept
+		{
+			HalfKernels<bfloat16>::get()->store(n, source, destination);
+		}
+
+		#ifdef IR_SIMD_X86
+			inline void cpuid(unsigned int leaf, unsigned int subleaf, unsigned int registers[4]) noexcept
+			{
+				#ifdef _MSC_VER
+					__cpuidex((int*)registers, (int)leaf, (int)subleaf);
+				#else
+					__cpuid_count(leaf, subleaf, registers[0], registers[1], registers[2], registers[3]);
+				#endif
+			}
+
+			//Returns register XCR0, which shows what registers operating system saves on context switch
+			inline unsigned long long xgetbv() noexcept
+			{
+				#ifdef _MSC_VER
+					return _xgetbv(0);
+				#else
+					unsigned int eax, edx;
+					__asm__ __volatile__(".byte 0x0f, 0x01, 0xd0" : "=a"(eax), "=d"(edx) : "c"(0));
+					return ((unsigned long long)edx << 32) | eax;
+				#endif
+			}
+
+			//SSE2 kernels
+			IR_SIMD_TARGET("sse2") inline float dot_sse2(size_t n, const float *IR_RESTRICT a, const float *IR_RESTRICT b) noexcept
+			{
+				__m128 sum0 = _mm_setzero_ps(), sum1 = _mm_setzero_ps();
+				size_t i = 0;
+				for (; i + 8 <= n; i += 8)
+				{
+					sum0 = _mm_add_ps(sum0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+					sum1 = _mm_add_ps(sum1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+				}
+				sum0 = _mm_add_ps(sum0, sum1);
+				sum0 = _mm_add_ps(sum0, _mm_movehl_ps(sum0, sum0));
+				sum0 = _mm_add_ss(sum0, _mm_shuffle_ps(sum0, sum0, 1));
+				float sum = _mm_cvtss_f32(sum0);
+				for (; i < n; i++) sum += a[i] * b[i];
+				return sum;
+			}
+
+			IR_SIMD_TARGET("sse2") inline double dot_sse2(size_t n, const double *IR_RESTRICT a, const double *IR_RESTRICT b) noexcept
+			{
+				__m128d sum0 = _mm_setzero_pd(), sum1 = _mm_setzero_pd();
+				size_t i = 0;
+				for (; i + 4 <= n; i += 4)
+				{
+					sum0 = _mm_add_pd(sum0, _mm_mul_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+					sum1 = _mm_add_pd(sum1, _mm_mul_pd(_mm_loadu_pd(a + i + 2), _mm_loadu_pd(b + i + 2)));
+				}
+				sum0 = _mm_add_pd(sum0, sum1);
+				sum0 = _mm_add_sd(sum0, _mm_unpackhi_pd(sum0, sum0));
+				double sum = _mm_cvtsd_f64(sum0);
+				for (; i < n; i++) sum += a[i] * b[i];
+				return sum;
+			}
+
+			IR_SIMD_TARGET("sse2") inline void axpy_sse2(size_t n, float alpha, const float *IR_RESTRICT x, float *IR_RESTRICT y) noexcept
+			{
+				const __m128 factor = _mm_set1_ps(alpha);
+				size_t i = 0;
+				for (; i + 4 <= n; i += 4) _mm_storeu_ps(y + i, _mm_add_ps(_mm_loadu_ps(y + i), _mm_mul_ps(factor, _mm_loadu_ps(x + i))));
+				for (; i < n; i++) y[i] += alpha * x[i];
+			}
+
+			IR_SIMD_TARGET("sse2") inline void axpy_sse2(size_t n, double alpha, const double *IR_RESTRICT x, double *IR_RESTRICT y) noexcept
+			{
+				const __m128d factor = _mm_set1_pd(alpha);
+				size_t i = 0;
+				for (; i + 2 <= n; i += 2) _mm_storeu_pd(y + i, _mm_add_pd(_mm_loadu_pd(y + i), _mm_mul_pd(factor, _mm_loadu_pd(x + i))));
+				for (; i < n; i++) y[i] += alpha * x[i];
+			}
+
+			//Processes 8 columns at once: 8 accumulators out of 16 registers
+			IR_SIMD_TARGET("sse2") inline void block_sse2(size_t depth, const float *IR_RESTRICT a, const float *IR_RESTRICT b, size_t nr, float *IR_RESTRICT c) noexcept
+			{
+				for (size_t j = 0; j < nr; j += 8)
+				{
+					__m128 c00 = _mm_setzero_ps(), c01 = _mm_setzero_ps(), c10 = _mm_setzero_ps(), c11 = _mm_setzero_ps();
+					__m128 c20 = _mm_setzero_ps(), c21 = _mm_setzero_ps(), c30 = _mm_setzero_ps(), c31 = _mm_setzero_ps();
+					const float *pa = a, *pb = b + j;
+					for (size_t p = 0; p < depth; p++, pa += 4, pb += nr)
+					{
+						const __m128 b0 = _mm_load_ps(pb), b1 = _mm_load_ps(pb + 4);
+						__m128 ar = _mm_set1_ps(pa[0]);
+						c00 = _mm_add_ps(c00, _mm_mul_ps(ar, b0)); c01 = _mm_add_ps(c01, _mm_mul_ps(ar, b1));
+						ar = _mm_set1_ps(pa[1]);
+						c10 = _mm_add_ps(c10, _mm_mul_ps(ar, b0)); c11 = _mm_add_ps(c11, _mm_mul_ps(ar, b1));
+						ar = _mm_set1_ps(pa[2]);
+						c20 = _mm_add_ps(c20, _mm_mul_ps(ar, b0)); c21 = _mm_add_ps(c21, _mm_mul_ps(ar, b1));
+						ar = _mm_set1_ps(pa[3]);
+						c30 = _mm_add_ps(c30, _mm_mul_ps(ar, b0)); c31 = _mm_add_ps(c31, _mm_mul_ps(ar, b1));
+					}
+					_mm_store_ps(c + j, c00); _mm_store_ps(c + j + 4, c01);
+					_mm_store_ps(c + nr + j, c10); _mm_store_ps(c + nr + j + 4, c11);
+					_mm_store_ps(c + 2 * nr + j, c20); _mm_store_ps(c + 2 * nr + j + 4, c21);
+					_mm_store_ps(c + 3 * nr + j, c30); _mm_store_ps(c + 3 * nr + j + 4, c31);
+				}
+			}
+
+			IR_SIMD_TARGET("sse2") inline void block_sse2(size_t depth, const double *IR_RESTRICT a, const double *IR_RESTRICT b, size_t nr, double *IR_RESTRICT c) noexcept
+			{
+				for (size_t j = 0; j < nr; j += 4)
+				{
+					__m128d c00 = _mm_setzero_pd(), c01 = _mm_setzero_pd(), c10 = _mm_setzero_pd(), c11 = _mm_setzero_pd();
+					__m128d c20 = _mm_setzero_pd(), c21 = _mm_setzero_pd(), c30 = _mm_setzero_pd(), c31 = _mm_setzero_pd();
+					const double *pa = a, *pb = b + j;
+					for (size_t p = 0; p < depth; p++, pa += 4, pb += nr)
+					{
+						const __m128d b0 = _mm_load_pd(pb), b1 = _mm_load_pd(pb + 2);
+						__m128d ar = _mm_set1_pd(pa[0]);
+						c00 = _mm_add_pd(c00, _mm_mul_pd(ar, b0)); c01 = _mm_add_pd(c01, _mm_mul_pd(ar, b1));
+						ar = _mm_set1_pd(pa[1]);
+						c10 = _mm_add_pd(c10, _mm_mul_pd(ar, b0)); c11 = _mm_add_pd(c11, _mm_mul_pd(ar, b1));
+						ar = _mm_set1_pd(pa[2]);
+						c20 = _mm_add_pd(c20, _mm_mul_pd(ar, b0)); c21 = _mm_add_pd(c21, _mm_mul_pd(ar, b1));
+						ar = _mm_set1_pd(pa[3]);
+						c30 = _mm_add_pd(c30, _mm_mul_pd(ar, b0)); c31 = _mm_add_pd(c31, _mm_mul_pd(ar, b1));
+					}
+					_mm_store_pd(c + j, c00); _mm_store_pd(c + j + 2, c01);
+					_mm_store_pd(c + nr + j, c10); _mm_store_pd(c + nr + j + 2, c11);
+					_mm_store_pd(c + 2 * nr + j, c20); _mm_store_pd(c + 2 * nr + j + 2, c21);
+					_mm_store_pd(c + 3 * nr + j, c30); _mm_store_pd(c + 3 * nr + j + 2, c31);
+				}
+			}
+
+			//AVX2 kernels
+			IR_SIMD_TARGET("avx2,fma") inline float dot_avx2(size_t n, const float *IR_RESTRICT a, const float *IR_RESTRICT b) noexcept
+			{
+				__m256 sum0 = _mm256_setzero_ps(), sum1 = _mm256_setzero_ps();
+				size_t i = 0;
+				for (; i + 16 <= n; i += 16)
+				{
+					sum0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), sum0);
+					sum1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), sum1);
+				}
+				sum0 = _mm256_add_ps(sum0, sum1);
+				__m128 half = _mm_add_ps(_mm256_castps256_ps128(sum0), _mm256_extractf128_ps(sum0, 1));
+				half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+				half = _mm_add_ss(half, _mm_shuffle_ps(half, half, 1));
+				float sum = _mm_cvtss_f32(half);
+				for (; i < n; i++) sum += a[i] * b[i];
+				return sum;
+			}
+
+			IR_SIMD_TARGET("avx2,fma") inline double dot_avx2(size_t n, const double *IR_RESTRICT a, const double *IR_RESTRICT b) noexcept
+			{
+				__m256d sum0 = _mm256_setzero_pd(), sum1 = _mm256_setzero_pd();
+				size_t i = 0;
+				for (; i + 8 <= n; i += 8)
+				{
+					sum0 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i), sum0);
+					sum1 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i + 4), _mm256_loadu_pd(b + i + 4), sum1);
+				}
+				sum0 = _mm256_add_pd(sum0, sum1);
+				__m128d half = _mm_add_pd(_mm256_castpd256_pd128(sum0), _mm256_extractf128_pd(sum0, 1));
+				half = _mm_add_sd(half, _mm_unpackhi_pd(half, half));
+				double sum = _mm_cvtsd_f64(half);
+				for (; i < n; i++) sum += a[i] * b[i];
+				return sum;
+			}
+
+			IR_SIMD_TARGET("avx2,fma") inline void axpy_avx2(size_t n, float alpha, const float *IR_RESTRICT x, float *IR_RESTRICT y) noexcept
+			{
+				const __m256 factor = _mm256_set1_ps(alpha);
+				size_t i = 0;
+				for (; i + 8 <= n; i += 8) _mm256_storeu_ps(y + i, _mm256_fmadd_ps(factor, _mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i)));
+				for (; i < n; i++) y[i] += alpha * x[i];
+			}
+
+			IR_SIMD_TARGET("avx2,fma") inline void axpy_avx2(size_t n, double alpha, const double *IR_RESTRICT x, double *IR_RESTRICT y) noexcept
+			{
+				const __m256d factor = _mm256_set1_pd(alpha);
+				size_t i = 0;
+				for (; i + 4 <= n; i += 4) _mm256_storeu_pd(y + i, _mm256_fmadd_pd(factor, _mm256_loadu_pd(x + i), _mm256_loadu_pd(y + i)));
+				for (; i < n; i++) y[i] += alpha * x[i];
+			}
+
+			//Processes 16 columns at once: 8 accumulators out of 16 registers
+			IR_SIMD_TARGET("avx2,fma") inline void block_avx2(size_t depth, const float *IR_RESTRICT a, const float *IR_RESTRICT b, size_t nr, float *IR_RESTRICT c) noexcept
+			{
+				for (size_t j = 0; j < nr; j += 16)
+				{
+					__m256 c00 = _mm256_setzero_ps(), c01 = _mm256_setzero_ps(), c10 = _mm256_setzero_ps(), c11 = _mm256_setzero_ps();
+					__m256 c20 = _mm256_setzero_ps(), c21 = _mm256_setzero_ps(), c30 = _mm256_setzero_ps(), c31 = _mm256_setzero_ps();
+					const float *pa = a, *pb = b + j;
+					for (size_t p = 0; p < depth; p++, pa += 4, pb += nr)
+					{
+						const __m256 b0 = _mm256_load_ps(pb), b1 = _mm256_load_ps(pb + 8);
+						__m256 ar = _mm256_broadcast_ss(pa);
+						c00 = _mm256_fmadd_ps(ar, b0, c00); c01 = _mm256_fmadd_ps(ar, b1, c01);
+						ar = _mm256_broadcast_ss(pa + 1);
+						c10 = _mm256_fmadd_ps(ar, b0, c10); c11 = _mm256_fmadd_ps(ar, b1, c11);
+						ar = _mm256_broadcast_ss(pa + 2);
+						c20 = _mm256_fmadd_ps(ar, b0, c20); c21 = _mm256_fmadd_ps(ar, b1, c21);
+						ar = _mm256_broadcast_ss(pa + 3);
+						c30 = _mm256_fmadd_ps(ar, b0, c30); c31 = _mm256_fmadd_ps(ar, b1, c31);
+					}
+					_mm256_store_ps(c + j, c00); _mm256_store_ps(c + j + 8, c01);
+					_mm256_store_ps(c + nr + j, c10); _mm256_store_ps(c + nr + j + 8, c11);
+					_mm256_store_ps(c + 2 * nr + j, c20); _mm256_store_ps(c + 2 * nr + j + 8, c21);
+					_mm256_store_ps(c + 3 * nr + j, c30); _mm256_store_ps(c + 3 * nr + j + 8, c31);
+				}
+			}
+
+			IR_SIMD_TARGET("avx2,fma") inline void block_avx2(size_t depth, const double *IR_RESTRICT a, const double *IR_RESTRICT b, size_t nr, double *IR_RESTRICT c) noexcept
+			{
+				for (size_t j = 0; j < nr; j += 8)
+				{
+					__m256d c00 = _mm256_setzero_pd(), c01 = _mm256_setzero_pd(), c10 = _mm256_setzero_pd(), c11 = _mm256_setzero_pd();
+					__m256d c20 = _mm256_setzero_pd(), c21 = _mm256_setzero_pd(), c30 = _mm256_setzero_pd(), c31 = _mm256_setzero_pd();
+					const double *pa = a, *pb = b + j;
+					for (size_t p = 0; p < depth; p++, pa += 4, pb += nr)
+					{
+						const __m256d b0 = _mm256_load_pd(pb), b1 = _mm256_load_pd(pb + 4);
+						__m256d ar = _mm256_broadcast_sd(pa);
+						c00 = _mm256_fmadd_pd(ar, b0, c00); c01 = _mm256_fmadd_pd(ar, b1, c01);
+						ar = _mm256_broadcast_sd(pa + 1);
+						c10 = _mm256_fmadd_pd(ar, b0, c10); c11 = _mm256_fmadd_pd(ar, b1, c11);
+						ar = _mm256_broadcast_sd(pa + 2);
+						c20 = _mm256_fmadd_pd(ar, b0, c20); c21 = _mm256_fmadd_pd(ar, b1, c21);
+						ar = _mm256_broadcast_sd(pa + 3);
+						c30 = _mm256_fmadd_pd(ar, b0, c30); c31 = _mm256_fmadd_pd(ar, b1, c31);
+					}
+					_mm256_store_pd(c + j, c00); _mm256_store_pd(c + j + 4, c01);
+					_mm256_store_pd(c + nr + j, c10); _mm256_store_pd(c + nr + j + 4, c11);
+					_mm256_store_pd(c + 2 * nr + j, c20); _mm256_store_pd(c + 2 * nr + j + 4, c21);
+					_mm256_store_pd(c + 3 * nr + j, c30); _mm256_store_pd(c + 3 * nr + j + 4, c31);
+				}
+			}
+
+			//AVX-512 kernels, tails are processed with masks
+			//Cross-lane intrinsics like _mm512_reduce_add_ps produce false warnings in some versions of GCC, so reduction is done through memory
+			IR_SIMD_TARGET("avx512f") inline float reduce_avx512(__m512 v) noexcept
+			{
+				alignas(64) float t[16];
+				_mm512_store_ps(t, v);
+				__m128 h = _mm_add_ps(_mm_add_ps(_mm_load_ps(t), _mm_load_ps(t + 4)), _mm_add_ps(_mm_load_ps(t + 8), _mm_load_ps(t + 12)));
+				h = _mm_add_ps(h, _mm_movehl_ps(h, h));
+				h = _mm_add_ss(h, _mm_shuffle_ps(h, h, 1));
+				return _mm_cvtss_f32(h);
+			}
+
+			IR_SIMD_TARGET("avx512f") inline double reduce_avx512(__m512d v) noexcept
+			{
+				alignas(64) double t[8];
+				_mm512_store_pd(t, v);
+				const __m128d h = _mm_add_pd(_mm_add_pd(_mm_load_pd(t), _mm_load_pd(t + 2)), _mm_add_pd(_mm_load_pd(t + 4), _mm_load_pd(t + 6)));
+				return _mm_cvtsd_f64(_mm_add_sd(h, _mm_unpackhi_pd(h, h)));
+			}
+
+			IR_SIMD_TARGET("avx512f") inline float dot_avx512(size_t n, const float *IR_RESTRICT a, const float *IR_RESTRICT b) noexcept
+			{
+				__m512 sum0 = _mm512_setzero_ps(), sum1 = _mm512_setzero_ps();
+				size_t i = 0;
+				for (; i + 32 <= n; i += 32)
+				{
+					sum0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i), sum0);
+					sum1 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i + 16), _mm512_loadu_ps(b + i + 16), sum1);
+				}
+				for (; i < n; i += 16)
+				{
+					const __mmask16 mask = (n - i >= 16) ? (__mmask16)0xFFFF : (__mmask16)((1U << (n - i)) - 1);
+					sum0 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, a + i), _mm512_maskz_loadu_ps(mask, b + i), sum0);
+				}
+				return reduce_avx512(_mm512_add_ps(sum0, sum1));
+			}
+
+			IR_SIMD_TARGET("avx512f") inline double dot_avx512(size_t n, const double *IR_RESTRICT a, const double *IR_RESTRICT b) noexcept
+			{
+				__m512d sum0 = _mm512_setzero_pd(), sum1 = _mm512_setzero_pd();
+				size_t i = 0;
+				for (; i + 16 <= n; i += 16)
+				{
+					sum0 = _mm512_fmadd_pd(_mm512_loadu_pd(a + i), _mm512_loadu_pd(b + i), sum0);
+					sum1 = _mm512_fmadd_pd(_mm512_loadu_pd(a + i + 8), _mm512_loadu_pd(b + i + 8), sum1);
+				}
+				for (; i < n; i += 8)
+				{
+					const __mmask8 mask = (n - i >= 8) ? (__mmask8)0xFF : (__mmask8)((1U << (n - i)) - 1);
+					sum0 = _mm512_fmadd_pd(_mm512_maskz_loadu_pd(mask, a + i), _mm512_maskz_loadu_pd(mask, b + i), sum0);
+				}
+				return reduce_avx512(_mm512_add_pd(sum0, sum1));
+			}
+
+			IR_SIMD_TARGET("avx512f") inline void axpy_avx512(size_t n, float alpha, const float *IR_RESTRICT x, float *IR_RESTRICT y) noexcept
+			{
+				const __m512 factor = _mm512_set1_ps(alpha);
+				for (size_t i = 0; i < n; i += 16)
+				{
+					const __mmask16 mask = (n - i >= 16) ? (__mmask16)0xFFFF : (__mmask16)((1U << (n - i)) - 1);
+					_mm512_mask_storeu_ps(y + i, mask, _mm512_fmadd_ps(factor, _mm512_maskz_loadu_ps(mask, x + i), _mm512_maskz_loadu_ps(mask, y + i)));
+				}
+			}
+
+			IR_SIMD_TARGET("avx512f") inline void axpy_avx512(size_t n, double alpha, const double *IR_RESTRICT x, double *IR_RESTRICT y) noexcept
+			{
+				const __m512d factor = _mm512_set1_pd(alpha);
+				for (size_t i = 0; i < n; i += 8)
+				{
+					const __mmask8 mask = (n - i >= 8) ? (__mmask8)0xFF : (__mmask8)((1U << (n - i)) - 1);
+					_mm512_mask_storeu_pd(y + i, mask, _mm512_fmadd_pd(factor, _mm512_maskz_loadu_pd(mask, x + i), _mm512_maskz_loadu_pd(mask, y + i)));
+				}
+			}
+
+			//Processes 16 columns at once: 4 accumulators, and 32 columns with 8 accumulators when possible
+			IR_SIMD_TARGET("avx512f") inline void block_avx512(size_t depth, const float *IR_RESTRICT a, const float *IR_RESTRICT b, size_t nr, float *IR_RESTRICT c) noexcept
+			{
+				size_t j = 0;
+				for (; j + 32 <= nr; j += 32)
+				{
+					__m512 c00 = _mm512_setzero_ps(), c01 = _mm512_setzero_ps(), c10 = _mm512_setzero_ps(), c11 = _mm512_setzero_ps();
+					__m512 c20 = _mm512_setzero_ps(), c21 = _mm512_setzero_ps(), c30 = _mm512_setzero_ps(), c31 = _mm512_setzero_ps();
+					const float *pa = a, *pb = b + j;
+					for (size_t p = 0; p < depth; p++, pa += 4, pb += nr)
+					{
+						const __m512 b0 = _mm512_load_ps(pb), b1 = _mm512_load_ps(pb + 16);
+						__m512 ar = _mm512_set1_ps(pa[0]);
+						c00 = _mm512_fmadd_ps(ar, b0, c00); c01 = _mm512_fmadd_ps(ar, b1, c01);
+						ar = _mm512_set1_ps(pa[1]);
+						c10 = _mm512_fmadd_ps(ar, b0, c10); c11 = _mm512_fmadd_ps(ar, b1, c11);
+						ar = _mm512_set1_ps(pa[2]);
+						c20 = _mm512_fmadd_ps(ar, b0, c20); c21 = _mm512_fmadd_ps(ar, b1, c21);
+						ar = _mm512_set1_ps(pa[3]);
+						c30 = _mm512_fmadd_ps(ar, b0, c30); c31 = _mm512_fmadd_ps(ar, b1, c31);
+					}
+					_mm512_store_ps(c + j, c00); _mm512_store_ps(c + j + 16, c01);
+					_mm512_store_ps(c + nr + j, c10); _mm512_store_ps(c + nr + j + 16, c11);
+					_mm512_store_ps(c + 2 * nr + j, c20); _mm512_store_ps(c + 2 * nr + j + 16, c21);
+					_mm512_store_ps(c + 3 * nr + j, c30); _mm512_store_ps(c + 3 * nr + j + 16, c31);
+				}
+				for (; j < nr; j += 16)
+				{
+					__m512 c0 = _mm512_setzero_ps(), c1 = _mm512_setzero_ps(), c2 = _mm512_setzero_ps(), c3 = _mm512_setzero_ps();
+					const float *pa = a, *pb = b + j;
+					for (size_t p = 0; p < depth; p++, pa += 4, pb += nr)
+					{
+						const __m512 b0 = _mm512_load_ps(pb);
+						c0 = _mm512_fmadd_ps(_mm512_set1_ps(pa[0]), b0, c0);
+						c1 = _mm512_fmadd_ps(_mm512_set1_ps(pa[1]), b0, c1);
+						c2 = _mm512_fmadd_ps(_mm512_set1_ps(pa[2]), b0, c2);
+						c3 = _mm512_fmadd_ps(_mm512_set1_ps(pa[3]), b0, c3);
+					}
+					_mm512_store_ps(c + j, c0);
+					_mm512_store_ps(c + nr + j, c1);
+					_mm512_store_ps(c + 2 * nr + j, c2);
+					_mm512_store_ps(c + 3 * nr + j, c3);
+				}
+			}
+
+			IR_SIMD_TARGET("avx512f") inline void block_avx512(size_t depth, const double *IR_RESTRICT a, const double *IR_RESTRICT b, size_t nr, double *IR_RESTRICT c) noexcept
+			{
+				size_t j = 0;
+				for (; j + 16 <= nr; j += 16)
+				{
+					__m512d c00 = _mm512_setzero_pd(), c01 = _mm512_setzero_pd(), c10 = _mm512_setzero_pd(), c11 = _mm512_setzero_pd();
+					__m512d c20 = _mm512_setzero_pd(), c21 = _mm512_setzero_pd(), c30 = _mm512_setzero_pd(), c31 = _mm512_setzero_pd();
+					const double *pa = a, *pb = b + j;
+					for (size_t p = 0; p < depth; p++, pa += 4, pb += nr)
+					{
+						const __m512d b0 = _mm512_load_pd(pb), b1 = _mm512_load_pd(pb + 8);
+						__m512d ar = _mm512_set1_pd(pa[0]);
+						c00 = _mm512_fmadd_pd(ar, b0, c00); c01 = _mm512_fmadd_pd(ar, b1, c01);
+						ar = _mm512_set1_pd(pa[1]);
+						c10 = _mm512_fmadd_pd(ar, b0, c10); c11 = _mm512_fmadd_pd(ar, b1, c11);
+						ar = _mm512_set1_pd(pa[2]);
+						c20 = _mm512_fmadd_pd(ar, b0, c20); c21 = _mm512_fmadd_pd(ar, b1, c21);
+						ar = _mm512_set1_pd(pa[3]);
+						c30 = _mm512_fmadd_pd(ar, b0, c30); c31 = _mm512_fmadd_pd(ar, b1, c31);
+					}
+					_mm512_store_pd(c + j, c00); _mm512_store_pd(c + j + 8, c01);
+					_mm512_store_pd(c + nr + j, c10); _mm512_store_pd(c + nr + j + 8, c11);
+					_mm512_store_pd(c + 2 * nr + j, c20); _mm512_store_pd(c + 2 * nr + j + 8, c21);
+					_mm512_store_pd(c + 3 * nr + j, c30); _mm512_store_pd(c + 3 * nr + j + 8, c31);
+				}
+				for (; j < nr; j += 8)
+				{
+					__m512d c0 = _mm512_setzero_pd(), c1 = _mm512_setzero_pd(), c2 = _mm512_setzero_pd(), c3 = _mm512_setzero_pd();
+					const double *pa = a, *pb = b + j;
+					for (size_t p = 0; p < depth; p++, pa += 4, pb += nr)
+					{
+						const __m512d b0 = _mm512_load_pd(pb);
+						c0 = _mm512_fmadd_pd(_mm512_set1_pd(pa[0]), b0, c0);
+						c1 = _mm512_fmadd_pd(_mm512_set1_pd(pa[1]), b0, c1);
+						c2 = _mm512_fmadd_pd(_mm512_set1_pd(pa[2]), b0, c2);
+						c3 = _mm512_fmadd_pd(_mm512_set1_pd(pa[3]), b0, c3);
+					}
+					_mm512_store_pd(c + j, c0);
+					_mm512_store_pd(c + nr + j, c1);
+					_mm512_store_pd(c + 2 * nr + j, c2);
+					_mm512_store_pd(c + 3 * nr + j, c3);
+				}
+			}
+			//8-bit integer kernels
+			//SSE2 has no multiplication of bytes, bytes are sign-extended to words by unpacking them into high halves and shifting back
+			IR_SIMD_TARGET("sse2") inline int32 dot_int8_sse2(size_t n, const int8 *IR_RESTRICT a, const int8 *IR_RESTRICT b) noexcept
+			{
+				__m128i sum = _mm_setzero_si128();
+				size_t i = 0;
+				for (; i + 16 <= n; i += 16)
+				{
+					const __m128i va = _mm_loadu_si128((const __m128i*)(a + i));
+					const __m128i vb = _mm_loadu_si128((const __m128i*)(b + i));
+					const __m128i a0 = _mm_srai_epi16(_mm_unpacklo_epi8(va, va), 8), a1 = _mm_srai_epi16(_mm_unpackhi_epi8(va, va), 8);
+					const __m128i b0 = _mm_srai_epi16(_mm_unpacklo_epi8(vb, vb), 8), b1 = _mm_srai_epi16(_mm_unpackhi_epi8(vb, vb), 8);
+					sum = _mm_add_epi32(sum, _mm_add_epi32(_mm_madd_epi16(a0, b0), _mm_madd_epi16(a1, b1)));
+				}
+				alignas(16) int32 s[4];
+				_mm_store_si128((__m128i*)s, sum);
+				int32 result = s[0] + s[1] + s[2] + s[3];
+				for (; i < n; i++) result += (int32)a[i] * (int32)b[i];
+				return result;
+			}
+
+			//pmaddubsw multiplies unsigned bytes by signed bytes, so sign of a is moved to b. Pair sums of values up to 127 do not saturate
+			IR_SIMD_TARGET("avx2") inline int32 dot_int8_avx2(size_t n, const int8 *IR_RESTRICT a, const int8 *IR_RESTRICT b) noexcept
+			{
+				const __m256i ones = _mm256_set1_epi16(1);
+				__m256i sum = _mm256_setzero_si256();
+				size_t i = 0;
+				for (; i + 32 <= n; i += 32)
+				{
+					const __m256i va = _mm256_loadu_si256((const __m256i*)(a + i));
+					const __m256i vb = _mm256_loadu_si256((const __m256i*)(b + i));
+					const __m256i products = _mm256_maddubs_epi16(_mm256_sign_epi8(va, va), _mm256_sign_epi8(vb, va));
+					sum = _mm256_add_epi32(sum, _mm256_madd_epi16(products, ones));
+				}
+				alignas(32) int32 s[8];
+				_mm256_store_si256((__m256i*)s, sum);
+				int32 result = 0;
+				for (size_t j = 0; j < 8; j++) result += s[j];
+				for (; i < n; i++) result += (int32)a[i] * (int32)b[i];
+				return result;
+			}
+
+			IR_SIMD_TARGET("avx512f,avx512bw") inline int32 dot_int8_avx512(size_t n, const int8 *IR_RESTRICT a, const int8 *IR_RESTRICT b) noexcept
+			{
+				const __m512i ones = _mm512_set1_epi16(1);
+				const __m512i zero = _mm512_setzero_si512();
+				__m512i sum = _mm512_setzero_si512();
+				size_t i = 0;
+				for (; i + 64 <= n; i += 64)
+				{
+					const __m512i va = _mm512_loadu_si512((const void*)(a + i));
+					const __m512i vb = _mm512_loadu_si512((const void*)(b + i));
+					const __m512i vs = _mm512_mask_sub_epi8(vb, _mm512_movepi8_mask(va), zero, vb);
+					sum = _mm512_add_epi32(sum, _mm512_madd_epi16(_mm512_maddubs_epi16(_mm512_abs_epi8(va), vs), ones));
+				}
+				alignas(64) int32 s[16];
+				_mm512_store_si512((void*)s, sum);
+				int32 result = 0;
+				for (size_t j = 0; j < 16; j++) result += s[j];
+				for (; i < n; i++) result += (int32)a[i] * (int32)b[i];
+				return result;
+			}
+
+			//vpdpbusd multiplies and accumulates in one instruction, without intermediate 16-bit sums
+			IR_SIMD_TARGET("avx512f,avx512bw,avx512vnni") inline int32 dot_int8_vnni(size_t n, const int8 *IR_RESTRICT a, const int8 *IR_RESTRICT b) noexcept
+			{
+				const __m512i zero = _mm512_setzero_si512();
+				__m512i sum = _mm512_setzero_si512();
+				size_t i = 0;
+				for (; i + 64 <= n; i += 64)
+				{
+					const __m512i va = _mm512_loadu_si512((const void*)(a + i));
+					const __m512i vb = _mm512_loadu_si512((const void*)(b + i));
+					const __m512i vs = _mm512_mask_sub_epi8(vb, _mm512_movepi8_mask(va), zero, vb);
+					sum = _mm512_dpbusd_epi32(sum, _mm512_abs_epi8(va), vs);
+				}
+				alignas(64) int32 s[16];
+				_mm512_store_si512((void*)s, sum);
+				int32 result = 0;
+				for (size_t j = 0; j < 16; j++) result += s[j];
+				for (; i < n; i++) result += (int32)a[i] * (int32)b[i];
+				return result;
+			}
+
+			//16-bit floating point kernels
+			//bfloat16 is converted by shifting to upper half of 32-bit word
+			IR_SIMD_TARGET("sse2") inline void load_bfloat16_sse2(size_t n, const bfloat16 *IR_RESTRICT source, float *IR_RESTRICT destination) noexcept
+			{
+				const __m128i zero = _mm_setzero_si128();
+				size_t i = 0;
+				for (; i + 8 <= n; i += 8)
+				{
+					const __m128i h = _mm_loadu_si128((const __m128i*)(source + i));
+					_mm_storeu_ps(destination + i, _mm_castsi128_ps(_mm_unpacklo_epi16(zero, h)));
+					_mm_storeu_ps(destination + i + 4, _mm_castsi128_ps(_mm_unpackhi_epi16(zero, h)));
+				}
+				for (; i < n; i++) destination[i] = to_float(source[i]);
+			}
+
+			IR_SIMD_TARGET("sse2") inline float dot_bfloat16_sse2(size_t n, const bfloat16 *IR_RESTRICT a, const float *IR_RESTRICT b) noexcept
+			{
+				const __m128i zero = _mm_setzero_si128();
+				__m128 sum0 = _mm_setzero_ps(), sum1 = _mm_setzero_ps();
+				size_t i = 0;
+				for (; i + 8 <= n; i += 8)
+				{
+					const __m128i h = _mm_loadu_si128((const __m128i*)(a + i));
+					sum0 = _mm_add_ps(sum0, _mm_mul_ps(_mm_castsi128_ps(_mm_unpacklo_epi16(zero, h)), _mm_loadu_ps(b + i)));
+					sum1 = _mm_add_ps(sum1, _mm_mul_ps(_mm_castsi128_ps(_mm_unpackhi_epi16(zero, h)), _mm_loadu_ps(b + i + 4)));
+				}
+				alignas(16) float s[4];
+				_mm_store_ps(s, _mm_add_ps(sum0, sum1));
+				float result = (s[0] + s[1]) + (s[2] + s[3]);
+				for (; i < n; i++) result += to_float(a[i]) * b[i];
+				return result;
+			}
+
+			IR_SIMD_TARGET("avx2,fma,f16c") inline void load_half_avx2(size_t n, const half *IR_RESTRICT source, float *IR_RESTRICT destination) noexcept
+			{
+				size_t i = 0;
+				for (; i + 8 <= n; i += 8) _mm256_storeu_ps(destination + i, _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)(source + i))));
+				for (; i < n; i++) destination[i] = to_float(source[i]);
+			}
+
+			IR_SIMD_TARGET("avx2,fma,f16c") inline void store_half_avx2(size_t n, const float *IR_RESTRICT source, half *IR_RESTRICT destination) noexcept
+			{
+				size_t i = 0;
+				for (; i + 8 <= n; i += 8) _mm_storeu_si128((__m128i*)(destination + i), _mm256_cvtps_ph(_mm256_loadu_ps(source + i), _MM_FROUND_TO_NEAREST_INT));
+				for (; i < n; i++) destination[i] = to_half(source[i]);
+			}
+
+			IR_SIMD_TARGET("avx2,fma,f16c") inline float dot_half_avx2(size_t n, const half *IR_RESTRICT a, const float *IR_RESTRICT b) noexcept
+			{
+				__m256 sum0 = _mm256_setzero_ps(), sum1 = _mm256_setzero_ps();
+				size_t i = 0;
+				for (; i + 16 <= n; i += 16)
+				{
+					sum0 = _mm256_fmadd_ps(_mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)(a + i))), _mm256_loadu_ps(b + i), sum0);
+					sum1 = _mm256_fmadd_ps(_mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)(a + i + 8))), _mm256_loadu_ps(b + i + 8), sum1);
+				}
+				alignas(32) float s[8];
+				_mm256_store_ps(s, _mm256_add_ps(sum0, sum1));
+				float result = ((s[0] + s[1]) + (s[2] + s[3])) + ((s[4] + s[5]) + (s[6] + s[7]));
+				for (; i < n; i++) result += to_float(a[i]) * b[i];
+				return result;
+			}
+
+			IR_SIMD_TARGET("avx2,fma") inline void load_bfloat16_avx2(size_t n, const bfloat16 *IR_RESTRICT source, float *IR_RESTRICT destination) noexcept
+			{
+				size_t i = 0;
+				for (; i + 8 <= n; i += 8)
+				{
+					const __m256i words = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(source + i)));
+					_mm256_storeu_ps(destination + i, _mm256_castsi256_ps(_mm256_slli_epi32(words, 16)));
+				}
+				for (; i < n; i++) destination[i] = to_float(source[i]);
+			}
+
+			IR_SIMD_TARGET("avx2,fma") inline float dot_bfloat16_avx2(size_t n, const bfloat16 *IR_RESTRICT a, const float *IR_RESTRICT b) noexcept
+			{
+				__m256 sum0 = _mm256_setzero_ps(), sum1 = _mm256_setzero_ps();
+				size_t i = 0;
+				for (; i + 16 <= n; i += 16)
+				{
+					const __m256i words0 = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(a + i)));
+					const __m256i words1 = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(a + i + 8)));
+					sum0 = _mm256_fmadd_ps(_mm256_castsi256_ps(_mm256_slli_epi32(words0, 16)), _mm256_loadu_ps(b + i), sum0);
+					sum1 = _mm256_fmadd_ps(_mm256_castsi256_ps(_mm256_slli_epi32(words1, 16)), _mm256_loadu_ps(b + i + 8), sum1);
+				}
+				alignas(32) float s[8];
+				_mm256_store_ps(s, _mm256_add_ps(sum0, sum1));
+				float result = ((s[0] + s[1]) + (s[2] + s[3])) + ((s[4] + s[5]) + (s[6] + s[7]));
+				for (; i < n; i++) result += to_float(a[i]) * b[i];
+				return result;
+			}
+
+			//Masked forms of conversions avoid false uninitialized warnings of unmasked forms in some compilers
+			IR_SIMD_TARGET("avx512f") inline void load_half_avx512(size_t n, const half *IR_RESTRICT source, float *IR_RESTRICT destination) noexcept
+			{
+				const __mmask16 all = 0xFFFF;
+				size_t i = 0;
+				for (; i + 16 <= n; i += 16) _mm512_storeu_ps(destination + i, _mm512_maskz_cvtph_ps(all, _mm256_loadu_si256((const __m256i*)(source + i))));
+				for (; i < n; i++) destination[i] = to_float(source[i]);
+			}
+
+			IR_SIMD_TARGET("avx512f") inline void store_half_avx512(size_t n, const float *IR_RESTRICT source, half *IR_RESTRICT destination) noexcept
+			{
+				const __mmask16 all = 0xFFFF;
+				size_t i = 0;
+				for (; i + 16 <= n; i += 16) _mm256_storeu_si256((__m256i*)(destination + i), _mm512_maskz_cvtps_ph(all, _mm512_loadu_ps(source + i), _MM_FROUND_TO_NEAREST_INT));
+				for (; i < n; i++) destination[i] = to_half(source[i]);
+			}
+
+			IR_SIMD_TARGET("avx512f") inline float dot_half_avx512(size_t n, const half *IR_RESTRICT a, const float *IR_RESTRICT b) noexcept
+			{
+				const __mmask16 all = 0xFFFF;
+				__m512 sum0 = _mm512_setzero_ps(), sum1 = _mm512_setzero_ps();
+				size_t i = 0;
+				for (; i + 32 <= n; i += 32)
+				{
+					sum0 = _mm512_fmadd_ps(_mm512_maskz_cvtph_ps(all, _mm256_loadu_si256((const __m256i*)(a + i))), _mm512_loadu_ps(b + i), sum0);
+					sum1 = _mm512_fmadd_ps(_mm512_maskz_cvtph_ps(all, _mm256_loadu_si256((const __m256i*)(a + i + 16))), _mm512_loadu_ps(b + i + 16), sum1);
+				}
+				float result = reduce_avx512(_mm512_add_ps(sum0, sum1));
+				for (; i < n; i++) result += to_float(a[i]) * b[i];
+				return result;
+			}
+
+			IR_SIMD_TARGET("avx512f") inline void load_bfloat16_avx512(size_t n, const bfloat16 *IR_RESTRICT source, float *IR_RESTRICT destination) noexcept
+			{
+				const __mmask16 all = 0xFFFF;
+				size_t i = 0;
+				for (; i + 16 <= n; i += 16)
+				{
+					const __m512i words = _mm512_maskz_cvtepu16_epi32(all, _mm256_loadu_si256((const __m256i*)(source + i)));
+					_mm512_storeu_ps(destination + i, _mm512_castsi512_ps(_mm512_maskz_slli_epi32(all, words, 16)));
+				}
+				for (; i < n; i++) destination[i] = to_float(source[i]);
+			}
+
+			IR_SIMD_TARGET("avx512f") inline float dot_bfloat16_avx512(size_t n, const bfloat16 *IR_RESTRICT a, const float *IR_RESTRICT b) noexcept
+			{
+				const __mmask16 all = 0xFFFF;
+				__m512 sum0 = _mm512_setzero_ps(), sum1 = _mm512_setzero_ps();
+				size_t i = 0;
+				for (; i + 32 <= n; i += 32)
+				{
+					const __m512i words0 = _mm512_maskz_cvtepu16_epi32(all, _mm256_loadu_si256((const __m256i*)(a + i)));
+					const __m512i words1 = _mm512_maskz_cvtepu16_epi32(all, _mm256_loadu_si256((const __m256i*)(a + i + 16)));
+					sum0 = _mm512_fmadd_ps(_mm512_castsi512_ps(_mm512_maskz_slli_epi32(all, words0, 16)), _mm512_loadu_ps(b + i), sum0);
+					sum1 = _mm512_fmadd_ps(_mm512_castsi512_ps(_mm512_maskz_slli_epi32(all, words1, 16)), _mm512_loadu_ps(b + i + 16), sum1);
+				}
+				float result = reduce_avx512(_mm512_add_ps(sum0, sum1));
+				for (; i < n; i++) result += to_float(a[i]) * b[i];
+				return result;
+			}
+
+			//F16C is reported separately from AVX2
+			inline bool f16c() noexcept
+			{
+				unsigned int registers[4] = { 0, 0, 0, 0 };
+				cpuid(1, 0, registers);
+				return (registers[2] & (1U << 29)) != 0;
+			}
+		#endif
+
+		#ifdef IR_SIMD_NEON
+			//NEON kernels, NEON is always present on ARMv8
+			inline float dot_neon(size_t n, const float *IR_RESTRICT a, const float *IR_RESTRICT b) noexcept
+			{
+				float32x4_t sum0 = vdupq_n_f32(0.0f), sum1 = vdupq_n_f32(0.0f);
+				size_t i = 0;
+				for (; i + 8 <= n; i += 8)
+				{
+					sum0 = vfmaq_f32(sum0, vld1q_f32(a + i), vld1q_f32(b + i));
+					sum1 = vfmaq_f32(sum1, vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+				}
+				float sum = vaddvq_f32(vaddq_f32(sum0, sum1));
+				for (; i < n; i++) sum += a[i] * b[i];
+				return sum;
+			}
+
+			inline double dot_neon(size_t n, const double *IR_RESTRICT a, const double *IR_RESTRICT b) noexcept
+			{
+				float64x2_t sum0 = vdupq_n_f64(0.0), sum1 = vdupq_n_f64(0.0);
+				size_t i = 0;
+				for (; i + 4 <= n; i += 4)
+				{
+					sum0 = vfmaq_f64(sum0, vld1q_f64(a + i), vld1q_f64(b + i));
+					sum1 = vfmaq_f64(sum1, vld1q_f64(a + i + 2), vld1q_f64(b + i + 2));
+				}
+				double sum = vaddvq_f64(vaddq_f64(sum0, sum1));
+				for (; i < n; i++) sum += a[i] * b[i];
+				return sum;
+			}
+
+			inline void axpy_neon(size_t n, float alpha, const float *IR_RESTRICT x, float *IR_RESTRICT y) noexcept
+			{
+				size_t i = 0;
+				for (; i + 4 <= n; i += 4) vst1q_f32(y + i, vfmaq_n_f32(vld1q_f32(y + i), vld1q_f32(x + i), alpha));
+				for (; i < n; i++) y[i] += alpha * x[i];
+			}
+
+			inline void axpy_neon(size_t n, double alpha, const double *IR_RESTRICT x, double *IR_RESTRICT y) noexcept
+			{
+				size_t i = 0;
+				for (; i + 2 <= n; i += 2) vst1q_f64(y + i, vfmaq_n_f64(vld1q_f64(y + i), vld1q_f64(x + i), alpha));
+				for (; i < n; i++) y[i] += alpha * x[i];
+			}
+
+			//Processes 16 columns at once: 16 accumulators out of 32 registers
+			inline void block_neon(size_t depth, const float *IR_RESTRICT a, const float *IR_RESTRICT b, size_t nr, float *IR_RESTRICT c) noexcept
+			{
+				for (size_t j = 0; j < nr; j += 16)
+				{
+					float32x4_t sum[4][4];
+					for (size_t r = 0; r < 4; r++) for (size_t k = 0; k < 4; k++) sum[r][k] = vdupq_n_f32(0.0f);
+					const float *pa = a, *pb = b + j;
+					for (size_t p = 0; p < depth; p++, pa += 4, pb += nr)
+					{
+						const float32x4_t b0 = vld1q_f32(pb), b1 = vld1q_f32(pb + 4), b2 = vld1q_f32(pb + 8), b3 = vld1q_f32(pb + 12);
+						const float32x4_t ar = vld1q_f32(pa);
+						sum[0][0] = vfmaq_laneq_f32(sum[0][0], b0, ar, 0); sum[0][1] = vfmaq_laneq_f32(sum[0][1], b1, ar, 0);
+						sum[0][2] = vfmaq_laneq_f32(sum[0][2], b2, ar, 0); sum[0][3] = vfmaq_laneq_f32(sum[0][3], b3, ar, 0);
+						sum[1][0] = vfmaq_laneq_f32(sum[1][0], b0, ar, 1); sum[1][1] = vfmaq_laneq_f32(sum[1][1], b1, ar, 1);
+						sum[1][2] = vfmaq_laneq_f32(sum[1][2], b2, ar, 1); sum[1][3] = vfmaq_laneq_f32(sum[1][3], b3, ar, 1);
+						sum[2][0] = vfmaq_laneq_f32(sum[2][0], b0, ar, 2); sum[2][1] = vfmaq_laneq_f32(sum[2][1], b1, ar, 2);
+						sum[2][2] = vfmaq_laneq_f32(sum[2][2], b2, ar, 2); sum[2][3] = vfmaq_laneq_f32(sum[2][3], b3, ar, 2);
+						sum[3][0] = vfmaq_laneq_f32(sum[3][0], b0, ar, 3); sum[3][1] = vfmaq_laneq_f32(sum[3][1], b1, ar, 3);
+						sum[3][2] = vfmaq_laneq_f32(sum[3][2], b2, ar, 3); sum[3][3] = vfmaq_laneq_f32(sum[3][3], b3, ar, 3);
+					}
+					for (size_t r = 0; r < 4; r++) for (size_t k = 0; k < 4; k++) vst1q_f32(c + r * nr + j + 4 * k, sum[r][k]);
+				}
+			}
+
+			inline void block_neon(size_t depth, const double *IR_RESTRICT a, const double *IR_RESTRICT b, size_t nr, double *IR_RESTRICT c) noexcept
+			{
+				for (size_t j = 0; j < nr; j += 8)
+				{
+					float64x2_t sum[4][4];
+					for (size_t r = 0; r < 4; r++) for (size_t k = 0; k < 4; k++) sum[r][k] = vdupq_n_f64(0.0);
+					const double *pa = a, *pb = b + j;
+					for (size_t p = 0; p < depth; p++, pa += 4, pb += nr)
+					{
+						const float64x2_t b0 = vld1q_f64(pb), b1 = vld1q_f64(pb + 2), b2 = vld1q_f64(pb + 4), b3 = vld1q_f64(pb + 6);
+						for (size_t r = 0; r < 4; r++)
+						{
+							const float64x2_t ar = vdupq_n_f64(pa[r]);
+							sum[r][0] = vfmaq_f64(sum[r][0], ar, b0); sum[r][1] = vfmaq_f64(sum[r][1], ar, b1);
+							sum[r][2] = vfmaq_f64(sum[r][2], ar, b2); sum[r][3] = vfmaq_f64(sum[r][3], ar, b3);
+						}
+					}
+					for (size_t r = 0; r < 4; r++) for (size_t k = 0; k < 4; k++) vst1q_f64(c + r * nr + j + 2 * k, sum[r][k]);
+				}
+			}
+		#endif
+
+		#ifdef IR_SIMD_NEON
+			//SDOT is optional in ARMv8, without it bytes are multiplied into words and accumulated pairwise
+			inline int32 dot_int8_neon(size_t n, const int8 *IR_RESTRICT a, const int8 *IR_RESTRICT b) noexcept
+			{
+				int32x4_t sum = vdupq_n_s32(0);
+				size_t i = 0;
+				for (; i + 16 <= n; i += 16)
+				{
+					const int8x16_t va = vld1q_s8(a + i), vb = vld1q_s8(b + i);
+					#ifdef __ARM_FEATURE_DOTPROD
+						sum = vdotq_s32(sum, va, vb);
+					#else
+						int16x8_t products = vmull_s8(vget_low_s8(va), vget_low_s8(vb));
+						products = vmlal_s8(products, vget_high_s8(va), vget_high_s8(vb));
+						sum = vpadalq_s16(sum, products);
+					#endif
+				}
+				int32 result = vaddvq_s32(sum);
+				for (; i < n; i++) result += (int32)a[i] * (int32)b[i];
+				return result;
+			}
+
+			//Conversion of half is part of ARMv8, bfloat16 is converted by shifting to upper half of 32-bit word
+			inline void load_half_neon(size_t n, const half *IR_RESTRICT source, float *IR_RESTRICT destination) noexcept
+			{
+				size_t i = 0;
+				for (; i + 4 <= n; i += 4) vst1q_f32(destination + i, vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16((const uint16_t*)(source + i)))));
+				for (; i < n; i++) destination[i] = to_float(source[i]);
+			}
+
+			inline void store_half_neon(size_t n, const float *IR_RESTRICT source, half *IR_RESTRICT destination) noexcept
+			{
+				size_t i = 0;
+				for (; i + 4 <= n; i += 4) vst1_u16((uint16_t*)(destination + i), vreinterpret_u16_f16(vcvt_f16_f32(vld1q_f32(source + i))));
+				for (; i < n; i++) destination[i] = to_half(source[i]);
+			}
+
+			inline float dot_half_neon(size_t n, const half *IR_RESTRICT a, const float *IR_RESTRICT b) noexcept
+			{
+				float32x4_t sum0 = vdupq_n_f32(0.0f), sum1 = vdupq_n_f32(0.0f);
+				size_t i = 0;
+				for (; i + 8 <= n; i += 8)
+				{
+					sum0 = vfmaq_f32(sum0, vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16((const uint16_t*)(a + i)))), vld1q_f32(b + i));
+					sum1 = vfmaq_f32(sum1, vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16((const uint16_t*)(a + i + 4)))), vld1q_f32(b + i + 4));
+				}
+				float result = vaddvq_f32(vaddq_f32(sum0, sum1));
+				for (; i < n; i++) result += to_float(a[i]) * b[i];
+				return result;
+			}
+
+			inline void load_bfloat16_neon(size_t n, const bfloat16 *IR_RESTRICT source, float *IR_RESTRICT destination) noexcept
+			{
+				size_t i = 0;
+				for (; i + 4 <= n; i += 4) vst1q_f32(destination + i, vreinterpretq_f32_u32(vshll_n_u16(vld1_u16((const uint16_t*)(source + i)), 16)));
+				for (; i < n; i++) destination[i] = to_float(source[i]);
+			}
+
+			inline float dot_bfloat16_neon(size_t n, const bfloat16 *IR_RESTRICT a, const float *IR_RESTRICT b) noexcept
+			{
+				float32x4_t sum0 = vdupq_n_f32(0.0f), sum1 = vdupq_n_f32(0.0f);
+				size_t i = 0;
+				for (; i + 8 <= n; i += 8)
+				{
+					sum0 = vfmaq_f32(sum0, vreinterpretq_f32_u32(vshll_n_u16(vld1_u16((const uint16_t*)(a + i)), 16)), vld1q_f32(b + i));
+					sum1 = vfmaq_f32(sum1, vreinterpretq_f32_u32(vshll_n_u16(vld1_u16((const uint16_t*)(a + i + 4)), 16)), vld1q_f32(b + i + 4));
+				}
+				float result = vaddvq_f32(vaddq_f32(sum0, sum1));
+				for (; i < n; i++) result += to_float(a[i]) * b[i];
+				return result;
+			}
+		#endif
+
+		//Chooses 8-bit integer kernels, AVX-512 kernels need AVX-512BW and optionally VNNI
+		inline const Int8Kernels *select_int8() noexcept
+		{
+			static const Int8Kernels none = { simd::none, dot_int8 };
+			#if defined(IR_SIMD_X86)
+				static const Int8Kernels sse2 = { simd::sse2, dot_int8_sse2 };
+				static const Int8Kernels avx2 = { simd::avx2, dot_int8_avx2 };
+				static const Int8Kernels avx512 = { simd::avx512, dot_int8_avx512 };
+				static const Int8Kernels vnni = { simd::avx512, dot_int8_vnni };
+				switch (simd_level())
+				{
+					case simd::sse2: return &sse2;
+					case simd::avx2: return &avx2;
+					case simd::avx512:
+					{
+						unsigned int registers[4] = { 0, 0, 0, 0 };
+						cpuid(7, 0, registers);
+						const bool bw = (registers[1] & (1U << 30)) != 0;
+						const bool vnni_present = (registers[2] & (1U << 11)) != 0;
+						if (!bw) return &avx2;
+						return vnni_present ? &vnni : &avx512;
+					}
+					default: return &none;
+				}
+			#elif defined(IR_SIMD_NEON)
+				static const Int8Kernels neon = { simd::neon, dot_int8_neon };
+				return simd_level() == simd::neon ? &neon : &none;
+			#else
+				return &none;
+			#endif
+		}
+
+		//Detects instruction set extensions supported by processor and operating system
+		inline simd detect() noexcept
+		{
+			simd level = simd::none;
+			#if defined(IR_SIMD_X86)
+				unsigned int registers[4] = { 0, 0, 0, 0 };
+				cpuid(0, 0, registers);
+				const unsigned int max_leaf = registers[0];
+				if (max_leaf >= 1)
+				{
+					cpuid(1, 0, registers);
+					const bool sse2 = (registers[3] & (1U << 26)) != 0;
+					const bool fma = (registers[2] & (1U << 12)) != 0;
+					const bool osxsave = (registers[2] & (1U << 27)) != 0;
+					const bool avx = (registers[2] & (1U << 28)) != 0;
+					const unsigned long long xcr0 = osxsave ? xgetbv() : 0;
+					bool avx2 = false, avx512 = false;
+					if (max_leaf >= 7)
+					{
+						cpuid(7, 0, registers);
+						avx2 = (registers[1] & (1U << 5)) != 0;
+						avx512 = (registers[1] & (1U << 16)) != 0;
+					}
+					if (sse2) level = simd::sse2;
+					if (sse2 && avx && avx2 && fma && (xcr0 & 0x06) == 0x06) level = simd::avx2;
+					if (level == simd::avx2 && avx512 && (xcr0 & 0xE6) == 0xE6) level = simd::avx512;
+				}
+			#elif defined(IR_SIMD_NEON)
+				level = simd::neon;
+			#endif
+
+			//Environment may lower level
+			#ifdef _MSC_VER
+				char *limit = nullptr;
+				size_t limit_size = 0;
+				if (_dupenv_s(&limit, &limit_size, "IR_SIMD") != 0) limit = nullptr;
+			#else
+				const char *limit = getenv("IR_SIMD");
+			#endif
+			if (limit != nullptr)
+			{
+				simd requested = level;
+				if (strcmp(limit, "none") == 0) requested = simd::none;
+				else if (strcmp(limit, "sse2") == 0) requested = simd::sse2;
+				else if (strcmp(limit, "avx2") == 0) requested = simd::avx2;
+				else if (strcmp(limit, "avx512") == 0) requested = simd::avx512;
+				else if (strcmp(limit, "neon") == 0) requested = simd::neon;
+				if (requested == simd::none || (level != simd::neon && requested != simd::neon && (int)requested < (int)level)) level = requested;
+				#ifdef _MSC_VER
+					free(limit);
+				#endif
+			}
+			return level;
+		}
+	}
+}
+
+inline ir::simd ir::simd_level() noexcept
+{
+	static const simd level = simd_kernels::detect();
+	return level;
+}
+
+template<class T>
+inline const ir::Kernels<T> *ir::Kernels<T>::get() noexcept
+{
+	static const Kernels<T> kernels = { simd::none, simd_kernels::dot<T>, simd_kernels::axpy<T>, simd_kernels::block<T> };
+	return &kernels;
+}
+
+template<>
+inline const ir::Kernels<float> *ir::Kernels<float>::get() noexcept
+{
+	static const Kernels<float> none = { simd::none, simd_kernels::dot<float>, simd_kernels::axpy<float>, simd_kernels::block<float> };
+	#if defined(IR_SIMD_X86)
+		static const Kernels<float> sse2 = { simd::sse2, simd_kernels::dot_sse2, simd_kernels::axpy_sse2, simd_kernels::block_sse2 };
+		static const Kernels<float> avx2 = { simd::avx2, simd_kernels::dot_avx2, simd_kernels::axpy_avx2, simd_kernels::block_avx2 };
+		static const Kernels<float> avx512 = { simd::avx512, simd_kernels::dot_avx512, simd_kernels::axpy_avx512, simd_kernels::block_avx512 };
+		switch (simd_level())
+		{
+			case simd::sse2: return &sse2;
+			case simd::avx2: return &avx2;
+			case simd::avx512: return &avx512;
+			default: return &none;
+		}
+	#elif defined(IR_SIMD_NEON)
+		static const Kernels<float> neon = { simd::neon, simd_kernels::dot_neon, simd_kernels::axpy_neon, simd_kernels::block_neon };
+		return simd_level() == simd::neon ? &neon : &none;
+	#else
+		return &none;
+	#endif
+}
+
+template<>
+inline const ir::Kernels<double> *ir::Kernels<double>::get() noexcept
+{
+	static const Kernels<double> none = { simd::none, simd_kernels::dot<double>, simd_kernels::axpy<double>, simd_kernels::block<double> };
+	#if defined(IR_SIMD_X86)
+		static const Kernels<double> sse2 = { simd::sse2, simd_kernels::dot_sse2, simd_kernels::axpy_sse2, simd_kernels::block_sse2 };
+		static const Kernels<double> avx2 = { simd::avx2, simd_kernels::dot_avx2, simd_kernels::axpy_avx2, simd_kernels::block_avx2 };
+		static const Kernels<double> avx512 = { simd::avx512, simd_kernels::dot_avx512, simd_kernels::axpy_avx512, simd_kernels::block_avx512 };
+		switch (simd_level())
+		{
+			case simd::sse2: return &sse2;
+			case simd::avx2: return &avx2;
+			case simd::avx512: return &avx512;
+			default: return &none;
+		}
+	#elif defined(IR_SIMD_NEON)
+		static const Kernels<double> neon = { simd::neon, simd_kernels::dot_neon, simd_kernels::axpy_neon, simd_kernels::block_neon };
+		return simd_level() == simd::neon ? &neon : &none;
+	#else
+		return &none;
+	#endif
+}
+
+inline const ir::Int8Kernels *ir::Int8Kernels::get() noexcept
+{
+	static const Int8Kernels *kernels = simd_kernels::select_int8();
+	return kernels;
+}
+
+inline ir::half ir::to_half(float value) noexcept
+{
+	uint32 bits;
+	memcpy(&bits, &value, sizeof(float));
+	const uint16 sign = (uint16)((bits >> 16) & 0x8000);
+	const uint32 absolute = bits & 0x7FFFFFFF;
+	half result;
+	if (absolute >= 0x7F800000)
+	{
+		//Infinity or NaN, NaN stays quiet NaN
+		result.bits = sign | 0x7C00 | (absolute > 0x7F800000 ? 0x0200 : 0);
+	}
+	else if (absolute >= 0x477FF000)
+	{
+		//65520 and more round to infinity
+		result.bits = sign | 0x7C00;
+	}
+	else if (absolute >= 0x38800000)
+	{
+		//Normal number, exponent is rebiased from 127 to 15
+		uint32 h = (absolute >> 13) - (112 << 10);
+		const uint32 remainder = absolute & 0x1FFF;
+		if (remainder > 0x1000 || (remainder == 0x1000 && (h & 1) != 0)) h++;
+		result.bits = sign | (uint16)h;
+	}
+	else
+	{
+		//Subnormal number or zero, mantissa with hidden bit is shifted and rounded, carry may produce smallest normal number
+		const uint32 shift = 126 - (absolute >> 23);
+		if (shift > 24) { result.bits = sign; return result; }
+		const uint32 mantissa = (absolute & 0x7FFFFF) | 0x800000;
+		uint32 h = mantissa >> shift;
+		const uint32 remainder = mantissa & ((1U << shift) - 1);
+		const uint32 halfway = 1U << (shift - 1);
+		if (remainder > halfway || (remainder == halfway && (h & 1) != 0)) h++;
+		result.bits = sign | (uint16)h;
+	}
+	return result;
+}
+
+inline ir::bfloat16 ir::to_bfloat16(float value) noexcept
+{
+	uint32 bits;
+	memcpy(&bits, &value, sizeof(float));
+	bfloat16 result;
+	if ((bits & 0x7FFFFFFF) > 0x7F800000) result.bits = (uint16)((bits >> 16) | 0x0040);
+	else result.bits = (uint16)((bits + 0x7FFF + ((bits >> 16) & 1)) >> 16);
+	return result;
+}
+
+inline float ir::to_float(half value) noexcept
+{
+	const uint32 sign = (uint32)(value.bits & 0x8000) << 16;
+	const uint32 exponent = (value.bits >> 10) & 0x1F;
+	uint32 mantissa = value.bits & 0x3FF;
+	uint32 bits;
+	if (exponent == 0x1F) bits = sign | 0x7F800000 | (mantissa << 13);
+	else if (exponent != 0) bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+	else if (mantissa == 0) bits = sign;
+	else
+	{
+		//Subnormal half is normal float
+		uint32 e = 113;
+		while ((mantissa & 0x400) == 0) { mantissa <<= 1; e--; }
+		bits = sign | (e << 23) | ((mantissa & 0x3FF) << 13);
+	}
+	float result;
+	memcpy(&result, &bits, sizeof(float));
+	return result;
+}
+
+inline float ir::to_float(bfloat16 value) noexcept
+{
+	const uint32 bits = (uint32)value.bits << 16;
+	float result;
+	memcpy(&result, &bits, sizeof(float));
+	return result;
+}
+
+template<>
+inline const ir::HalfKernels<ir::half> *ir::HalfKernels<ir::half>::get() noexcept
+{
+	static const HalfKernels<half> none = { simd::none, simd_kernels::load_half, simd_kernels::store_half, simd_kernels::dot_half };
+	#if defined(IR_SIMD_X86)
+		static const HalfKernels<half> avx2 = { simd::avx2, simd_kernels::load_half_avx2, simd_kernels::store_half_avx2, simd_kernels::dot_half_avx2 };
+		static const HalfKernels<half> avx512 = { simd::avx512, simd_kernels::load_half_avx512, simd_kernels::store_half_avx512, simd_kernels::dot_half_avx512 };
+		static const bool f16c = simd_kernels::f16c();
+		switch (simd_level())
+		{
+			case simd::avx2: return f16c ? &avx2 : &none;
+			case simd::avx512: return &avx512;
+			default: return &none;
+		}
+	#elif defined(IR_SIMD_NEON)
+		static const HalfKernels<half> neon = { simd::neon, simd_kernels::load_half_neon, simd_kernels::store_half_neon, simd_kernels::dot_half_neon };
+		return simd_level() == simd::neon ? &neon : &none;
+	#else
+		return &none;
+	#endif
+}
+
+template<>
+inline const ir::HalfKernels<ir::bfloat16> *ir::HalfKernels<ir::bfloat16>::get() noexcept
+{
+	static const HalfKernels<bfloat16> none = { simd::none, simd_kernels::load_bfloat16, simd_kernels::store_bfloat16, simd_kernels::dot_bfloat16 };
+	#if defined(IR_SIMD_X86)
+		static const HalfKernels<bfloat16> sse2 = { simd::sse2, simd_kernels::load_bfloat16_sse2, simd_kernels::store_bfloat16, simd_kernels::dot_bfloat16_sse2 };
+		static const HalfKernels<bfloat16> avx2 = { simd::avx2, simd_kernels::load_bfloat16_avx2, simd_kernels::store_bfloat16, simd_kernels::dot_bfloat16_avx2 };
+		static const HalfKernels<bfloat16> avx512 = { simd::avx512, simd_kernels::load_bfloat16_avx512, simd_kernels::store_bfloat16, simd_kernels::dot_bfloat16_avx512 };
+		switch (simd_level())
+		{
+			case simd::sse2: return &sse2;
+			case simd::avx2: return &avx2;
+			case simd::avx512: return &avx512;
+			default: return &none;
+		}
+	#elif defined(IR_SIMD_NEON)
+		static const HalfKernels<bfloat16> neon = { simd::neon, simd_kernels::load_bfloat16_neon, simd_kernels::store_bfloat16, simd_kernels::dot_bfloat16_neon };
+		return simd_level() == simd::neon ? &neon : &none;
+	#else
+		return &none;
+	#endif
+}
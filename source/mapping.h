@@ -34,13 +34,14 @@ ir::Mapping::Mapping() noexcept
 void *ir::Mapping::map(HANDLE hfile, size_t offset, size_t size, map_mode mode) noexcept
 {
 	//If we need to recreate hmapping -> recreate hmapping (end delete mapstart, it will be also recreated)
-	if (_hfile != hfile || _maxmapsize < offset + size || _hmapping == NULL)
+	if (_hfile != hfile || _maxmapsize < offset + size || _hmapping == NULL || _mode != mode)
 	{
 		if (_mapstart != nullptr) { UnmapViewOfFile(_mapstart); _mapstart = nullptr; }
 		if (_hmapping != NULL) CloseHandle(_hmapping);
 		_hfile = hfile;
+		_mode = mode;
 		_maxmapsize = GetFileSize(_hfile, nullptr);
-		_hmapping = CreateFileMappingW(_hfile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		_hmapping = CreateFileMappingW(_hfile, nullptr, (mode == map_mode::copy) ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0, nullptr);
 	}
 
 	//If we have previous step done and need to recreate address -> recreate address
@@ -50,7 +51,7 @@ void *ir::Mapping::map(HANDLE hfile, size_t offset, size_t size, map_mode mode)
 		_lowlimit = offset & ~(_pagesize - 1);
 		_highlimit = (offset + size + _pagesize - 1) & ~(_pagesize - 1);
 		if (_highlimit > _maxmapsize) _highlimit = _maxmapsize;
-		_mapstart = MapViewOfFile(_hmapping, FILE_MAP_READ, 0, (uint32)_lowlimit, _highlimit - _lowlimit);
+		_mapstart = MapViewOfFile(_hmapping, (mode == map_mode::copy) ? FILE_MAP_COPY : FILE_MAP_READ, 0, (uint32)_lowlimit, _highlimit - _lowlimit);
 	}
 	
 	//If we have previous step done, return pointer
@@ -79,6 +80,11 @@ void *ir::Mapping::map(FILE *file, size_t offset, size_t size, map_mode mode) no
 	return map((HANDLE)_get_osfhandle(_fileno(file)), offset, size, mode);
 }
 
+void ir::Mapping::hint(access_pattern pattern) noexcept
+{
+	_pattern = pattern;
+}
+
 void ir::Mapping::close() noexcept
 {
 	if (_mapstart != nullptr)
@@ -106,13 +112,15 @@ ir::Mapping::Mapping() noexcept
 void *ir::Mapping::map(int filedes, size_t offset, size_t size, map_mode mode) noexcept
 {
 	//If we need to recreate address -> recreate address
-	if (_filedes != filedes || _mapstart == MAP_FAILED || offset <= _lowlimit || offset + size > _highlimit)
+	if (_filedes != filedes || _mapstart == MAP_FAILED || offset <= _lowlimit || offset + size > _highlimit || _mode != mode)
 	{
 		if (_mapstart != MAP_FAILED) munmap(_mapstart, _highlimit - _lowlimit);
 		_filedes = filedes;
+		_mode = mode;
 		_lowlimit = offset & ~(_pagesize - 1);
 		_highlimit = offset + size; //may be possible to optimize
-		_mapstart = mmap(nullptr, _highlimit - _lowlimit, PROT_READ, MAP_PRIVATE, _filedes, _lowlimit);
+		_mapstart = mmap(nullptr, _highlimit - _lowlimit, (mode == map_mode::copy) ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_PRIVATE, _filedes, _lowlimit);
+		if (_mapstart != MAP_FAILED && _pattern != access_pattern::normal) hint(_pattern);
 	}
 
 	//If we have previous step done, return pointer
@@ -135,6 +143,16 @@ void *ir::Mapping::map(FILE *file, size_t offset, size_t size, map_mode mode) no
 	return map(fileno(file), offset, size, mode);
 }
 
+void ir::Mapping::hint(access_pattern pattern) noexcept
+{
+	_pattern = pattern;
+	if (_mapstart == MAP_FAILED) return;
+	int advice = MADV_NORMAL;
+	if (pattern == access_pattern::sequential) advice = MADV_SEQUENTIAL;
+	else if (pattern == access_pattern::random) advice = MADV_RANDOM;
+	madvise(_mapstart, _highlimit - _lowlimit, advice);
+}
+
 void ir::Mapping::close() noexcept
 {
 	if (_mapstart != MAP_FAILED)
@@ -9,6 +9,7 @@
 */
 
 #include "../include/ir/resource.h"
+#include "../include/ir/fnv1a.h"
 #include <stdlib.h>
 #include <string.h>
 #ifdef _WIN32
@@ -20,22 +21,38 @@ ir::N2STDatabase::MetaCell::MetaCell() noexcept
 	offset = 0;
 	size = 0;
 	deleted = 0;
+	capacity = 0;
+}
+
+ir::N2STDatabase::SparseMetaCell::SparseMetaCell() noexcept
+{
+	index = 0;
+}
+
+ir::uint32 ir::N2STDatabase::_align(uint32 i) noexcept
+{
+	return (i + sizeof(uint32) - 1) & ~(sizeof(uint32) - 1);
 }
 
 ir::ec ir::N2STDatabase::_read(void *buffer, uint32 offset, uint32 size) noexcept
 {
 	if (offset + size > _file.size) return ec::read_file;
 
-	if (_file.hold)
+	if (size == 0)
+	{
+		//Empty values may lie at the very end of main file and are never indexed
+	}
+	else if (_file.hold)
 	{
 		memcpy(buffer, &_file.ram[offset], size);
 	}
 	else
 	{
-		if (offset != _file.pointer)
+		if (offset != _file.pointer || _file.written)
 		{
 			if (fseek(_file.file, offset, SEEK_SET) != 0) return ec::seek_file;
 			_file.pointer = offset;
+			_file.written = false;
 		}
 		if (fread(buffer, size, 1, _file.file) == 0) return ec::read_file;
 		_file.pointer += size;
@@ -58,12 +75,13 @@ ir::ec ir::N2STDatabase::_write(const void *buffer, uint32 offset, uint32 size)
 			_file.changed = true;
 		}
 	}
-	else
+	else if (size > 0)
 	{
-		if (offset != _file.pointer)
+		if (offset != _file.pointer || !_file.written)
 		{
 			if (fseek(_file.file, offset, SEEK_SET) != 0) return ec::seek_file;
 			_file.pointer = offset;
+			_file.written = true;
 		}
 		if (fwrite(buffer, size, 1, _file.file) == 0) return ec::read_file;
 		_file.pointer += size;
@@ -72,15 +90,53 @@ ir::ec ir::N2STDatabase::_write(const void *buffer, uint32 offset, uint32 size)
 	return ec::ok;
 }
 
+//Copies data inside of main file through small buffer, so it works in both modes
+ir::ec ir::N2STDatabase::_copy(uint32 source, uint32 destination, uint32 size) noexcept
+{
+	char buffer[4096];
+	for (uint32 i = 0; i < size; i += sizeof(buffer))
+	{
+		uint32 part = (size - i < sizeof(buffer)) ? (size - i) : sizeof(buffer);
+		ec code = _read(buffer, source + i, part);
+		if (code != ec::ok) return code;
+		code = _write(buffer, destination + i, part);
+		if (code != ec::ok) return code;
+	}
+	return ec::ok;
+}
+
+//Makes main file at least end bytes long, so reserved space is not given to other values
+ir::ec ir::N2STDatabase::_reserve(uint32 end) noexcept
+{
+	if (end <= _file.size) return ec::ok;
+	char zero = 0;
+	return _write(&zero, end - 1, 1);
+}
+
 ir::ec ir::N2STDatabase::_readpointer(void **p, uint32 offset, uint32 size) noexcept
 {
 	if (offset + size > _file.size) return ec::read_file;
 
-	if (_file.hold)
+	if (size == 0)
+	{
+		static const char empty = '\0';
+		const void *pointer = &empty;
+		memcpy(p, &pointer, sizeof(void*));
+	}
+	else if (_file.hold)
 	{
 		void *pointer = &_file.ram[offset];
 		memcpy(p, &pointer, sizeof(void*));
 	}
+	else if (!_writeaccess && _shared.header != nullptr)
+	{
+		//Reader gets own copy, so writer can not change data after it was checked to be stable
+		if (!_readbuffer.resize(size)) return ec::alloc;
+		ec code = _read(_readbuffer.data(), offset, size);
+		if (code != ec::ok) return code;
+		void *pointer = _readbuffer.data();
+		memcpy(p, &pointer, sizeof(void*));
+	}
 	else
 	{
 		//Actually openmap might change file pointer. It never causes a problem though
@@ -103,12 +159,14 @@ ir::ec ir::N2STDatabase::_metaread(MetaCell *cell, uint32 index) noexcept
 	}
 	else
 	{
-		if (index != _meta.pointer)
+		if (index != _meta.pointer || _meta.written)
 		{
-			if (fseek(_meta.file, sizeof(MetaHeader) + index * sizeof(MetaCell), SEEK_SET) != 0) return ec::seek_file;
+			if (fseek(_meta.file, sizeof(MetaHeader) + index * _metacellsize(), SEEK_SET) != 0) return ec::seek_file;
 			_meta.pointer = index;
+			_meta.written = false;
 		}
-		if (fread(cell, sizeof(MetaCell), 1, _meta.file) == 0) return ec::read_file;
+		if (fread(cell, _metacellsize(), 1, _meta.file) == 0) return ec::read_file;
+		if (_legacy) cell->capacity = cell->size;
 		_meta.pointer++;
 	}
 	return ec::ok;
@@ -128,10 +186,11 @@ ir::ec ir::N2STDatabase::_metawrite(MetaCell cell, uint32 index) noexcept
 	}
 	else
 	{
-		if (index != _meta.pointer)
+		if (index != _meta.pointer || !_meta.written)
 		{
 			if (fseek(_meta.file, sizeof(MetaHeader) + index * sizeof(MetaCell), SEEK_SET) != 0) return ec::seek_file;
 			_meta.pointer = index;
+			_meta.written = true;
 		}
 		//That memory is zero is guaranted by stdlib
 		if (fwrite(&cell, sizeof(MetaCell), 1, _meta.file) == 0) return ec::read_file;
@@ -141,6 +200,253 @@ ir::ec ir::N2STDatabase::_metawrite(MetaCell cell, uint32 index) noexcept
 	return ec::ok;
 }
 
+ir::ec ir::N2STDatabase::_sparsemetaread(SparseMetaCell *cell, uint32 slot) noexcept
+{
+	if (slot >= _meta.size) return ec::read_file;
+
+	if (_meta.hold)
+	{
+		*cell = _meta.sparseram[slot];
+	}
+	else
+	{
+		if (slot != _meta.pointer || _meta.written)
+		{
+			if (fseek(_meta.file, sizeof(SparseMetaHeader) + slot * _metacellsize(), SEEK_SET) != 0) return ec::seek_file;
+			_meta.pointer = slot;
+			_meta.written = false;
+		}
+		if (fread(cell, _metacellsize(), 1, _meta.file) == 0) return ec::read_file;
+		if (_legacy) cell->cell.capacity = cell->cell.size;
+		_meta.pointer++;
+	}
+	return ec::ok;
+}
+
+ir::ec ir::N2STDatabase::_sparsemetawrite(SparseMetaCell cell, uint32 slot) noexcept
+{
+	if (slot >= _meta.size) return ec::read_file;
+
+	if (_meta.hold)
+	{
+		_meta.sparseram[slot] = cell;
+		_meta.changed = true;
+	}
+	else
+	{
+		if (slot != _meta.pointer || !_meta.written)
+		{
+			if (fseek(_meta.file, sizeof(SparseMetaHeader) + slot * sizeof(SparseMetaCell), SEEK_SET) != 0) return ec::seek_file;
+			_meta.pointer = slot;
+			_meta.written = true;
+		}
+		if (fwrite(&cell, sizeof(SparseMetaCell), 1, _meta.file) == 0) return ec::write_file;
+		_meta.pointer++;
+	}
+	return ec::ok;
+}
+
+ir::uint32 ir::N2STDatabase::_metaheadersize() const noexcept
+{
+	return _sparse ? sizeof(SparseMetaHeader) : sizeof(MetaHeader);
+}
+
+//Capacity is the last field of cell, version 1 cells are the same without it
+ir::uint32 ir::N2STDatabase::_metacellsize() const noexcept
+{
+	return (_sparse ? sizeof(SparseMetaCell) : sizeof(MetaCell)) - (_legacy ? sizeof(uint32) : 0);
+}
+
+//slot gets position of cell in table, it equals to index in dense mode
+//cell gets cell of identifier, or empty cell if identifier was never inserted
+ir::ec ir::N2STDatabase::_find(uint32 index, uint32 *slot, MetaCell *cell) noexcept
+{
+	if (!_sparse)
+	{
+		*slot = index;
+		if (index >= _meta.size) *cell = MetaCell();
+		else return _metaread(cell, index);
+		return ec::ok;
+	}
+
+	uint32 searchslot = fnv1a(Block(&index, sizeof(uint32))) & (_meta.size - 1);
+	while (true)
+	{
+		SparseMetaCell searchcell;
+		ec code = _sparsemetaread(&searchcell, searchslot);
+		if (code != ec::ok) return code;
+
+		//Deleted cells keep their identifiers, so the chain ends only on empty cell
+		if (searchcell.cell.offset == 0 || searchcell.index == index)
+		{
+			*slot = searchslot;
+			*cell = searchcell.cell;
+			return ec::ok;
+		}
+
+		searchslot++;
+		if (searchslot == _meta.size) searchslot = 0;
+	}
+}
+
+ir::ec ir::N2STDatabase::_store(uint32 index, uint32 slot, MetaCell cell) noexcept
+{
+	if (!_sparse) return _metawrite(cell, slot);
+	SparseMetaCell sparsecell;
+	sparsecell.index = index;
+	sparsecell.cell = cell;
+	return _sparsemetawrite(sparsecell, slot);
+}
+
+ir::ec ir::N2STDatabase::_readslot(uint32 slot, uint32 *index, MetaCell *cell) noexcept
+{
+	if (!_sparse)
+	{
+		*index = slot;
+		return _metaread(cell, slot);
+	}
+	SparseMetaCell sparsecell;
+	ec code = _sparsemetaread(&sparsecell, slot);
+	if (code != ec::ok) return code;
+	*index = sparsecell.index;
+	*cell = sparsecell.cell;
+	return ec::ok;
+}
+
+//Deleted cells are dropped, their data becomes unused
+ir::ec ir::N2STDatabase::_rehash(uint32 newtablesize) noexcept
+{
+	QuietVector<SparseMetaCell> new_meta;
+	if (!new_meta.resize(newtablesize)) return ec::alloc;
+
+	for (uint32 i = 0; i < _meta.size; i++)
+	{
+		SparseMetaCell cell;
+		ec code = _sparsemetaread(&cell, i);
+		if (code != ec::ok) return code;
+
+		if (cell.cell.offset != 0 && cell.cell.deleted == 0)
+		{
+			uint32 searchslot = fnv1a(Block(&cell.index, sizeof(uint32))) & (newtablesize - 1);
+			while (true)
+			{
+				if (new_meta[searchslot].cell.offset == 0) { new_meta[searchslot] = cell; break; }
+				else { searchslot++; if (searchslot == newtablesize) searchslot = 0; }
+			}
+		}
+	}
+
+	if (_meta.hold)
+	{
+		_meta.sparseram.assign(new_meta);
+		_meta.changed = true;
+	}
+	else
+	{
+		if (fseek(_meta.file, sizeof(SparseMetaHeader), SEEK_SET) != 0) return ec::seek_file;
+		if (fwrite(&new_meta[0], sizeof(SparseMetaCell), newtablesize, _meta.file) < newtablesize) return ec::write_file;
+		_meta.pointer = newtablesize;
+		_meta.written = true;
+	}
+	_meta.size = newtablesize;
+	_meta.delcount = 0;
+	return ec::ok;
+}
+
+//Size is taken from live cells only, so tombstones cause rehashing in place instead of growth
+ir::uint32 ir::N2STDatabase::_growtablesize() const noexcept
+{
+	uint64 newtablesize = 1;
+	while (newtablesize < 4 * (uint64)_meta.count) newtablesize *= 2;
+	return newtablesize > _meta.size ? (uint32)newtablesize : _meta.size;
+}
+
+//Turns just created empty database into sparse one
+ir::ec ir::N2STDatabase::_makesparse() noexcept
+{
+	if (fseek(_meta.file, 0, SEEK_SET) != 0) return ec::seek_file;
+	SparseMetaHeader header;
+	if (fwrite(&header, sizeof(SparseMetaHeader), 1, _meta.file) == 0) return ec::write_file;
+	SparseMetaCell nullcell;
+	if (fwrite(&nullcell, sizeof(SparseMetaCell), 1, _meta.file) == 0) return ec::write_file;
+	_meta.pointer = 1;
+	_meta.written = true;
+	_meta.size = 1;
+	_sparse = true;
+	return ec::ok;
+}
+
+//Copies all values to opposite files and swaps them with current ones
+ir::ec ir::N2STDatabase::_rebuild(bool sparse) noexcept
+{
+	Modification modification(this, !_file.hold && !_meta.hold);
+	bool holdfile = _file.hold;
+	bool holdmeta = _meta.hold;
+	bool logging;
+	access_pattern pattern;
+	{
+		_path[_path.size() - 3] = '\0';
+		ec code;
+		N2STDatabase beta(_path.data(), create_mode::neww, &code, true);
+		_path[_path.size() - 3] = '~';
+		if (code != ec::ok) return code;
+		if (sparse)
+		{
+			code = beta._makesparse();
+			if (code != ec::ok) return code;
+		}
+		if (holdmeta || holdfile)
+		{
+			code = beta.set_ram_mode(holdfile, holdmeta);
+			if (code != ec::ok) return code;
+		}
+		for (uint32 i = 0; i < _meta.size; i++)
+		{
+			uint32 index;
+			MetaCell cell;
+			code = _readslot(i, &index, &cell);
+			if (code != ec::ok) return code;
+			if (cell.offset == 0 || cell.deleted > 0) continue;
+			void *data = nullptr;
+			code = _readpointer(&data, cell.offset, cell.size);
+			if (code != ec::ok) return code;
+			code = beta.insert(index, Block(data, cell.size), insert_mode::not_existing);
+			if (code != ec::ok) return code;
+		}
+		logging = _logging;
+		pattern = _pattern;
+		_logging = false;
+		char buffer[sizeof(N2STDatabase)];
+		memcpy(buffer, this, sizeof(N2STDatabase));
+		memcpy(this, &beta, sizeof(N2STDatabase));
+		memcpy(&beta, buffer, sizeof(N2STDatabase));
+		Shared shared = _shared;
+		_shared = beta._shared;
+		beta._shared = shared;
+		_shared.rebuild++;
+	}
+	_logging = logging;
+	if (pattern != access_pattern::normal) hint(pattern);
+	#ifdef _WIN32
+		_path[_path.size() - 2] = _beta ? 'a' : 'c';
+		_wunlink(_path.data());
+		_path[_path.size() - 2] = _beta ? 'b' : 'd';
+		_wunlink(_path.data());
+	#else
+		_path[_path.size() - 2] = _beta ? 'a' : 'c';
+		unlink(_path.data());
+		_path[_path.size() - 2] = _beta ? 'b' : 'd';
+		unlink(_path.data());
+	#endif
+	return ec::ok;
+}
+
+//Tells if writer has modified database since last refresh, so data that was just read may be inconsistent
+bool ir::N2STDatabase::_unstable() const noexcept
+{
+	return !_writeaccess && _shared_changed(&_shared);
+}
+
 ir::ec ir::N2STDatabase::_check() noexcept
 {
 	//FILE
@@ -161,6 +467,7 @@ ir::ec ir::N2STDatabase::_check() noexcept
 	if (fseek(_file.file, 0, SEEK_END) != 0) return ec::seek_file;
 	_file.size = ftell(_file.file);
 	_file.pointer = _file.size;
+	_file.written = false;
 
 	//META
 	_path[_path.size() - 2] = _beta ? 'd' : 'b';
@@ -172,22 +479,40 @@ ir::ec ir::N2STDatabase::_check() noexcept
 
 	if (_meta.file == nullptr) return ec::open_file;
 	MetaHeader metaheader, metasample;
+	SparseMetaHeader sparseheader, sparsesample;
 	if (fseek(_meta.file, 0, SEEK_SET) != 0) return ec::seek_file;
-	if(fread(&metaheader, sizeof(MetaHeader), 1, _meta.file) == 0
-	|| memcmp(metaheader.signature, metasample.signature, 7) != 0
-	|| metaheader.version != metasample.version) return ec::invalid_signature;
-	
-	_file.used = metaheader.used;
+	if (fread(&metaheader, 8, 1, _meta.file) == 0) return ec::invalid_signature;
+	_legacy = metaheader.version == 1;
+	if (_legacy) metaheader.version = metasample.version;
+	if (memcmp(&metaheader, &metasample, 8) == 0)
+	{
+		_sparse = false;
+		if (fseek(_meta.file, 0, SEEK_SET) != 0) return ec::seek_file;
+		if (fread(&metaheader, sizeof(MetaHeader), 1, _meta.file) == 0) return ec::invalid_signature;
+		_file.used = metaheader.used;
+		_meta.count = metaheader.count;
+	}
+	else if (memcmp(&metaheader, &sparsesample, 8) == 0)
+	{
+		_sparse = true;
+		if (fseek(_meta.file, 0, SEEK_SET) != 0) return ec::seek_file;
+		if (fread(&sparseheader, sizeof(SparseMetaHeader), 1, _meta.file) == 0) return ec::invalid_signature;
+		_file.used = sparseheader.used;
+		_meta.count = sparseheader.count;
+		_meta.delcount = sparseheader.delcount;
+	}
+	else return ec::invalid_signature;
 	if (_file.used > _file.size) return ec::invalid_signature;
 
 	if (fseek(_meta.file, 0, SEEK_END) != 0) return ec::seek_file;
-	_meta.size = ftell(_meta.file) - sizeof(MetaHeader);
-	if (_meta.size % sizeof(MetaCell) != 0) return ec::invalid_signature;
-	_meta.size /= sizeof(MetaCell);
+	_meta.size = ftell(_meta.file) - _metaheadersize();
+	if (_meta.size % _metacellsize() != 0) return ec::invalid_signature;
+	_meta.size /= _metacellsize();
+	if (_sparse && (_meta.size == 0 || (_meta.size & (_meta.size - 1)) != 0)) return ec::invalid_signature;
 	_meta.pointer = _meta.size;
+	_meta.written = false;
 
-	_meta.count = metaheader.count;
-	if (_meta.count > _meta.size) return ec::invalid_signature;
+	if (_meta.count + _meta.delcount > _meta.size) return ec::invalid_signature;
 
 	return ec::ok;
 }
@@ -196,7 +521,7 @@ ir::ec ir::N2STDatabase::_reopen_write(bool createnew) noexcept
 {
 	//FILE
 	_path[_path.size() - 2] = _beta ? 'c' : 'a';
-	if (_file.file != nullptr && createnew)
+	if (_file.file != nullptr)
 	{
 		fclose(_file.file);
 		_file.file = nullptr;
@@ -212,12 +537,13 @@ ir::ec ir::N2STDatabase::_reopen_write(bool createnew) noexcept
 		FileHeader header;
 		if (fwrite(&header, sizeof(FileHeader), 1, _file.file) == 0) return ec::write_file;
 		_file.pointer = sizeof(FileHeader);
+		_file.written = true;
 		_file.size = sizeof(FileHeader);
 	}
 
 	//META
 	_path[_path.size() - 2] = _beta ? 'd' : 'b';
-	if (_meta.file != nullptr && createnew)
+	if (_meta.file != nullptr)
 	{
 		fclose(_meta.file);
 		_meta.file = nullptr;
@@ -233,6 +559,7 @@ ir::ec ir::N2STDatabase::_reopen_write(bool createnew) noexcept
 		MetaHeader header;
 		if (fwrite(&header, sizeof(MetaHeader), 1, _meta.file) == 0) return ec::write_file;
 		_meta.pointer = 0;
+		_meta.written = true;
 		_meta.size = 0;
 	}
 
@@ -253,12 +580,23 @@ ir::ec ir::N2STDatabase::_init(const schar *filepath, create_mode mode, bool opp
 	_path[pathlen] = '~';
 	_path[pathlen + 1] = 'c';
 	_path[pathlen + 2] = '\0';
+	if (!opposite)
+	{
+		ec code = _shared_open(&_path, mode, &_shared);
+		if (code != ec::ok) return code;
+		_path[pathlen + 1] = 'c';
+	}
 	#ifdef _WIN32
 		_beta = (_waccess(_path.data(), 0) == 0);
 	#else
 		_beta = (access(_path.data(), 0) == 0);
 	#endif
 	if (opposite) _beta = !_beta;
+	if (mode == create_mode::read && _shared.header != nullptr && _shared.header->filesize != 0)
+	{
+		_shared_wait(&_shared);
+		_beta = _shared.header->beta != 0;
+	}
 
 	if (mode == create_mode::neww)
 	{
@@ -277,6 +615,15 @@ ir::ec ir::N2STDatabase::_init(const schar *filepath, create_mode mode, bool opp
 	}
 
 	_ok = true;
+	if (mode == create_mode::read) return _refresh(this, true);
+	if (_legacy)
+	{
+		//Writer converts meta file of version 1 before anything is written in old format
+		ec code = optimize();
+		if (code != ec::ok) return code;
+	}
+	_publish_all(this);
+	_shared_allow_readers(&_shared);
 	return ec::ok;
 }
 
@@ -310,10 +657,14 @@ bool ir::N2STDatabase::ok() const noexcept
 ir::ec ir::N2STDatabase::probe(uint32 index) noexcept
 {
 	if (!_ok) return ec::object_not_inited;
+	ec code = _refresh(this, false);
+	if (code != ec::ok) return code;
 	
 	//Read offset & size
+	uint32 slot;
 	MetaCell cell;
-	ec code = _metaread(&cell, index);
+	code = _find(index, &slot, &cell);
+	if (_unstable()) return probe(index);
 	bool found = code == ec::ok && cell.offset != 0 && cell.deleted == 0;
 	if (!found) return ec::key_not_exists;
 
@@ -324,10 +675,13 @@ ir::ec ir::N2STDatabase::read(uint32 index, Block *data) noexcept
 {
 	if (!_ok) return ec::object_not_inited;
 	if (data == nullptr) return ec::null;
+	ec code = _refresh(this, false);
+	if (code != ec::ok) return code;
 
 	//Read offset & size
+	uint32 slot;
 	MetaCell cell;
-	ec code = _metaread(&cell, index);
+	code = _find(index, &slot, &cell);
 	
 	bool found = code == ec::ok && cell.offset != 0 && cell.deleted == 0;
 	if (!found) return ec::key_not_exists;
@@ -335,7 +689,9 @@ ir::ec ir::N2STDatabase::read(uint32 index, Block *data) noexcept
 	//Read data
 	void *readdata = nullptr;
 	code = _readpointer(&readdata, cell.offset, cell.size);
+	if (_unstable()) return read(index, data);
 	if (code != ec::ok) return code;
+	if (_logging && !_file.hold) _log_touch(&_log, cell.offset, cell.size);
 	
 	*data = Block(readdata, cell.size);
 	return ec::ok;
@@ -345,48 +701,155 @@ ir::ec ir::N2STDatabase::insert(uint32 index, Block data, insert_mode mode) noex
 {
 	if (!_ok) return ec::object_not_inited;
 	if (!_writeaccess) return ec::write_file;
+	Modification modification(this, !_file.hold && !_meta.hold);
 
 	//Read offset & size
+	uint32 slot;
 	MetaCell cell;
-	ec code = _metaread(&cell, index);
+	ec code = _find(index, &slot, &cell);
+	if (code != ec::ok) return code;
 	
-	bool found = code == ec::ok && cell.offset != 0 && cell.deleted == 0;
+	bool found = cell.offset != 0 && cell.deleted == 0;
+	bool deleted = cell.offset != 0 && cell.deleted > 0;
 	if (mode == insert_mode::existing && !found) return ec::key_not_exists;
 	else if (mode == insert_mode::not_existing && found) return ec::key_already_exists;
 
-	//If exists or deleted and size is sufficient
+	//If exists or deleted and capacity is sufficient
 	uint32 oldsize = cell.size;
-	if (code == ec::ok && cell.offset != 0 && cell.size >= data.size())
+	if (cell.offset != 0 && cell.capacity >= data.size())
 	{
 		//If something need to be changed
 		if (cell.size != data.size() || cell.deleted > 0)
 		{
 			cell.size = data.size();
 			cell.deleted = 0;
-			code = _metawrite(cell, index);
+			code = _store(index, slot, cell);
 			if (code != ec::ok) return code;
 		}
 	}
 	else
 	{
 		cell.size = data.size();
+		cell.capacity = data.size();
 		cell.deleted = 0;
-		cell.offset = (_file.size + sizeof(uint32) - 1) & ~(sizeof(uint32) - 1);
-		code = _metawrite(cell, index);
+		cell.offset = _align(_file.size);
+		code = _store(index, slot, cell);
 		if (code != ec::ok) return code;
 	}
 	code = _write(data.data(), cell.offset, (uint32)data.size());
 	if (code != ec::ok) return code;
+	code = _reserve(cell.offset + cell.capacity);	//empty value still needs main file to reach its offset
+	if (code != ec::ok) return code;
 
 	if (found)
 	{
-		_file.used += _file.used + (uint32)data.size() - oldsize;
+		_file.used = _file.used + (uint32)data.size() - oldsize;
 	}
 	else
 	{
+		if (deleted && _sparse) _meta.delcount--;
 		_file.used += (uint32)data.size();
 		_meta.count++;
 	}
+	if (_sparse && 2 * (_meta.count + _meta.delcount) > _meta.size) return _rehash(_growtablesize());
+	return ec::ok;
+}
+
+ir::ec ir::N2STDatabase::read_range(uint32 index, uint32 offset, uint32 size, Block *data) noexcept
+{
+	if (!_ok) return ec::object_not_inited;
+	if (data == nullptr) return ec::null;
+	ec code = _refresh(this, false);
+	if (code != ec::ok) return code;
+
+	//Read offset & size
+	uint32 slot;
+	MetaCell cell;
+	code = _find(index, &slot, &cell);
+	bool found = code == ec::ok && cell.offset != 0 && cell.deleted == 0;
+	if (!found) return ec::key_not_exists;
+	if (offset > cell.size || size > cell.size - offset) return ec::invalid_input;
+
+	//Read data
+	void *readdata = nullptr;
+	code = _readpointer(&readdata, cell.offset + offset, size);
+	if (_unstable()) return read_range(index, offset, size, data);
+	if (code != ec::ok) return code;
+	if (_logging && !_file.hold) _log_touch(&_log, cell.offset + offset, size);
+
+	*data = Block(readdata, size);
+	return ec::ok;
+}
+
+ir::ec ir::N2STDatabase::write_range(uint32 index, uint32 offset, Block data) noexcept
+{
+	if (!_ok) return ec::object_not_inited;
+	if (!_writeaccess) return ec::write_file;
+	Modification modification(this, !_file.hold && !_meta.hold);
+
+	//Read offset & size
+	uint32 slot;
+	MetaCell cell;
+	ec code = _find(index, &slot, &cell);
+	bool found = code == ec::ok && cell.offset != 0 && cell.deleted == 0;
+	if (!found) return ec::key_not_exists;
+	if (offset > cell.size || data.size() > cell.size - offset) return ec::invalid_input;
+
+	return _write(data.data(), cell.offset + offset, (uint32)data.size());
+}
+
+ir::ec ir::N2STDatabase::append(uint32 index, Block data, uint32 reserve) noexcept
+{
+	if (!_ok) return ec::object_not_inited;
+	if (!_writeaccess) return ec::write_file;
+	Modification modification(this, !_file.hold && !_meta.hold);
+
+	//Read offset & size
+	uint32 slot;
+	MetaCell cell;
+	ec code = _find(index, &slot, &cell);
+	if (code != ec::ok) return code;
+
+	bool found = cell.offset != 0 && cell.deleted == 0;
+	bool deleted = cell.offset != 0 && cell.deleted > 0;
+	uint32 oldsize = found ? cell.size : 0;
+	if ((uint64)oldsize + data.size() + reserve >= 0x80000000) return ec::invalid_input;
+	uint32 newsize = oldsize + (uint32)data.size();
+
+	if (cell.offset != 0 && cell.capacity >= newsize)
+	{
+		//Value has enough space
+	}
+	else if (cell.offset != 0 && cell.offset + cell.capacity >= _file.size)
+	{
+		//Value is last in main file and can be grown
+		cell.capacity = newsize + reserve;
+	}
+	else
+	{
+		//Value needs to be moved
+		uint32 newoffset = _align(_file.size);
+		code = _copy(cell.offset, newoffset, oldsize);
+		if (code != ec::ok) return code;
+		cell.offset = newoffset;
+		cell.capacity = newsize + reserve;
+	}
+	cell.size = newsize;
+	cell.deleted = 0;
+	code = _store(index, slot, cell);
+	if (code != ec::ok) return code;
+	code = _write(data.data(), cell.offset + oldsize, (uint32)data.size());
+	if (code != ec::ok) return code;
+	code = _reserve(cell.offset + cell.capacity);
+	if (code != ec::ok) return code;
+
+	_file.used += (uint32)data.size();
+	if (!found)
+	{
+		if (deleted && _sparse) _meta.delcount--;
+		_meta.count++;
+	}
+	if (_sparse && 2 * (_meta.count + _meta.delcount) > _meta.size) return _rehash(_growtablesize());
 	return ec::ok;
 }
 
@@ -394,10 +857,12 @@ ir::ec ir::N2STDatabase::delet(uint32 index, delete_mode mode) noexcept
 {
 	if (!_ok) return ec::object_not_inited; 
 	if (!_writeaccess) return ec::write_file;
+	Modification modification(this, !_file.hold && !_meta.hold);
 
 	//Read offset & size
+	uint32 slot;
 	MetaCell cell;
-	ec code = _metaread(&cell, index);
+	ec code = _find(index, &slot, &cell);
 	bool found = code == ec::ok && cell.offset != 0 && cell.deleted == 0;
 
 	if (!found)
@@ -408,11 +873,12 @@ ir::ec ir::N2STDatabase::delet(uint32 index, delete_mode mode) noexcept
 	else
 	{
 		cell.deleted = 1;
-		code = _metawrite(cell, index);
+		code = _store(index, slot, cell);
 		if (code != ec::ok) return code;
 		if (found)
 		{
 			_meta.count--;
+			if (_sparse) _meta.delcount++;
 			_file.used -= cell.size;
 		}
 	}
@@ -447,7 +913,11 @@ ir::ec ir::N2STDatabase::set_table_size(uint32 newtablesize) noexcept
 {
 	if (!_ok) return ec::object_not_inited;
 	if (!_writeaccess) return ec::write_file;
-	else return ec::not_implemented;
+	if (!_sparse) return ec::not_implemented;
+	if (newtablesize == 0 || (newtablesize & (newtablesize - 1)) != 0 || newtablesize < _meta.size) return ec::invalid_input;
+	if (newtablesize == _meta.size) return ec::ok;
+	Modification modification(this, !_file.hold && !_meta.hold);
+	return _rehash(newtablesize);
 }
 
 ir::ec ir::N2STDatabase::set_file_size(uint32 newfilesize) noexcept
@@ -460,27 +930,44 @@ ir::ec ir::N2STDatabase::set_file_size(uint32 newfilesize) noexcept
 ir::ec ir::N2STDatabase::set_ram_mode(bool holdfile, bool holdmeta) noexcept
 {
 	if (!_ok) return ec::object_not_inited;
+	Modification modification(this, _writeaccess && !holdfile && !holdmeta && (_file.hold || _meta.hold));
 
 	//Read meta
 	if (holdmeta && !_meta.hold)
 	{
-		if (!_meta.ram.resize(_meta.size)) return ec::alloc;
-		if (fseek(_meta.file, sizeof(MetaHeader), SEEK_SET) != 0) return ec::seek_file;;
-		if (_meta.size != 0 && fread(&_meta.ram[0], sizeof(MetaCell), _meta.size, _meta.file) < _meta.size)
-			return ec::read_file;
-		_meta.pointer = _meta.size;
+		if (_sparse ? !_meta.sparseram.resize(_meta.size) : !_meta.ram.resize(_meta.size)) return ec::alloc;
+		void *ram = _sparse ? (void*)_meta.sparseram.data() : (void*)_meta.ram.data();
+		if (_legacy)
+		{
+			for (uint32 i = 0; i < _meta.size; i++)
+			{
+				ec code = _sparse ? _sparsemetaread(&_meta.sparseram[i], i) : _metaread(&_meta.ram[i], i);
+				if (code != ec::ok) return code;
+			}
+		}
+		else
+		{
+			if (fseek(_meta.file, _metaheadersize(), SEEK_SET) != 0) return ec::seek_file;;
+			if (_meta.size != 0 && fread(ram, _metacellsize(), _meta.size, _meta.file) < _meta.size)
+				return ec::read_file;
+			_meta.pointer = _meta.size;
+			_meta.written = false;
+		}
 	}
 	//Write meta
 	else if (!holdmeta && _meta.hold)
 	{
 		if (_writeaccess && _meta.changed)
 		{
-			if (fseek(_meta.file, sizeof(MetaHeader), SEEK_SET) != 0) return ec::seek_file;
-			if (_meta.size != 0 && fwrite(&_meta.ram[0], sizeof(MetaCell), _meta.size, _meta.file) < _meta.size)
+			const void *ram = _sparse ? (const void*)_meta.sparseram.data() : (const void*)_meta.ram.data();
+			if (fseek(_meta.file, _metaheadersize(), SEEK_SET) != 0) return ec::seek_file;
+			if (_meta.size != 0 && fwrite(ram, _metacellsize(), _meta.size, _meta.file) < _meta.size)
 				return ec::write_file;
 			_meta.pointer = _meta.size;
+			_meta.written = true;
 		}
 		_meta.ram.clear();
+		_meta.sparseram.clear();
 	}
 	_meta.hold = holdmeta;
 	_meta.changed = false;
@@ -493,6 +980,7 @@ ir::ec ir::N2STDatabase::set_ram_mode(bool holdfile, bool holdmeta) noexcept
 		if (_file.size != 0 && fread(&_file.ram[0], 1, _file.size, _file.file) < _file.size)
 			return ec::read_file;
 		_file.pointer = _file.size;
+		_file.written = false;
 	}
 	//Write data
 	else if (!holdfile && _file.hold)
@@ -503,6 +991,7 @@ ir::ec ir::N2STDatabase::set_ram_mode(bool holdfile, bool holdmeta) noexcept
 			if (_file.size != 0 && fwrite(&_file.ram[0], 1, _file.size, _file.file) < _file.size)
 				return ec::write_file;
 			_file.pointer = _file.size;
+			_file.written = true;
 		}
 		_file.ram.clear();
 	}
@@ -512,49 +1001,70 @@ ir::ec ir::N2STDatabase::set_ram_mode(bool holdfile, bool holdmeta) noexcept
 	return ec::ok;
 }
 
-ir::ec ir::N2STDatabase::optimize() noexcept
+ir::ec ir::N2STDatabase::set_sparse_mode(bool sparse) noexcept
 {
 	if (!_ok) return ec::object_not_inited;
 	if (!_writeaccess) return ec::write_file;
-	{
-		_path[_path.size() - 2] = '\0';
-		ec code;
-		N2STDatabase beta(_path.data(), create_mode::neww, &code, true);
-		for (uint32 i = 0; i < get_table_size(); i++)
-		{
-			ir::Block data;
-			code = read(i, &data);
-			if (code != ec::ok) continue;
-			code = beta.insert(i, data);
-			if (code != ec::ok) return code;
-		}
-		char buffer[sizeof(N2STDatabase)];
-		memcpy(buffer, this, sizeof(N2STDatabase));
-		memcpy(this, &beta, sizeof(N2STDatabase));
-		memcpy(&beta, buffer, sizeof(N2STDatabase));
-	}
-	#ifdef _WIN32
-		_path[_path.size() - 2] = _beta ? 'a' : 'c';
-		_wunlink(_path.data());
-		_path[_path.size() - 2] = _beta ? 'b' : 'd';
-		_wunlink(_path.data());
-	#else
-		_path[_path.size() - 2] = _beta ? 'a' : 'c';
-		unlink(_path.data());
-		_path[_path.size() - 2] = _beta ? 'b' : 'd';
-		unlink(_path.data());
-	#endif
+	if (sparse == _sparse) return ec::ok;
+	return _rebuild(sparse);
+}
+
+bool ir::N2STDatabase::get_sparse_mode() const noexcept
+{
+	return _sparse;
+}
+
+ir::ec ir::N2STDatabase::hint(access_pattern pattern) noexcept
+{
+	if (!_ok) return ec::object_not_inited;
+	_pattern = pattern;
+	_mapping.hint(pattern);
+	ec code = _advise(_file.file, pattern);
+	if (code != ec::ok) return code;
+	return _advise(_meta.file, pattern);
+}
+
+ir::ec ir::N2STDatabase::set_access_log(bool log) noexcept
+{
+	if (!_ok) return ec::object_not_inited;
+	_logging = log;
+	if (!log) _log.clear();
 	return ec::ok;
 }
 
+ir::ec ir::N2STDatabase::warm_up(bool data) noexcept
+{
+	if (!_ok) return ec::object_not_inited;
+	if (_file.hold && _meta.hold) return ec::ok;
+	return _warm_up(&_path, _beta ? 'd' : 'b', _beta ? 'c' : 'a', data && !_file.hold);
+}
+
+ir::ec ir::N2STDatabase::optimize() noexcept
+{
+	if (!_ok) return ec::object_not_inited;
+	if (!_writeaccess) return ec::write_file;
+	return _rebuild(_sparse);
+}
+
 void ir::N2STDatabase::finalize() noexcept
 {
 	_mapping.close();
+	_mapping.hint(access_pattern::normal);
+	if (_logging && _log.size() > 0) _log_save(&_path, _log);
 	set_ram_mode(false, false);
 	if (_file.file != nullptr) fclose(_file.file);
 	if (_meta.file != nullptr)
 	{
-		if (_writeaccess)
+		if (_writeaccess && !_legacy && _sparse)
+		{
+			SparseMetaHeader header;
+			header.count = _meta.count;
+			header.delcount = _meta.delcount;
+			header.used = _file.used;
+			fseek(_meta.file, 0, SEEK_SET);
+			fwrite(&header, sizeof(SparseMetaHeader), 1, _meta.file);
+		}
+		else if (_writeaccess && !_legacy)
 		{
 			MetaHeader header;
 			header.count = _meta.count;
@@ -566,6 +1076,7 @@ void ir::N2STDatabase::finalize() noexcept
 	}
 	_file.hold = false;
 	_file.pointer = 0;
+	_file.written = false;
 	_file.size = 0;
 	_file.file = nullptr;
 	_file.changed = false;
@@ -573,16 +1084,25 @@ void ir::N2STDatabase::finalize() noexcept
 	_file.used = 0;
 	_meta.hold = false;
 	_meta.pointer = 0;
+	_meta.written = false;
 	_meta.size = 0;
 	_meta.file = nullptr;
 	_meta.changed = false;
 	_meta.ram.clear();
+	_meta.sparseram.clear();
 	_meta.count = 0;
 	_meta.delcount = 0;
 	_ok = false;
 	_writeaccess = false;
 	_beta = false;
+	_sparse = false;
+	_legacy = false;
+	_pattern = access_pattern::normal;
+	_logging = false;
+	_log.clear();
+	_readbuffer.clear();
 	_path.clear();
+	_shared_close(&_shared);
 }
 
 ir::N2STDatabase::~N2STDatabase() noexcept
@@ -8,224 +8,1517 @@
 	Reinventing bicycles since 2020
 */
 
-bool ir::Parallel::_ok = false;
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <new>
+#include <thread>
+#include <chrono>
+#ifdef _WIN32
+	#include <Windows.h>
+	#include <share.h>
+#else
+	#include <pthread.h>
+	#include <sched.h>
+	#include <unistd.h>
+	#include <sys/mman.h>
+#endif
 
 #ifndef IR_PARALLEL_IMPLEMENTATION
 
-ir::uint32 ir::Parallel::_n = 0;
+ir::Parallel::Parallel() noexcept
+{
+	_call_lock.clear();
+	_queue_lock.clear();
+	_statistics = false;
+	_tracing = false;
+	_root.pending = 0;
+	_done = false;
+	_queued = 0;
+}
 
-bool ir::Parallel::init(uint32 n) noexcept
+bool ir::Parallel::init(uint32 n, uint32) noexcept
 {
-	if (_ok || n == 0) return false;
-	_n = n;
+	if (_ok || n == 0 || !_scheduler_init(n)) return false;
 	_ok = true;
 	return true;
 }
 
 void ir::Parallel::finalize() noexcept
 {
+	if (!_ok) return;
+	sync();
+	_free_scratch();
+	_scheduler_finalize();
 	_ok = false;
 }
 
-bool ir::Parallel::parallel(const void *user, Function *function) noexcept
+bool ir::Parallel::_parallel(const void *user, Function *function, Job *job) noexcept
 {
-	if (!_ok || function == nullptr) return false;
+	if (!_ok || function == nullptr || _pool == this) return false;
+	_acquire(&_call_lock);
+	_call_job = job;
 	for (uint32 i = 0; i < _n; i++)
 	{
+		Member member(this, i);
 		function(user, i, _n);
 	}
+	_call_lock.clear();
 	return true;
 }
 
+ir::Parallel::~Parallel() noexcept
+{
+	finalize();
+}
+
 #elif IR_PARALLEL_IMPLEMENTATION == 'w'
 
-#include <Windows.h>
+ir::Parallel::Parallel() noexcept
+{
+	_call_lock.clear();
+	_queue_lock.clear();
+	_statistics = false;
+	_tracing = false;
+	_root.pending = 0;
+	_done = false;
+	_queued = 0;
+	InitializeSRWLock(&_lock);
+	InitializeConditionVariable(&_condition);
+}
 
-ir::Parallel::Function * volatile ir::Parallel::_function	= nullptr;
-const void * volatile ir::Parallel::_user					= nullptr;
-ir::uint32 ir::Parallel::_n									= 0;
-volatile ir::uint32 ir::Parallel::_finished					= 0;
-volatile ir::uint32 ir::Parallel::_task						= 0;
+//Spins while value is not expected, then sleeps until _wake
+void ir::Parallel::_wait(volatile LONG *value, LONG expected) noexcept
+{
+	uint64 begin = _profiling() ? _now() : 0;
+	for (uint32 i = 0; i < _spin; i++)
+	{
+		if (*value == expected) { if (begin != 0) _record(_event_spin, begin, _now()); return; }
+		YieldProcessor();
+	}
+	const uint64 spin = (begin != 0) ? _now() : 0;
+	AcquireSRWLockExclusive(&_lock);
+	InterlockedIncrement(&_parked);
+	while (*value != expected) SleepConditionVariableSRW(&_condition, &_lock, INFINITE, 0);
+	InterlockedDecrement(&_parked);
+	ReleaseSRWLockExclusive(&_lock);
+	if (begin != 0)
+	{
+		//Recorded only after wake so parked threads do not write while pool is idle
+		_record(_event_spin, begin, spin);
+		_record(_event_parked, spin, _now());
+	}
+}
 
-DWORD WINAPI ir::Parallel::_windows_function(LPVOID) noexcept
+//Same as _wait, used for futures
+void ir::Parallel::_wait(const std::atomic<uint32> *value, uint32 expected) noexcept
 {
-	uint32 id = InterlockedIncrement(&_finished);
-	uint32 task = 1;
+	uint64 begin = _profiling() ? _now() : 0;
+	for (uint32 i = 0; i < _spin; i++)
+	{
+		if (*value == expected) { if (begin != 0) _record(_event_spin, begin, _now()); return; }
+		YieldProcessor();
+	}
+	const uint64 spin = (begin != 0) ? _now() : 0;
+	AcquireSRWLockExclusive(&_lock);
+	InterlockedIncrement(&_parked);
+	while (*value != expected) SleepConditionVariableSRW(&_condition, &_lock, INFINITE, 0);
+	InterlockedDecrement(&_parked);
+	ReleaseSRWLockExclusive(&_lock);
+	if (begin != 0)
+	{
+		//Recorded only after wake so parked threads do not write while pool is idle
+		_record(_event_spin, begin, spin);
+		_record(_event_parked, spin, _now());
+	}
+}
+
+//Same as _wait, but also returns if tasks are queued
+void ir::Parallel::_idle(LONG task) noexcept
+{
+	uint64 begin = _profiling() ? _now() : 0;
+	for (uint32 i = 0; i < _spin; i++)
+	{
+		if (_task == task || _queued != 0) { if (begin != 0) _record(_event_spin, begin, _now()); return; }
+		YieldProcessor();
+	}
+	const uint64 spin = (begin != 0) ? _now() : 0;
+	AcquireSRWLockExclusive(&_lock);
+	InterlockedIncrement(&_parked);
+	while (_task != task && _queued == 0) SleepConditionVariableSRW(&_condition, &_lock, INFINITE, 0);
+	InterlockedDecrement(&_parked);
+	ReleaseSRWLockExclusive(&_lock);
+	if (begin != 0)
+	{
+		//Recorded only after wake so parked threads do not write while pool is idle
+		_record(_event_spin, begin, spin);
+		_record(_event_parked, spin, _now());
+	}
+}
+
+//Wakes sleeping threads. Must be called after value is changed with interlocked function
+void ir::Parallel::_wake() noexcept
+{
+	if (_parked == 0) return;
+	AcquireSRWLockExclusive(&_lock);
+	WakeAllConditionVariable(&_condition);
+	ReleaseSRWLockExclusive(&_lock);
+}
+
+//Tells first count threads to quit and waits for them
+void ir::Parallel::_stop(uint32 count) noexcept
+{
+	_function = nullptr;
+	_user = nullptr;
+	InterlockedIncrement(&_task);
+	_wake();
+	for (uint32 i = 0; i < count; i++)
+	{
+		WaitForSingleObject(_threads[i], INFINITE);
+		CloseHandle(_threads[i]);
+	}
+	_threads.clear();
+}
+
+DWORD WINAPI ir::Parallel::_windows_function(LPVOID user) noexcept
+{
+	Parallel *pool = (Parallel*)user;
+	const uint32 n = pool->_n;
+	const uint32 id = InterlockedIncrement(&pool->_finished);
+	Member member(pool, id);
+	if (id == n - 1) pool->_wake();
+	LONG task = 1;
 
 	while (true)
 	{
-		if (task != _task)
-		{
-			//Wait for next task
-		}
-		else if (_function == nullptr)
+		pool->_idle(task);
+		if (pool->_task == task)
 		{
 			//Quit
-			InterlockedIncrement(&_finished);
-			return 0;
+			if (pool->_function == nullptr) return 0;
+
+			//Execute function
+			_job = pool->_call_job;
+			pool->_function(pool->_user, id, n);
+			_job = nullptr;
+			if (InterlockedIncrement(&pool->_finished) == (LONG)(n - 1)) pool->_wake();
+			task++;
 		}
 		else
 		{
-			//Execute task
-			_function(_user, id, _n);
-			InterlockedIncrement(&_finished);
-			task++;
+			//Execute queued task
+			Record record;
+			if (pool->_dequeue(&record)) pool->_execute(record);
 		}
 	}
 }
 
-bool ir::Parallel::init(uint32 n) noexcept
+bool ir::Parallel::init(uint32 n, uint32 spin) noexcept
 {
-	if (_ok || n == 0) return false;
+	if (_ok || n == 0 || !_scheduler_init(n)) return false;
+	if (!_threads.resize(n - 1)) { _scheduler_finalize(); return false; }
 	_function = nullptr;
 	_user = nullptr;
 	_finished = 0;
 	_task = 0;
-	_n = n;
+	_parked = 0;
+	_spin = spin;
 	for (uint32 i = 0; i < (n - 1); i++)
 	{
-		if (CreateThread(nullptr, 0, _windows_function, nullptr, 0, nullptr) == NULL) return false;
+		_threads[i] = CreateThread(nullptr, 0, _windows_function, this, 0, nullptr);
+		if (_threads[i] == NULL)
+		{
+			_stop(i);
+			_scheduler_finalize();
+			return false;
+		}
 	}
-	while (_finished != (n - 1)) {}
+	_wait(&_finished, n - 1);
 	_ok = true;
 	return true;
 }
 
 void ir::Parallel::finalize() noexcept
 {
-	_function = nullptr;
-	_user = nullptr;
-	_finished = 0;
-	_task++;
-	while (_finished != (_n - 1)) {}
+	if (!_ok) return;
+	sync();
+	_free_scratch();
+	_acquire(&_call_lock);
+	_stop(_n - 1);
+	_call_lock.clear();
+	_scheduler_finalize();
 	_ok = false;
 }
 
-bool ir::Parallel::parallel(const void *user, Function *function) noexcept
+bool ir::Parallel::_parallel(const void *user, Function *function, Job *job) noexcept
 {
-	if (!_ok || function == nullptr) return false;
+	if (!_ok || function == nullptr || _pool == this) return false;
+	_acquire(&_call_lock);
+	_call_job = job;
 	_function = function;
 	_user = user;
 	_finished = 0;
-	_task++;
-	function(user, 0, _n);
-	while (_finished != (_n - 1)) {}
+	InterlockedIncrement(&_task);
+	_wake();
+	{
+		Member member(this, 0);
+		function(user, 0, _n);
+		_wait(&_finished, _n - 1);
+	}
+	_call_lock.clear();
 	return true;
 }
 
+ir::Parallel::~Parallel() noexcept
+{
+	finalize();
+}
+
 #elif IR_PARALLEL_IMPLEMENTATION == 'p'
 
-#include <pthread.h>
+ir::Parallel::Parallel() noexcept
+{
+	_call_lock.clear();
+	_queue_lock.clear();
+	_statistics = false;
+	_tracing = false;
+	_root.pending = 0;
+	_done = false;
+	_queued = 0;
+	_finished = 0;
+	_task = 0;
+	_parked = 0;
+	pthread_mutex_init(&_mutex, nullptr);
+	pthread_cond_init(&_condition, nullptr);
+}
 
-ir::Parallel::Function * volatile ir::Parallel::_function	= nullptr;
-const void * volatile ir::Parallel::_user					= nullptr;
-ir::uint32 ir::Parallel::_n									= 0;
-volatile std::atomic<ir::uint32> ir::Parallel::_finished	= 0;
-volatile std::atomic<ir::uint32> ir::Parallel::_task		= 0;
+//Spins while value is not expected, then sleeps until _wake
+void ir::Parallel::_wait(const std::atomic<uint32> *value, uint32 expected) noexcept
+{
+	uint64 begin = _profiling() ? _now() : 0;
+	for (uint32 i = 0; i < _spin; i++)
+	{
+		if (*value == expected) { if (begin != 0) _record(_event_spin, begin, _now()); return; }
+	}
+	const uint64 spin = (begin != 0) ? _now() : 0;
+	pthread_mutex_lock(&_mutex);
+	_parked++;
+	while (*value != expected) pthread_cond_wait(&_condition, &_mutex);
+	_parked--;
+	pthread_mutex_unlock(&_mutex);
+	if (begin != 0)
+	{
+		//Recorded only after wake so parked threads do not write while pool is idle
+		_record(_event_spin, begin, spin);
+		_record(_event_parked, spin, _now());
+	}
+}
+
+//Same as _wait, but also returns if tasks are queued
+void ir::Parallel::_idle(uint32 task) noexcept
+{
+	uint64 begin = _profiling() ? _now() : 0;
+	for (uint32 i = 0; i < _spin; i++)
+	{
+		if (_task == task || _queued != 0) { if (begin != 0) _record(_event_spin, begin, _now()); return; }
+	}
+	const uint64 spin = (begin != 0) ? _now() : 0;
+	pthread_mutex_lock(&_mutex);
+	_parked++;
+	while (_task != task && _queued == 0) pthread_cond_wait(&_condition, &_mutex);
+	_parked--;
+	pthread_mutex_unlock(&_mutex);
+	if (begin != 0)
+	{
+		//Recorded only after wake so parked threads do not write while pool is idle
+		_record(_event_spin, begin, spin);
+		_record(_event_parked, spin, _now());
+	}
+}
+
+//Wakes sleeping threads. Must be called after value is changed
+void ir::Parallel::_wake() noexcept
+{
+	if (_parked == 0) return;
+	pthread_mutex_lock(&_mutex);
+	pthread_cond_broadcast(&_condition);
+	pthread_mutex_unlock(&_mutex);
+}
+
+//Tells first count threads to quit and waits for them
+void ir::Parallel::_stop(uint32 count) noexcept
+{
+	_function = nullptr;
+	_user = nullptr;
+	_task++;
+	_wake();
+	for (uint32 i = 0; i < count; i++) pthread_join(_threads[i], nullptr);
+	_threads.clear();
+}
 
-void *ir::Parallel::_posix_function(void *) noexcept
+void *ir::Parallel::_posix_function(void *user) noexcept
 {
-	uint32 id = _finished.fetch_add(1);
+	Parallel *pool = (Parallel*)user;
+	const uint32 n = pool->_n;
+	const uint32 id = ++pool->_finished;
+	Member member(pool, id);
+	if (id == n - 1) pool->_wake();
 	uint32 task = 1;
 
 	while (true)
 	{
-		if (task != _task)
-		{
-			//Wait for next task
-		}
-		else if (_function == nullptr)
+		pool->_idle(task);
+		if (pool->_task == task)
 		{
 			//Quit
-			_finished.fetch_add(1);
-			return 0;
+			if (pool->_function == nullptr) return nullptr;
+
+			//Execute function
+			_job = pool->_call_job;
+			pool->_function(pool->_user, id, n);
+			_job = nullptr;
+			if (++pool->_finished == n - 1) pool->_wake();
+			task++;
 		}
 		else
 		{
-			//Execute task
-			_function(_user, id, _n);
-			_finished.fetch_add(1);
-			task++;
+			//Execute queued task
+			Record record;
+			if (pool->_dequeue(&record)) pool->_execute(record);
 		}
 	}
 }
 
-bool ir::Parallel::init(uint32 n) noexcept
+bool ir::Parallel::init(uint32 n, uint32 spin) noexcept
 {
-	if (_ok || n == 0) return false;
+	if (_ok || n == 0 || !_scheduler_init(n)) return false;
+	if (!_threads.resize(n - 1)) { _scheduler_finalize(); return false; }
 	_function = nullptr;
 	_user = nullptr;
 	_finished = 0;
 	_task = 0;
-	_n = n;
-	pthread_attr_t attr;
-	pthread_attr_init(&attr);
-	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	_parked = 0;
+	_spin = spin;
 	for (uint32 i = 0; i < (n - 1); i++)
 	{
-		if (pthread_create(nullptr, &attr, _posix_function, this) != 0) return false;
+		if (pthread_create(&_threads[i], nullptr, _posix_function, this) != 0)
+		{
+			_stop(i);
+			_scheduler_finalize();
+			return false;
+		}
 	}
-	pthread_attr_destroy(&attr);
-	while (_finished != (n - 1)) {}
+	_wait(&_finished, n - 1);
 	_ok = true;
 	return true;
 }
 
 void ir::Parallel::finalize() noexcept
 {
-	_function = nullptr;
-	_user = nullptr;
-	_finished = 0;
-	_task++;
-	while (_finished != (_n - 1)) {}
+	if (!_ok) return;
+	sync();
+	_free_scratch();
+	_acquire(&_call_lock);
+	_stop(_n - 1);
+	_call_lock.clear();
+	_scheduler_finalize();
 	_ok = false;
 }
 
-bool ir::Parallel::parallel(const void *user, Function *function) noexcept
+bool ir::Parallel::_parallel(const void *user, Function *function, Job *job) noexcept
 {
-	if (!_ok || function == nullptr) return false;
+	if (!_ok || function == nullptr || _pool == this) return false;
+	_acquire(&_call_lock);
+	_call_job = job;
 	_function = function;
 	_user = user;
 	_finished = 0;
 	_task++;
-	function(user, 0, _n);
-	while (_finished != (_n - 1)) {}
+	_wake();
+	{
+		Member member(this, 0);
+		function(user, 0, _n);
+		_wait(&_finished, _n - 1);
+	}
+	_call_lock.clear();
 	return true;
 }
 
+ir::Parallel::~Parallel() noexcept
+{
+	finalize();
+	pthread_cond_destroy(&_condition);
+	pthread_mutex_destroy(&_mutex);
+}
+
 #elif IR_PARALLEL_IMPLEMENTATION == 'o'
 
 #include <omp.h>
 
-ir::uint32 ir::Parallel::_n								= 0;
+ir::Parallel::Parallel() noexcept
+{
+	_call_lock.clear();
+	_queue_lock.clear();
+	_statistics = false;
+	_tracing = false;
+	_root.pending = 0;
+	_done = false;
+	_queued = 0;
+}
 
-bool ir::Parallel::init(uint32 n) noexcept
+bool ir::Parallel::init(uint32 n, uint32) noexcept
 {
-	if (_ok || n == 0) return false;
-	_n = n;
+	if (_ok || n == 0 || !_scheduler_init(n)) return false;
 	_ok = true;
 	return true;
 }
 
 void ir::Parallel::finalize() noexcept
 {
+	if (!_ok) return;
+	sync();
+	_free_scratch();
+	_scheduler_finalize();
 	_ok = false;
 }
 
-bool ir::Parallel::parallel(const void *user, Function *function) noexcept
+bool ir::Parallel::_parallel(const void *user, Function *function, Job *job) noexcept
 {
-	if (!_ok || function == nullptr) return false;
+	if (!_ok || function == nullptr || _pool == this) return false;
+	_acquire(&_call_lock);
+	_call_job = job;
 	#pragma omp parallel num_threads(_n)
 	{
-		function(user, omp_get_thread_num(), _n);
+		//Team may be smaller than requested, e.g. if compiled without OpenMP
+		Member member(this, omp_get_thread_num());
+		function(user, omp_get_thread_num(), omp_get_num_threads());
 		#pragma omp barrier
 	}
+	_call_lock.clear();
 	return true;
 }
 
+ir::Parallel::~Parallel() noexcept
+{
+	finalize();
+}
+
 #endif
 
-bool ir::Parallel::ok() noexcept
+thread_local ir::Parallel *ir::Parallel::_pool				= nullptr;
+thread_local ir::uint32 ir::Parallel::_id					= 0;
+thread_local ir::Parallel::Frame *ir::Parallel::_frame		= nullptr;
+thread_local ir::Parallel::Job *ir::Parallel::_job			= nullptr;
+thread_local ir::uint32 ir::Parallel::_random				= 0;
+
+ir::Parallel::Member::Member(Parallel *pool, uint32 id) noexcept
+{
+	this->pool = _pool;
+	this->id = _id;
+	this->frame = _frame;
+	this->job = _job;
+	_pool = pool;
+	_id = id;
+	_frame = nullptr;
+	_job = pool->_call_job;
+	if (_random == 0) _random = 2463534242 + id;
+}
+
+ir::Parallel::Member::~Member() noexcept
+{
+	_pool = pool;
+	_id = id;
+	_frame = frame;
+	_job = job;
+}
+
+void ir::Parallel::_acquire(std::atomic_flag *lock) noexcept
+{
+	while (lock->test_and_set(std::memory_order_acquire)) std::this_thread::yield();
+}
+
+struct ir::Parallel::Counters
+{
+	std::atomic<uint64> tasks;
+	std::atomic<uint64> chunks;
+	std::atomic<uint64> steals;
+	std::atomic<uint64> busy;
+	std::atomic<uint64> spin;
+	std::atomic<uint64> parked;
+	QuietVector<Event> events;
+	char padding[64];
+	Counters() noexcept : tasks(0), chunks(0), steals(0), busy(0), spin(0), parked(0) {}
+};
+
+//Sets number of threads first, so _scheduler_finalize releases all counters even if init fails later
+bool ir::Parallel::_scheduler_init(uint32 n) noexcept
+{
+	_n = n;
+	_deques = (Deque*)malloc(n * sizeof(Deque));
+	if (_deques == nullptr) return false;
+	for (uint32 i = 0; i < n; i++)
+	{
+		new(&_deques[i].top) std::atomic<int64>(0);
+		new(&_deques[i].bottom) std::atomic<int64>(0);
+		for (uint32 j = 0; j < _deque_size; j++)
+		{
+			new(&_deques[i].slots[j].task) std::atomic<Task*>(nullptr);
+			new(&_deques[i].slots[j].user) std::atomic<const void*>(nullptr);
+			new(&_deques[i].slots[j].parent) std::atomic<Frame*>(nullptr);
+			new(&_deques[i].slots[j].job) std::atomic<Job*>(nullptr);
+		}
+	}
+	_counters = (Counters*)malloc(n * sizeof(Counters));
+	if (_counters == nullptr) { free(_deques); _deques = nullptr; return false; }
+	for (uint32 i = 0; i < n; i++) new(&_counters[i]) Counters();
+	_statistics = false;
+	_tracing = false;
+	_root.pending = 0;
+	_queue.clear();
+	_queue_head = 0;
+	_queued = 0;
+	return true;
+}
+
+void ir::Parallel::_scheduler_finalize() noexcept
+{
+	if (_deques != nullptr)
+	{
+		free(_deques);
+		_deques = nullptr;
+	}
+	if (_counters != nullptr)
+	{
+		for (uint32 i = 0; i < _n; i++) _counters[i].~Counters();
+		free(_counters);
+		_counters = nullptr;
+	}
+	_statistics = false;
+	_tracing = false;
+	_queue.clear();
+	_queue_head = 0;
+}
+
+//Pushes record to bottom of own deque, fails if deque is full
+bool ir::Parallel::_push(const Record &record) noexcept
+{
+	Deque *deque = &_deques[_id];
+	const int64 bottom = deque->bottom;
+	if (bottom - deque->top >= (int64)_deque_size) return false;
+	Slot *slot = &deque->slots[bottom & (_deque_size - 1)];
+	slot->task.store(record.task, std::memory_order_relaxed);
+	slot->user.store(record.user, std::memory_order_relaxed);
+	slot->parent.store(record.parent, std::memory_order_relaxed);
+	slot->job.store(record.job, std::memory_order_relaxed);
+	deque->bottom = bottom + 1;
+	return true;
+}
+
+//Pops record from bottom of own deque
+bool ir::Parallel::_pop(Record *record) noexcept
+{
+	Deque *deque = &_deques[_id];
+	const int64 bottom = deque->bottom - 1;
+	deque->bottom = bottom;
+	int64 top = deque->top;
+	if (top > bottom)
+	{
+		//Empty
+		deque->bottom = bottom + 1;
+		return false;
+	}
+	const Slot *slot = &deque->slots[bottom & (_deque_size - 1)];
+	record->task = slot->task.load(std::memory_order_relaxed);
+	record->user = slot->user.load(std::memory_order_relaxed);
+	record->parent = slot->parent.load(std::memory_order_relaxed);
+	record->job = slot->job.load(std::memory_order_relaxed);
+	if (top < bottom) return true;
+	//Last record, race with thieves
+	const bool won = deque->top.compare_exchange_strong(top, top + 1);
+	deque->bottom = bottom + 1;
+	return won;
+}
+
+//Steals record from top of other thread's deque
+bool ir::Parallel::_steal(uint32 victim, Record *record) noexcept
+{
+	Deque *deque = &_deques[victim];
+	int64 top = deque->top;
+	const int64 bottom = deque->bottom;
+	if (top >= bottom) return false;
+	const Slot *slot = &deque->slots[top & (_deque_size - 1)];
+	record->task = slot->task.load(std::memory_order_relaxed);
+	record->user = slot->user.load(std::memory_order_relaxed);
+	record->parent = slot->parent.load(std::memory_order_relaxed);
+	record->job = slot->job.load(std::memory_order_relaxed);
+	return deque->top.compare_exchange_strong(top, top + 1);
+}
+
+//Adds record to queue of tasks spawned outside of pool
+bool ir::Parallel::_enqueue(const Record &record) noexcept
+{
+	_acquire(&_queue_lock);
+	const bool ok = _queue.push_back(record);
+	if (ok) _queued++;
+	_queue_lock.clear(std::memory_order_release);
+	#if defined(IR_PARALLEL_IMPLEMENTATION) && (IR_PARALLEL_IMPLEMENTATION == 'w' || IR_PARALLEL_IMPLEMENTATION == 'p')
+		if (ok) _wake();
+	#endif
+	return ok;
+}
+
+//Takes first record from queue
+bool ir::Parallel::_dequeue(Record *record) noexcept
+{
+	if (_queued == 0) return false;
+	_acquire(&_queue_lock);
+	const bool ok = _queue_head < _queue.size();
+	if (ok)
+	{
+		*record = _queue[_queue_head++];
+		if (_queue_head == _queue.size()) { _queue.clear(); _queue_head = 0; }
+		_queued--;
+	}
+	_queue_lock.clear(std::memory_order_release);
+	return ok;
+}
+
+//Takes record from own deque or queue, or steals it from random thread
+bool ir::Parallel::_find(Record *record) noexcept
+{
+	if (_pop(record) || _dequeue(record)) return true;
+	const uint32 n = _n;
+	if (n == 1) return false;
+	_random ^= _random << 13;
+	_random ^= _random >> 17;
+	_random ^= _random << 5;
+	const uint32 first = _random % n;
+	for (uint32 i = 0; i < n; i++)
+	{
+		const uint32 victim = (first + i) % n;
+		if (victim != _id && _steal(victim, record))
+		{
+			if (_statistics.load(std::memory_order_relaxed)) _counters[_id].steals.fetch_add(1, std::memory_order_relaxed);
+			return true;
+		}
+	}
+	return false;
+}
+
+//Executes task and waits for its subtasks
+void ir::Parallel::_execute(const Record &record) noexcept
+{
+	Frame frame;
+	frame.pending = 0;
+	Frame *parent_frame = _frame;
+	Job *parent_job = _job;
+	_frame = &frame;
+	_job = record.job;
+	if (record.job == nullptr || !record.job->cancelled())
+	{
+		const uint64 begin = _profiling() ? _now() : 0;
+		record.task(record.user);
+		if (begin != 0) _record(_event_task, begin, _now());
+	}
+	_help(&frame);
+	_frame = parent_frame;
+	_job = parent_job;
+	record.parent->pending--;
+}
+
+//Executes tasks until all tasks of the frame are finished
+void ir::Parallel::_help(Frame *frame) noexcept
+{
+	Record record;
+	while (frame->pending != 0)
+	{
+		if (_find(&record)) _execute(record);
+		else std::this_thread::yield();
+	}
+}
+
+//Function executed by every thread during sync outside of pool
+void ir::Parallel::_schedule(const void *user, uint32 id, uint32) noexcept
+{
+	Parallel *pool = (Parallel*)user;
+	if (id == 0)
+	{
+		pool->_help(&pool->_root);
+		pool->_done = true;
+	}
+	else
+	{
+		Record record;
+		while (!pool->_done)
+		{
+			if (pool->_find(&record)) pool->_execute(record);
+			else std::this_thread::yield();
+		}
+	}
+}
+
+bool ir::Parallel::_spawn(Task *task, const void *user, Job *job) noexcept
+{
+	if (!_ok || task == nullptr) return false;
+	Record record;
+	record.task = task;
+	record.user = user;
+	record.job = job;
+	if (_pool == this)
+	{
+		record.parent = (_frame == nullptr) ? &_root : _frame;
+		record.parent->pending++;
+		if (!_push(record)) _execute(record);	//Deque is full, execute immediately
+	}
+	else
+	{
+		record.parent = &_root;
+		_root.pending++;
+		if (!_enqueue(record)) { _root.pending--; return false; }
+	}
+	return true;
+}
+
+bool ir::Parallel::spawn(Task *task, const void *user, Job *job) noexcept
+{
+	return _spawn(task, user, job == nullptr ? _job : job);
+}
+
+bool ir::Parallel::sync() noexcept
+{
+	if (!_ok) return false;
+	if (_pool == this) _help(_frame == nullptr ? &_root : _frame);
+	else if (_root.pending != 0)
+	{
+		_done = false;
+		_parallel(this, _schedule, nullptr);
+	}
+	return true;
+}
+
+struct ir::Parallel::ProfileContext
+{
+	Parallel *pool;
+	const void *user;
+	Function *function;
+};
+
+void ir::Parallel::_profile_function(const void *user, uint32 id, uint32 n) noexcept
+{
+	const ProfileContext *context = (const ProfileContext*)user;
+	const uint64 begin = _now();
+	context->function(context->user, id, n);
+	context->pool->_record(_event_function, begin, _now());
+}
+
+//Executes function as operation of job, operations without job get their own one
+bool ir::Parallel::_operation(const void *user, Function *function, Job *job) noexcept
+{
+	Job local;
+	if (job == nullptr) job = &local;
+	if (_pool == this)
+	{
+		//Other members may wait for calling thread, so it executes all parts of nested operation itself
+		Job *parent_job = _job;
+		_job = job;
+		for (uint32 i = 0; i < _n; i++) function(user, i, _n);
+		_job = parent_job;
+		return job->error() == ec::ok;
+	}
+	return _parallel(user, function, job) && job->error() == ec::ok;
+}
+
+bool ir::Parallel::parallel(const void *user, Function *function, Job *job) noexcept
+{
+	if (!_profiling() || function == nullptr) return _operation(user, function, job);
+	ProfileContext context;
+	context.pool = this;
+	context.user = user;
+	context.function = function;
+	return _operation(&context, _profile_function, job);
+}
+
+ir::Parallel::Job::Job() noexcept
+{
+	_reset();
+}
+
+void ir::Parallel::Job::_reset() noexcept
+{
+	_cancelled = false;
+	_error = (uint32)ec::ok;
+}
+
+void ir::Parallel::Job::cancel() noexcept
+{
+	_cancelled.store(true, std::memory_order_relaxed);
+}
+
+void ir::Parallel::Job::fail(ec code) noexcept
+{
+	uint32 expected = (uint32)ec::ok;
+	_error.compare_exchange_strong(expected, (uint32)code);
+	cancel();
+}
+
+bool ir::Parallel::Job::cancelled() const noexcept
+{
+	return _cancelled.load(std::memory_order_relaxed);
+}
+
+ir::ec ir::Parallel::Job::error() const noexcept
+{
+	return (ec)_error.load();
+}
+
+void ir::Parallel::cancel() noexcept
+{
+	if (_job != nullptr) _job->cancel();
+}
+
+void ir::Parallel::fail(ec code) noexcept
+{
+	if (_job != nullptr) _job->fail(code);
+}
+
+bool ir::Parallel::cancelled() const noexcept
+{
+	return _job != nullptr && _job->cancelled();
+}
+
+struct ir::Parallel::ForContext
+{
+	const Parallel *pool;
+	const void *user;
+	Range *body;
+	size_t end;
+	size_t grain;
+	std::atomic<size_t> next;		//first index of next unclaimed chunk
+};
+
+struct ir::Parallel::ReduceContext
+{
+	const Parallel *pool;
+	const void *user;
+	Reduce *body;
+	size_t end;
+	size_t grain;
+	std::atomic<size_t> next;
+	char *accumulators;				//accumulator for each thread
+	size_t size;
+};
+
+//Chooses grain so that every thread gets about eight chunks
+size_t ir::Parallel::_grain(size_t begin, size_t end, size_t grain) const noexcept
+{
+	if (grain != 0) return grain;
+	grain = (end - begin) / (8 * (size_t)_n);
+	return grain == 0 ? 1 : grain;
+}
+
+void ir::Parallel::_for(const void *user, uint32 id, uint32) noexcept
+{
+	ForContext *context = (ForContext*)user;
+	while (!context->pool->cancelled())
+	{
+		const size_t begin = context->next.fetch_add(context->grain);
+		if (begin >= context->end) return;
+		const size_t end = (context->end - begin > context->grain) ? begin + context->grain : context->end;
+		const uint64 time = context->pool->_profiling() ? _now() : 0;
+		context->body(context->user, id, begin, end);
+		if (time != 0) context->pool->_record(_event_chunk, time, _now());
+	}
+}
+
+void ir::Parallel::_reduce(const void *user, uint32 id, uint32) noexcept
+{
+	ReduceContext *context = (ReduceContext*)user;
+	void *accumulator = context->accumulators + id * context->size;
+	while (!context->pool->cancelled())
+	{
+		const size_t begin = context->next.fetch_add(context->grain);
+		if (begin >= context->end) return;
+		const size_t end = (context->end - begin > context->grain) ? begin + context->grain : context->end;
+		const uint64 time = context->pool->_profiling() ? _now() : 0;
+		context->body(context->user, begin, end, accumulator);
+		if (time != 0) context->pool->_record(_event_chunk, time, _now());
+	}
+}
+
+bool ir::Parallel::parallel_for(size_t begin, size_t end, size_t grain, const void *user, Range *body, Job *job) noexcept
+{
+	if (!_ok || body == nullptr) return false;
+	if (begin >= end) return true;
+	ForContext context;
+	context.pool = this;
+	context.user = user;
+	context.body = body;
+	context.end = end;
+	context.grain = _grain(begin, end, grain);
+	context.next = begin;
+	return _operation(&context, _for, job);
+}
+
+bool ir::Parallel::parallel_reduce(size_t begin, size_t end, size_t grain, const void *user, Reduce *body, Combine *combine, void *result, size_t size, Job *job) noexcept
+{
+	if (!_ok || body == nullptr || combine == nullptr || result == nullptr) return false;
+	if (begin >= end) return true;
+	ReduceContext context;
+	context.pool = this;
+	context.user = user;
+	context.body = body;
+	context.end = end;
+	context.grain = _grain(begin, end, grain);
+	context.next = begin;
+	context.size = size;
+	context.accumulators = (char*)malloc(_n * size);
+	if (context.accumulators == nullptr) return false;
+	for (uint32 i = 0; i < _n; i++) memcpy(context.accumulators + i * size, result, size);
+	if (!_operation(&context, _reduce, job)) { free(context.accumulators); return false; }
+	for (uint32 i = 0; i < _n; i++) combine(result, context.accumulators + i * size);
+	free(context.accumulators);
+	return true;
+}
+
+struct ir::Parallel::AffinityContext
+{
+	affinity mode;
+	const uint32 *processors;		//sorted by node
+	const uint32 *nodes;			//node of every processor
+	uint32 count;
+	uint32 node_count;
+	std::atomic<bool> failed;
+};
+
+//Sets affinity of calling thread
+bool ir::Parallel::_pin(const uint32 *processors, uint32 count) noexcept
+{
+	#ifdef _WIN32
+		DWORD_PTR mask = 0;
+		for (uint32 i = 0; i < count; i++)
+		{
+			if (processors[i] < 8 * sizeof(DWORD_PTR)) mask |= (DWORD_PTR)1 << processors[i];
+		}
+		return mask != 0 && SetThreadAffinityMask(GetCurrentThread(), mask) != 0;
+	#elif defined(__linux__)
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		for (uint32 i = 0; i < count; i++)
+		{
+			if (processors[i] < CPU_SETSIZE) CPU_SET(processors[i], &set);
+		}
+		return CPU_COUNT(&set) != 0 && pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &set) == 0;
+	#else
+		(void)processors;
+		(void)count;
+		return false;
+	#endif
+}
+
+void ir::Parallel::_affinity_function(const void *user, uint32 id, uint32 n) noexcept
+{
+	if (id == 0) return;
+	AffinityContext *context = (AffinityContext*)user;
+	bool ok;
+	if (context->mode == affinity::none)
+	{
+		ok = _pin(context->processors, context->count);
+	}
+	else if (context->mode == affinity::cores)
+	{
+		ok = _pin(&context->processors[id % context->count], 1);
+	}
+	else
+	{
+		//Processors of one node are consecutive
+		const uint32 node = (uint32)((uint64)id * context->node_count / n);
+		uint32 begin = 0;
+		while (begin < context->count && context->nodes[begin] != node) begin++;
+		uint32 end = begin;
+		while (end < context->count && context->nodes[end] == node) end++;
+		ok = (end > begin) ? _pin(&context->processors[begin], end - begin) : _pin(context->processors, context->count);
+	}
+	if (!ok) context->failed = true;
+}
+
+bool ir::Parallel::set_affinity(affinity mode) noexcept
+{
+	if (!_ok) return false;
+	#ifndef IR_PARALLEL_IMPLEMENTATION
+		//All work is done by calling thread
+		(void)mode;
+		return true;
+	#else
+		const uint32 count = processor_count();
+		const uint32 nodes = node_count();
+		QuietVector<uint32> processors, processor_nodes;
+		if (!processors.reserve(count) || !processor_nodes.reserve(count)) return false;
+		for (uint32 n = 0; n < nodes; n++)
+		{
+			for (uint32 p = 0; p < count; p++)
+			{
+				if (node(p) != n) continue;
+				processors.push_back(p);
+				processor_nodes.push_back(n);
+			}
+		}
+		AffinityContext context;
+		context.mode = mode;
+		context.processors = processors.data();
+		context.nodes = processor_nodes.data();
+		context.count = (uint32)processors.size();
+		context.node_count = nodes;
+		context.failed = context.count == 0;
+		if (context.count == 0 || !_parallel(&context, _affinity_function, nullptr)) return false;
+		return !context.failed;
+	#endif
+}
+
+void ir::Parallel::_scratch_function(const void *user, uint32 id, uint32) noexcept
+{
+	Parallel *pool = (Parallel*)user;
+	#ifdef _WIN32
+		void *block = VirtualAlloc(nullptr, pool->_scratch_size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+	#else
+		void *block = mmap(nullptr, pool->_scratch_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (block == MAP_FAILED) block = nullptr;
+	#endif
+	//First touch places pages on node of the thread
+	if (block != nullptr) memset(block, 0, pool->_scratch_size);
+	pool->_scratch[id] = block;
+}
+
+void ir::Parallel::_free_scratch() noexcept
+{
+	for (size_t i = 0; i < _scratch.size(); i++)
+	{
+		if (_scratch[i] == nullptr) continue;
+		#ifdef _WIN32
+			VirtualFree(_scratch[i], 0, MEM_RELEASE);
+		#else
+			munmap(_scratch[i], _scratch_size);
+		#endif
+	}
+	_scratch.clear();
+	_scratch_size = 0;
+}
+
+bool ir::Parallel::set_scratch(size_t size) noexcept
+{
+	if (!_ok) return false;
+	_free_scratch();
+	if (size == 0) return true;
+	if (!_scratch.resize(_n)) return false;
+	for (uint32 i = 0; i < _n; i++) _scratch[i] = nullptr;
+	_scratch_size = size;
+	if (!_parallel(this, _scratch_function, nullptr)) { _free_scratch(); return false; }
+	for (uint32 i = 0; i < _n; i++)
+	{
+		if (_scratch[i] == nullptr) { _free_scratch(); return false; }
+	}
+	return true;
+}
+
+void *ir::Parallel::scratch(uint32 id) const noexcept
+{
+	return (id < _scratch.size()) ? _scratch[id] : nullptr;
+}
+
+ir::uint32 ir::Parallel::processor_count() noexcept
+{
+	#ifdef _WIN32
+		SYSTEM_INFO info;
+		GetSystemInfo(&info);
+		return info.dwNumberOfProcessors;
+	#else
+		const long count = sysconf(_SC_NPROCESSORS_ONLN);
+		return count > 0 ? (uint32)count : 1;
+	#endif
+}
+
+ir::uint32 ir::Parallel::node_count() noexcept
+{
+	#ifdef _WIN32
+		ULONG highest;
+		return GetNumaHighestNodeNumber(&highest) ? (uint32)highest + 1 : 1;
+	#else
+		uint32 count = 0;
+		char path[64];
+		while (true)
+		{
+			snprintf(path, sizeof(path), "/sys/devices/system/node/node%u", (unsigned int)count);
+			if (access(path, F_OK) != 0) break;
+			count++;
+		}
+		return count > 0 ? count : 1;
+	#endif
+}
+
+ir::uint32 ir::Parallel::node(uint32 processor) noexcept
+{
+	#ifdef _WIN32
+		UCHAR node;
+		return (processor < 256 && GetNumaProcessorNode((UCHAR)processor, &node)) ? node : 0;
+	#else
+		const uint32 count = node_count();
+		char path[64];
+		for (uint32 i = 0; i < count; i++)
+		{
+			snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%u/node%u", (unsigned int)processor, (unsigned int)i);
+			if (access(path, F_OK) == 0) return i;
+		}
+		return 0;
+	#endif
+}
+
+struct ir::Parallel::PipelineContext
+{
+	const Parallel *pool;
+	const void *user;
+	Source *source;
+	Stage *const *stages;
+	uint32 count;
+	QuietAtomicRing<void*> *rings;	//input ring of every stage
+	std::atomic<size_t> pending;	//items produced by source and not passed through last stage yet
+	std::atomic<bool> produced;		//source returned nullptr
+};
+
+//Passes item through stages without rings
+void ir::Parallel::_pipeline_pass(PipelineContext *context, uint32 stage, void *item) noexcept
+{
+	for (uint32 i = stage; i < context->count && item != nullptr && !context->pool->cancelled(); i++) item = context->stages[i](context->user, item);
+	context->pending--;
+}
+
+//Passes batch of items through stage and writes results to next ring
+void ir::Parallel::_pipeline_stage(PipelineContext *context, uint32 stage, void **items, size_t count) noexcept
+{
+	size_t results = 0;
+	for (size_t i = 0; i < count; i++)
+	{
+		void *item = context->pool->cancelled() ? nullptr : context->stages[stage](context->user, items[i]);
+		if (item != nullptr && stage + 1 < context->count) items[results++] = item;
+		else context->pending--;
+	}
+	if (results == 0) return;
+	const size_t written = context->rings[stage + 1].write(results, items);
+	for (size_t i = written; i < results; i++) _pipeline_pass(context, stage + 1, items[i]);
+}
+
+void ir::Parallel::_pipeline_function(const void *user, uint32 id, uint32) noexcept
+{
+	PipelineContext *context = (PipelineContext*)user;
+	void *items[_pipeline_batch];
+	if (id == 0)
+	{
+		//Producing items
+		size_t count = 0;
+		while (true)
+		{
+			void *item = context->pool->cancelled() ? nullptr : context->source(context->user);
+			if (item != nullptr)
+			{
+				context->pending++;
+				items[count++] = item;
+			}
+			if (count > 0 && (item == nullptr || count == _pipeline_batch))
+			{
+				const size_t written = context->rings[0].write(count, items);
+				for (size_t i = written; i < count; i++) _pipeline_pass(context, 0, items[i]);
+				count = 0;
+			}
+			if (item == nullptr) break;
+		}
+		context->produced = true;
+	}
+
+	//Consuming items, later stages first
+	while (true)
+	{
+		bool found = false;
+		for (uint32 i = context->count; i-- > 0;)
+		{
+			const size_t count = context->rings[i].read(_pipeline_batch, items);
+			if (count == 0) continue;
+			const uint64 begin = context->pool->_profiling() ? _now() : 0;
+			_pipeline_stage(context, i, items, count);
+			if (begin != 0) context->pool->_record(_event_chunk, begin, _now());
+			found = true;
+			break;
+		}
+		if (!found)
+		{
+			if (context->produced && context->pending == 0) return;
+			std::this_thread::yield();
+		}
+	}
+}
+
+bool ir::Parallel::pipeline(const void *user, Source *source, Stage *const *stages, uint32 count, size_t capacity, Job *job) noexcept
+{
+	if (!_ok || source == nullptr || stages == nullptr || count == 0 || capacity == 0) return false;
+	for (uint32 i = 0; i < count; i++) if (stages[i] == nullptr) return false;
+	PipelineContext context;
+	context.pool = this;
+	context.user = user;
+	context.source = source;
+	context.stages = stages;
+	context.count = count;
+	context.pending = 0;
+	context.produced = false;
+	context.rings = (QuietAtomicRing<void*>*)malloc(count * sizeof(QuietAtomicRing<void*>));
+	if (context.rings == nullptr) return false;
+	bool ok = true;
+	for (uint32 i = 0; i < count; i++)
+	{
+		new(&context.rings[i]) QuietAtomicRing<void*>();
+		if (!context.rings[i].init(capacity)) ok = false;
+	}
+	if (ok) ok = _operation(&context, _pipeline_function, job);
+	for (uint32 i = 0; i < count; i++) context.rings[i].~QuietAtomicRing<void*>();
+	free(context.rings);
+	return ok;
+}
+
+ir::Parallel::Future::Future() noexcept
+{
+	_state = 0;
+	_lock.clear();
+}
+
+bool ir::Parallel::Future::try_wait() noexcept
+{
+	if (_state == 1) return false;
+	//Finishing thread may still hold the lock
+	_acquire(&_lock);
+	_lock.clear();
+	return true;
+}
+
+void ir::Parallel::Future::wait() noexcept
+{
+	if (_state == 1) _pool->_wait_future(this);
+	_acquire(&_lock);
+	_lock.clear();
+}
+
+bool ir::Parallel::Future::then(Future *next, Task *task, const void *user) noexcept
+{
+	if (_state == 0 || next == nullptr || next == this || next->_state == 1 || task == nullptr) return false;
+	_acquire(&_lock);
+	if (_next != nullptr) { _lock.clear(); return false; }
+	next->_pool = _pool;
+	next->_task = task;
+	next->_user = user;
+	next->_next = nullptr;
+	next->_job._reset();
+	next->_state = 1;
+	const bool finished = _state == 2;
+	if (!finished) _next = next;
+	_lock.clear();
+	if (finished) _pool->_start(next);
+	return true;
+}
+
+void ir::Parallel::Future::cancel() noexcept
+{
+	_job.cancel();
+}
+
+ir::ec ir::Parallel::Future::error() const noexcept
+{
+	return _job.error();
+}
+
+ir::Parallel::Future::~Future() noexcept
+{
+	wait();
+}
+
+//Executes task of future, finishes the future and starts the next one
+void ir::Parallel::_async_function(const void *user) noexcept
+{
+	Future *future = (Future*)user;
+	Job *parent_job = _job;
+	_job = &future->_job;
+	if (!future->_job.cancelled()) future->_task(future->_user);
+	_job = parent_job;
+	Parallel *pool = future->_pool;
+	_acquire(&future->_lock);
+	Future *next = future->_next;
+	future->_next = nullptr;
+	future->_state = 2;
+	future->_lock.clear();
+	//Future may not exist anymore
+	#if defined(IR_PARALLEL_IMPLEMENTATION) && (IR_PARALLEL_IMPLEMENTATION == 'w' || IR_PARALLEL_IMPLEMENTATION == 'p')
+		pool->_wake();
+	#endif
+	if (next != nullptr) pool->_start(next);
+}
+
+void ir::Parallel::_start(Future *future) noexcept
+{
+	if (!_spawn(_async_function, future, nullptr)) _async_function(future);
+}
+
+void ir::Parallel::_wait_future(Future *future) noexcept
+{
+	if (_pool == this)
+	{
+		//Member of pool executes other tasks
+		Record record;
+		while (future->_state == 1)
+		{
+			if (_find(&record)) _execute(record);
+			else std::this_thread::yield();
+		}
+		return;
+	}
+	#if defined(IR_PARALLEL_IMPLEMENTATION) && (IR_PARALLEL_IMPLEMENTATION == 'w' || IR_PARALLEL_IMPLEMENTATION == 'p')
+		if (_n > 1)
+		{
+			//Idle threads execute queued tasks
+			_wait(&future->_state, 2);
+			return;
+		}
+	#endif
+	while (future->_state == 1) sync();
+}
+
+bool ir::Parallel::async(Future *future, Task *task, const void *user) noexcept
+{
+	if (!_ok || future == nullptr || task == nullptr || future->_state == 1) return false;
+	future->_pool = this;
+	future->_task = task;
+	future->_user = user;
+	future->_next = nullptr;
+	future->_job._reset();
+	future->_state = 1;
+	if (!_spawn(_async_function, future, nullptr))
+	{
+		future->_state = 0;
+		return false;
+	}
+	return true;
+}
+
+ir::uint64 ir::Parallel::_now() noexcept
+{
+	return (uint64)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool ir::Parallel::_profiling() const noexcept
+{
+	return _statistics.load(std::memory_order_relaxed) || _tracing.load(std::memory_order_relaxed);
+}
+
+//Adds time from begin to end to counters of current thread
+void ir::Parallel::_record(uint32 kind, uint64 begin, uint64 end) const noexcept
+{
+	if (_pool != this) return;
+	Counters *counters = &_counters[_id];
+	if (_statistics.load(std::memory_order_relaxed))
+	{
+		const uint64 time = end - begin;
+		if (kind == _event_spin) counters->spin.fetch_add(time, std::memory_order_relaxed);
+		else if (kind == _event_parked) counters->parked.fetch_add(time, std::memory_order_relaxed);
+		else counters->busy.fetch_add(time, std::memory_order_relaxed);
+		if (kind == _event_task) counters->tasks.fetch_add(1, std::memory_order_relaxed);
+		else if (kind == _event_chunk) counters->chunks.fetch_add(1, std::memory_order_relaxed);
+	}
+	if (_tracing.load(std::memory_order_relaxed))
+	{
+		if (begin < _epoch) begin = _epoch;
+		if (end < begin) end = begin;
+		Event event;
+		event.kind = kind;
+		event.begin = begin - _epoch;
+		event.end = end - _epoch;
+		counters->events.push_back(event);
+	}
+}
+
+bool ir::Parallel::set_statistics(bool enable) noexcept
+{
+	if (!_ok) return false;
+	for (uint32 i = 0; i < _n; i++)
+	{
+		_counters[i].tasks = 0;
+		_counters[i].chunks = 0;
+		_counters[i].steals = 0;
+		_counters[i].busy = 0;
+		_counters[i].spin = 0;
+		_counters[i].parked = 0;
+	}
+	_statistics = enable;
+	return true;
+}
+
+bool ir::Parallel::set_trace(bool enable) noexcept
+{
+	if (!_ok) return false;
+	for (uint32 i = 0; i < _n; i++) _counters[i].events.clear();
+	_epoch = _now();
+	_tracing = enable;
+	return true;
+}
+
+bool ir::Parallel::statistics(uint32 id, Statistics *statistics) const noexcept
+{
+	if (!_ok || id >= _n || statistics == nullptr) return false;
+	const Counters *counters = &_counters[id];
+	statistics->tasks = counters->tasks.load(std::memory_order_relaxed);
+	statistics->chunks = counters->chunks.load(std::memory_order_relaxed);
+	statistics->steals = counters->steals.load(std::memory_order_relaxed);
+	statistics->busy = counters->busy.load(std::memory_order_relaxed);
+	statistics->spin = counters->spin.load(std::memory_order_relaxed);
+	statistics->parked = counters->parked.load(std::memory_order_relaxed);
+	const int64 depth = _deques[id].bottom - _deques[id].top;
+	statistics->deque = depth > 0 ? (uint64)depth : 0;
+	return true;
+}
+
+size_t ir::Parallel::queued() const noexcept
+{
+	return _queued;
+}
+
+ir::ec ir::Parallel::save_trace(const schar *path) const noexcept
+{
+	if (!_ok) return ec::object_not_inited;
+	if (path == nullptr) return ec::null;
+	#ifdef _WIN32
+		FILE *file = _wfsopen(path, L"wb", _SH_DENYNO);
+	#else
+		FILE *file = fopen(path, "wb");
+	#endif
+	if (file == nullptr) return ec::create_file;
+	static const char *const names[] = { "function", "task", "chunk", "spin", "parked" };
+	bool ok = fprintf(file, "{\"traceEvents\":[") > 0;
+	bool first = true;
+	for (uint32 i = 0; i < _n && ok; i++)
+	{
+		const QuietVector<Event> &events = _counters[i].events;
+		for (size_t j = 0; j < events.size() && ok; j++)
+		{
+			//Chrome trace format expects microseconds
+			ok = fprintf(file, "%s\n{\"name\":\"%s\",\"cat\":\"parallel\",\"ph\":\"X\",\"pid\":0,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+				first ? "" : ",", names[events[j].kind], (unsigned int)i,
+				(double)events[j].begin / 1000.0, (double)(events[j].end - events[j].begin) / 1000.0) > 0;
+			first = false;
+		}
+	}
+	if (ok) ok = fprintf(file, "\n]}\n") > 0;
+	if (fclose(file) != 0) ok = false;
+	return ok ? ec::ok : ec::write_file;
+}
+
+bool ir::Parallel::ok() const noexcept
 {
 	return _ok;
-}
\ No newline at end of file
+}
+
+ir::uint32 ir::Parallel::n() const noexcept
+{
+	return _ok ? _n : 0;
+}
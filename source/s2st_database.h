@@ -10,6 +10,7 @@
 
 #include "../include/ir/resource.h"
 #include "../include/ir/fnv1a.h"
+#include "../include/ir/parallel.h"
 #include <stdlib.h>
 #include <string.h>
 #ifdef _WIN32
@@ -21,6 +22,7 @@ ir::S2STDatabase::MetaCell::MetaCell() noexcept
 	offset = 0;
 	keysize = 0;
 	datasize = 0;
+	datacapacity = 0;
 	deleted = 0;
 }
 
@@ -34,16 +36,21 @@ ir::ec ir::S2STDatabase::_read(void *buffer, uint32 offset, uint32 size) noexcep
 {
 	if (offset + size > _file.size) return ec::read_file;
 
-	if (_file.hold)
+	if (size == 0)
+	{
+		//Empty values may lie at the very end of main file and are never indexed
+	}
+	else if (_file.hold)
 	{
 		memcpy(buffer, &_file.ram[offset], size);
 	}
 	else
 	{
-		if (offset != _file.pointer)
+		if (offset != _file.pointer || _file.written)
 		{
 			if (fseek(_file.file, offset, SEEK_SET) != 0) return ec::seek_file;
 			_file.pointer = offset;
+			_file.written = false;
 		}
 		if (fread(buffer, size, 1, _file.file) == 0) return ec::read_file;
 		_file.pointer += size;
@@ -67,12 +74,13 @@ ir::ec ir::S2STDatabase::_write(const void *buffer, uint32 offset, uint32 size)
 			_file.changed = true;
 		}
 	}
-	else
+	else if (size > 0)
 	{
-		if (offset != _file.pointer)
+		if (offset != _file.pointer || !_file.written)
 		{
 			if (fseek(_file.file, offset, SEEK_SET) != 0) return ec::seek_file;
 			_file.pointer = offset;
+			_file.written = true;
 		}
 		if (fwrite(buffer, size, 1, _file.file) == 0) return ec::read_file;
 		_file.pointer += size;
@@ -81,16 +89,54 @@ ir::ec ir::S2STDatabase::_write(const void *buffer, uint32 offset, uint32 size)
 	return ec::ok;
 }
 
+//same as in N2ST
+ir::ec ir::S2STDatabase::_copy(uint32 source, uint32 destination, uint32 size) noexcept
+{
+	char buffer[4096];
+	for (uint32 i = 0; i < size; i += sizeof(buffer))
+	{
+		uint32 part = (size - i < sizeof(buffer)) ? (size - i) : sizeof(buffer);
+		ec code = _read(buffer, source + i, part);
+		if (code != ec::ok) return code;
+		code = _write(buffer, destination + i, part);
+		if (code != ec::ok) return code;
+	}
+	return ec::ok;
+}
+
+//same as in N2ST
+ir::ec ir::S2STDatabase::_reserve(uint32 end) noexcept
+{
+	if (end <= _file.size) return ec::ok;
+	char zero = 0;
+	return _write(&zero, end - 1, 1);
+}
+
 //same as in N2ST
 ir::ec ir::S2STDatabase::_readpointer(void **p, uint32 offset, uint32 size) noexcept
 {
 	if (offset + size > _file.size) return ec::read_file;
 
-	if (_file.hold)
+	if (size == 0)
+	{
+		static const char empty = '\0';
+		const void *pointer = &empty;
+		memcpy(p, &pointer, sizeof(void*));
+	}
+	else if (_file.hold)
 	{
 		void *pointer = &_file.ram[offset];
 		memcpy(p, &pointer, sizeof(void*));
 	}
+	else if (!_writeaccess && _shared.header != nullptr)
+	{
+		//Reader gets own copy, so writer can not change data after it was checked to be stable
+		if (!_readbuffer.resize(size)) return ec::alloc;
+		ec code = _read(_readbuffer.data(), offset, size);
+		if (code != ec::ok) return code;
+		void *pointer = _readbuffer.data();
+		memcpy(p, &pointer, sizeof(void*));
+	}
 	else
 	{
 		//Actually openmap might change file pointer. It never causes a problem though
@@ -114,12 +160,14 @@ ir::ec ir::S2STDatabase::_metaread(MetaCell *cell, uint32 index) noexcept
 	}
 	else
 	{
-		if (index != _meta.pointer)
+		if (index != _meta.pointer || _meta.written)
 		{
-			if (fseek(_meta.file, sizeof(MetaHeader) + index * sizeof(MetaCell), SEEK_SET) != 0) return ec::seek_file;
+			if (fseek(_meta.file, sizeof(MetaHeader) + index * _metacellsize(), SEEK_SET) != 0) return ec::seek_file;
 			_meta.pointer = index;
+			_meta.written = false;
 		}
-		if (fread(cell, sizeof(MetaCell), 1, _meta.file) == 0) return ec::read_file;
+		if (fread(cell, _metacellsize(), 1, _meta.file) == 0) return ec::read_file;
+		if (_legacy) cell->datacapacity = cell->datasize;
 		_meta.pointer++;
 	}
 	return ec::ok;
@@ -136,10 +184,11 @@ ir::ec ir::S2STDatabase::_metawrite(MetaCell cell, uint32 index) noexcept
 	}
 	else
 	{
-		if (index != _meta.pointer)
+		if (index != _meta.pointer || !_meta.written)
 		{
 			if (fseek(_meta.file, sizeof(MetaHeader) + index * sizeof(MetaCell), SEEK_SET) != 0) return ec::seek_file;
 			_meta.pointer = index;
+			_meta.written = true;
 		}
 		if (fwrite(&cell, sizeof(MetaCell), 1, _meta.file) == 0) return ec::read_file;
 		_meta.pointer++;
@@ -147,6 +196,17 @@ ir::ec ir::S2STDatabase::_metawrite(MetaCell cell, uint32 index) noexcept
 	return ec::ok;
 }
 
+ir::uint32 ir::S2STDatabase::_metaheadersize() const noexcept
+{
+	return sizeof(MetaHeader);
+}
+
+//Capacity is the last field of cell, version 1 cells are the same without it
+ir::uint32 ir::S2STDatabase::_metacellsize() const noexcept
+{
+	return sizeof(MetaCell) - (_legacy ? sizeof(uint32) : 0);
+}
+
 //index gets an offset in metafile where to write offset
 //dataoffset is data offset read from index or 0/1 if not exists/deleted
 ir::ec ir::S2STDatabase::_find(Block key, uint32 *index, MetaCell *cell) noexcept
@@ -198,6 +258,8 @@ ir::ec ir::S2STDatabase::_find(Block key, uint32 *index, MetaCell *cell) noexcep
 //simmilar to N2ST, can be templated
 ir::ec ir::S2STDatabase::_rehash(uint32 newtablesize) noexcept
 {
+	if (_parallel_possible()) return _parallel_rehash(newtablesize);
+
 	QuietVector<MetaCell> new_meta;
 	if (!new_meta.resize(newtablesize)) return ec::alloc;
 
@@ -231,19 +293,227 @@ ir::ec ir::S2STDatabase::_rehash(uint32 newtablesize) noexcept
 	if (_meta.hold)
 	{
 		_meta.ram.assign(new_meta);
+		_meta.changed = true;
 	}
 	else
 	{
 		if (fseek(_meta.file, sizeof(MetaHeader), SEEK_SET) != 0) return ec::seek_file;
 		if (fwrite(&new_meta[0], sizeof(MetaCell), newtablesize, _meta.file) < newtablesize) return ec::write_file;
 		_meta.pointer = newtablesize;
+		_meta.written = true;
 	}
 	_meta.size = newtablesize;
 	_meta.delcount = 0;
 	return ec::ok;
 }
 
-//File part is simmilar as in N2ST
+struct ir::S2STDatabase::RehashContext
+{
+	const MetaCell *oldcells;
+	uint32 oldsize;
+	const char *file;
+	uint32 *homes;						//home slot in new table for each old cell, newsize if cell is not used
+	MetaCell *newcells;
+	uint32 newsize;
+	uint32 parts;						//number of parts of old table and of new table
+	uint32 *counts;						//cells of old part going to new part, parts x parts, become write positions in order
+	uint32 *starts;						//first position of new part in order, parts + 1
+	uint32 *order;						//used old cells sorted by new part, deferred cells are written back to the beginning of part
+	uint32 *deferred;					//number of cells that did not fit into new part, for each part
+};
+
+struct ir::S2STDatabase::OptimizeContext
+{
+	const MetaCell *oldcells;
+	const char *oldfile;
+	const uint32 *newoffsets;			//zero if cell is not used
+	MetaCell *newcells;
+	char *newfile;
+};
+
+//Part of new table that contains home slot, part p begins at ceil(newsize * p / parts)
+ir::uint32 ir::S2STDatabase::_parallel_part(const RehashContext *context, uint32 home) noexcept
+{
+	return (uint32)((uint64)home * context->parts / context->newsize);
+}
+
+//Computes home slots of parts of old table and counts cells going to every part of new table
+void ir::S2STDatabase::_parallel_hash(const void *user, uint32, size_t begin, size_t end) noexcept
+{
+	const RehashContext *context = (const RehashContext*)user;
+	for (size_t part = begin; part < end; part++)
+	{
+		uint32 *counts = context->counts + part * context->parts;
+		for (uint32 i = (uint32)((uint64)context->oldsize * part / context->parts); i < (uint32)((uint64)context->oldsize * (part + 1) / context->parts); i++)
+		{
+			const MetaCell &cell = context->oldcells[i];
+			if (cell.offset != 0 && cell.deleted == 0)
+			{
+				context->homes[i] = fnv1a(Block(context->file + cell.offset, cell.keysize)) & (context->newsize - 1);
+				counts[_parallel_part(context, context->homes[i])]++;
+			}
+			else context->homes[i] = context->newsize;
+		}
+	}
+}
+
+//Writes used cells of parts of old table to order
+void ir::S2STDatabase::_parallel_bucket(const void *user, uint32, size_t begin, size_t end) noexcept
+{
+	const RehashContext *context = (const RehashContext*)user;
+	for (size_t part = begin; part < end; part++)
+	{
+		uint32 *positions = context->counts + part * context->parts;
+		for (uint32 i = (uint32)((uint64)context->oldsize * part / context->parts); i < (uint32)((uint64)context->oldsize * (part + 1) / context->parts); i++)
+		{
+			if (context->homes[i] < context->newsize) context->order[positions[_parallel_part(context, context->homes[i])]++] = i;
+		}
+	}
+}
+
+//Places cells with home slots in parts of new table, the cells that would leave the part are deferred
+void ir::S2STDatabase::_parallel_place(const void *user, uint32, size_t begin, size_t end) noexcept
+{
+	const RehashContext *context = (const RehashContext*)user;
+	for (size_t part = begin; part < end; part++)
+	{
+		const uint32 partend = (uint32)(((uint64)context->newsize * (part + 1) + context->parts - 1) / context->parts);
+		uint32 deferred = 0;
+		for (uint32 j = context->starts[part]; j < context->starts[part + 1]; j++)
+		{
+			const uint32 i = context->order[j];
+			uint32 searchindex = context->homes[i];
+			while (searchindex < partend && context->newcells[searchindex].offset != 0) searchindex++;
+			if (searchindex < partend) context->newcells[searchindex] = context->oldcells[i];
+			else context->order[context->starts[part] + deferred++] = i;
+		}
+		context->deferred[part] = deferred;
+	}
+}
+
+//Copies keys and values of one chunk of table to their new places
+void ir::S2STDatabase::_parallel_copy(const void *user, uint32, size_t begin, size_t end) noexcept
+{
+	const OptimizeContext *context = (const OptimizeContext*)user;
+	for (size_t i = begin; i < end; i++)
+	{
+		if (context->newoffsets[i] == 0) continue;
+		MetaCell cell = context->oldcells[i];
+		memcpy(context->newfile + context->newoffsets[i], context->oldfile + cell.offset, _align(cell.keysize) + cell.datasize);
+		cell.offset = context->newoffsets[i];
+		cell.datacapacity = cell.datasize;
+		context->newcells[i] = cell;
+	}
+}
+
+bool ir::S2STDatabase::_parallel_possible() const noexcept
+{
+	return _file.hold && _meta.hold && _meta.size >= _parallel_threshold && _parallel != nullptr && _parallel->ok() && _parallel->n() > 1;
+}
+
+//Same as _rehash, but old table and new table are split into parts. Cells are sorted by part of new table, so every worker hashes, sorts and places cells of its own parts only
+ir::ec ir::S2STDatabase::_parallel_rehash(uint32 newtablesize) noexcept
+{
+	const uint32 parts = _parallel->n();
+	QuietVector<MetaCell> new_meta;
+	QuietVector<uint32> homes, counts, starts, order, deferred;
+	if (!new_meta.resize(newtablesize) || !homes.resize(_meta.size) || !counts.resize(parts * parts)
+	|| !starts.resize(parts + 1) || !order.resize(_meta.size) || !deferred.resize(parts)) return ec::alloc;
+
+	RehashContext context;
+	context.oldcells = _meta.ram.data();
+	context.oldsize = _meta.size;
+	context.file = _file.ram.data();
+	context.homes = homes.data();
+	context.newcells = new_meta.data();
+	context.newsize = newtablesize;
+	context.parts = parts;
+	context.counts = counts.data();
+	context.starts = starts.data();
+	context.order = order.data();
+	context.deferred = deferred.data();
+	if (!_parallel->parallel_for(0, parts, 1, &context, _parallel_hash)) return ec::other;
+
+	//Counts become positions in order, cells of one new part are ordered by old part
+	uint32 position = 0;
+	for (uint32 p = 0; p < parts; p++)
+	{
+		starts[p] = position;
+		for (uint32 w = 0; w < parts; w++)
+		{
+			const uint32 count = counts[w * parts + p];
+			counts[w * parts + p] = position;
+			position += count;
+		}
+	}
+	starts[parts] = position;
+	if (!_parallel->parallel_for(0, parts, 1, &context, _parallel_bucket)
+	|| !_parallel->parallel_for(0, parts, 1, &context, _parallel_place)) return ec::other;
+
+	//Placing deferred cells
+	for (uint32 p = 0; p < parts; p++)
+	{
+		for (uint32 j = starts[p]; j < starts[p] + deferred[p]; j++)
+		{
+			uint32 searchindex = homes[order[j]];
+			while (new_meta[searchindex].offset != 0) searchindex = (searchindex + 1) & (newtablesize - 1);
+			new_meta[searchindex] = _meta.ram[order[j]];
+		}
+	}
+
+	_meta.ram.assign(new_meta);
+	_meta.changed = true;
+	_meta.size = newtablesize;
+	_meta.delcount = 0;
+	return ec::ok;
+}
+
+//Builds compacted database in beta, which is kept in RAM. Offsets are calculated sequentially, copying is partitioned between workers
+ir::ec ir::S2STDatabase::_parallel_optimize(S2STDatabase *beta) noexcept
+{
+	QuietVector<uint32> newoffsets;
+	if (!newoffsets.resize(_meta.size)) return ec::alloc;
+	uint32 end = beta->_file.size;
+	uint32 count = 0;
+	uint32 used = 0;
+	for (uint32 i = 0; i < _meta.size; i++)
+	{
+		const MetaCell &cell = _meta.ram[i];
+		if (cell.offset == 0 || cell.deleted > 0) continue;
+		newoffsets[i] = _align(end);
+		end = newoffsets[i] + _align(cell.keysize) + cell.datasize;
+		count++;
+		used += cell.keysize + cell.datasize;
+	}
+
+	if (!beta->_file.ram.resize(end) || !beta->_meta.ram.resize(_meta.size)) return ec::alloc;
+	beta->_file.size = end;
+	beta->_file.changed = true;
+	beta->_meta.size = _meta.size;
+
+	OptimizeContext context;
+	context.oldcells = _meta.ram.data();
+	context.oldfile = _file.ram.data();
+	context.newoffsets = newoffsets.data();
+	context.newcells = beta->_meta.ram.data();
+	context.newfile = beta->_file.ram.data();
+	if (!_parallel->parallel_for(0, _meta.size, 0, &context, _parallel_copy)) return ec::other;
+
+	//Table of beta has copied cells on old places, rehashing makes it valid
+	beta->_meta.count = count;
+	beta->_meta.delcount = 0;
+	beta->_file.used = used;
+	uint32 newtablesize = 1;
+	while (2 * count > newtablesize) newtablesize *= 2;
+	return beta->_rehash(newtablesize);
+}
+
+//Tells if writer has modified database since last refresh, so data that was just read may be inconsistent
+bool ir::S2STDatabase::_unstable() const noexcept
+{
+	return !_writeaccess && _shared_changed(&_shared);
+}
+
 ir::ec ir::S2STDatabase::_check() noexcept
 {
 	//FILE
@@ -263,6 +533,7 @@ ir::ec ir::S2STDatabase::_check() noexcept
 	if (fseek(_file.file, 0, SEEK_END) != 0) return ec::seek_file;
 	_file.size = ftell(_file.file);
 	_file.pointer = _file.size;
+	_file.written = false;
 
 	//META
 	_path[_path.size() - 2] = _beta ? 'd' : 'b';
@@ -277,18 +548,20 @@ ir::ec ir::S2STDatabase::_check() noexcept
 	if (fseek(_meta.file, 0, SEEK_SET) != 0) return ec::seek_file;
 	if(fread(&metaheader, sizeof(MetaHeader), 1, _meta.file) == 0
 	|| memcmp(metaheader.signature, metasample.signature, 7) != 0
-	|| metaheader.version != metaheader.version) return ec::invalid_signature;
+	|| (metaheader.version != metasample.version && metaheader.version != 1)) return ec::invalid_signature;
+	_legacy = metaheader.version == 1;
 
 	_file.used = metaheader.used;
 	if (_file.used > _file.size) return ec::invalid_signature;
 
 	if (fseek(_meta.file, 0, SEEK_END) != 0) return ec::seek_file;
 	_meta.size = ftell(_meta.file) - sizeof(MetaHeader);
-	if (_meta.size < sizeof(MetaCell)) return ec::invalid_signature;
-	if ((_meta.size % sizeof(MetaCell)) != 0) return ec::invalid_signature;
-	_meta.size /= sizeof(MetaCell);
+	if (_meta.size < _metacellsize()) return ec::invalid_signature;
+	if ((_meta.size % _metacellsize()) != 0) return ec::invalid_signature;
+	_meta.size /= _metacellsize();
 	if ((_meta.size & (_meta.size - 1)) != 0) return ec::invalid_signature;
 	_meta.pointer = _meta.size;
+	_meta.written = false;
 
 	_meta.count = metaheader.count;
 	_meta.delcount = metaheader.delcount;
@@ -302,7 +575,7 @@ ir::ec ir::S2STDatabase::_reopen_write(bool createnew) noexcept
 {
 	//FILE
 	_path[_path.size() - 2] = _beta ? 'c' : 'a';
-	if (_file.file != nullptr && createnew)
+	if (_file.file != nullptr)
 	{
 		fclose(_file.file);
 		_file.file = nullptr;
@@ -318,12 +591,13 @@ ir::ec ir::S2STDatabase::_reopen_write(bool createnew) noexcept
 		FileHeader header;
 		if (fwrite(&header, sizeof(FileHeader), 1, _file.file) == 0) return ec::write_file;
 		_file.pointer = sizeof(FileHeader);
+		_file.written = true;
 		_file.size = sizeof(FileHeader);
 	}
 
 	//META
 	_path[_path.size() - 2] = _beta ? 'd' : 'b';
-	if (_meta.file != nullptr && createnew)
+	if (_meta.file != nullptr)
 	{
 		fclose(_meta.file);
 		_meta.file = nullptr;
@@ -341,6 +615,7 @@ ir::ec ir::S2STDatabase::_reopen_write(bool createnew) noexcept
 		MetaCell nullcell;
 		if (fwrite(&nullcell, sizeof(MetaCell), 1, _meta.file) == 0) return ec::write_file;
 		_meta.pointer = 1;
+		_meta.written = true;
 		_meta.size = 1;
 	}
 
@@ -362,12 +637,23 @@ ir::ec ir::S2STDatabase::_init(const schar *filepath, create_mode mode, bool opp
 	_path[pathlen] = '~';
 	_path[pathlen + 1] = 'c';
 	_path[pathlen + 2] = '\0';
+	if (!opposite)
+	{
+		ec code = _shared_open(&_path, mode, &_shared);
+		if (code != ec::ok) return code;
+		_path[pathlen + 1] = 'c';
+	}
 	#ifdef _WIN32
 		_beta = (_waccess(_path.data(), 0) == 0);
 	#else
 		_beta = (access(_path.data(), 0) == 0);
 	#endif
 	if (opposite) _beta = !_beta;
+	if (mode == create_mode::read && _shared.header != nullptr && _shared.header->filesize != 0)
+	{
+		_shared_wait(&_shared);
+		_beta = _shared.header->beta != 0;
+	}
 
 	if (mode == create_mode::neww)
 	{
@@ -386,6 +672,15 @@ ir::ec ir::S2STDatabase::_init(const schar *filepath, create_mode mode, bool opp
 	}
 
 	_ok = true;
+	if (mode == create_mode::read) return _refresh(this, true);
+	if (_legacy)
+	{
+		//Writer converts meta file of version 1 before anything is written in old format
+		ec code = optimize();
+		if (code != ec::ok) return code;
+	}
+	_publish_all(this);
+	_shared_allow_readers(&_shared);
 	return ec::ok;
 }
 
@@ -421,11 +716,14 @@ bool ir::S2STDatabase::ok() const noexcept
 ir::ec ir::S2STDatabase::probe(Block key) noexcept
 {
 	if (!_ok) return ec::object_not_inited;
+	ec code = _refresh(this, false);
+	if (code != ec::ok) return code;
 	
 	//Find key
 	uint32 index = 0;
 	MetaCell cell;
-	ec code = _find(key, &index, &cell);
+	code = _find(key, &index, &cell);
+	if (_unstable()) return probe(key);
 	if (code != ec::ok) return code;
 	if (cell.offset == 0 || cell.deleted > 0) return ec::key_not_exists;
 
@@ -436,18 +734,23 @@ ir::ec ir::S2STDatabase::read(Block key, Block *data) noexcept
 {
 	if (!_ok) return ec::object_not_inited;
 	if (data == nullptr) return ec::null;
+	ec code = _refresh(this, false);
+	if (code != ec::ok) return code;
 
 	//Find key
 	uint32 index = 0;
 	MetaCell cell;
-	ec code = _find(key, &index, &cell);
-	if (code != ec::ok) return code;
+	code = _find(key, &index, &cell);
+	if (code != ec::ok) return _unstable() ? read(key, data) : code;
 	if (cell.offset == 0 || cell.deleted > 0) return ec::key_not_exists;
 
 	//Read data
 	void *readdata = nullptr;
 	uint32 alignoffset = _align(cell.offset + cell.keysize);
 	code = _readpointer(&readdata, alignoffset, cell.datasize);
+	if (_unstable()) return read(key, data);
+	if (code != ec::ok) return code;
+	if (_logging && !_file.hold) _log_touch(&_log, cell.offset, alignoffset + cell.datasize - cell.offset);
 	
 	*data = Block(readdata, cell.datasize);
 	return ec::ok;
@@ -457,11 +760,13 @@ ir::ec ir::S2STDatabase::read_direct(uint32 index, Block *key, Block *data) noex
 {
 	if (!_ok) return ec::object_not_inited;
 	if (key == nullptr && data == nullptr) return ec::null;
+	ec code = _refresh(this, false);
+	if (code != ec::ok) return code;
 	if (index >= _meta.size) return ec::key_not_exists;
 
 	//Find dataoffset
 	MetaCell cell;
-	ec code = _metaread(&cell, index);
+	code = _metaread(&cell, index);
 	if (code != ec::ok) return code;
 	if (cell.offset == 0 || cell.deleted > 0) return ec::key_not_exists;
 
@@ -470,7 +775,9 @@ ir::ec ir::S2STDatabase::read_direct(uint32 index, Block *key, Block *data) noex
 		//Read only key
 		void *readkey = nullptr;
 		code = _readpointer(&readkey, cell.offset, cell.keysize);
+		if (_unstable()) return read_direct(index, key, data);
 		if (code != ec::ok) return code;
+		if (_logging && !_file.hold) _log_touch(&_log, cell.offset, cell.keysize);
 		*key = Block(readkey, cell.keysize);
 		return ec::ok;
 	}
@@ -480,14 +787,18 @@ ir::ec ir::S2STDatabase::read_direct(uint32 index, Block *key, Block *data) noex
 		void *readdata = nullptr;
 		uint32 alignoffset = _align(cell.offset + cell.keysize);
 		code = _readpointer(&readdata, alignoffset, cell.datasize);
+		if (_unstable()) return read_direct(index, key, data);
 		if (code != ec::ok) return code;
+		if (_logging && !_file.hold) _log_touch(&_log, alignoffset, cell.datasize);
 		*data = Block(readdata, cell.datasize);
 	}
 	else
 	{
 		void *readkeydata = nullptr;
 		code = _readpointer(&readkeydata, cell.offset, _align(cell.keysize) + cell.datasize);
+		if (_unstable()) return read_direct(index, key, data);
 		if (code != ec::ok) return code;
+		if (_logging && !_file.hold) _log_touch(&_log, cell.offset, _align(cell.keysize) + cell.datasize);
 		*key = Block(readkeydata, cell.keysize);
 		*data = Block((char*)readkeydata + _align(cell.keysize), cell.datasize);
 	}
@@ -499,6 +810,7 @@ ir::ec ir::S2STDatabase::insert(Block key, Block data, insert_mode mode) noexcep
 {
 	if (!_ok) return ec::object_not_inited;
 	if (!_writeaccess) return ec::write_file;
+	Modification modification(this, !_file.hold && !_meta.hold);
 
 	//Find cell
 	MetaCell cell;
@@ -511,9 +823,9 @@ ir::ec ir::S2STDatabase::insert(Block key, Block data, insert_mode mode) noexcep
 	if (mode == insert_mode::existing && !found) return ec::key_not_exists;
 	else if (mode == insert_mode::not_existing && found) return ec::key_already_exists;
 	
-	//If exists or deleted and size is sufficient
+	//If exists or deleted and capacity is sufficient
 	uint32 oldsize = cell.datasize;
-	if (cell.offset != 0 && cell.datasize >= data.size())
+	if (cell.offset != 0 && cell.datacapacity >= data.size())
 	{
 		//If something need to be changed
 		if (cell.datasize != data.size() || cell.deleted > 0)
@@ -527,6 +839,7 @@ ir::ec ir::S2STDatabase::insert(Block key, Block data, insert_mode mode) noexcep
 	else
 	{
 		cell.datasize = (uint32)data.size();
+		cell.datacapacity = (uint32)data.size();
 		cell.keysize = (uint32)key.size();
 		cell.deleted = 0;
 		cell.offset = _align(_file.size);
@@ -535,7 +848,10 @@ ir::ec ir::S2STDatabase::insert(Block key, Block data, insert_mode mode) noexcep
 		code = _write(key.data(), cell.offset, (uint32)key.size());
 		if (code != ec::ok) return code;
 	}
-	code = _write(data.data(), _align(cell.offset + cell.keysize), (uint32)data.size());
+	uint32 alignoffset = _align(cell.offset + cell.keysize);
+	code = _write(data.data(), alignoffset, (uint32)data.size());
+	if (code != ec::ok) return code;
+	code = _reserve(alignoffset + cell.datacapacity);	//empty value still needs main file to reach its offset
 	if (code != ec::ok) return code;
 
 	if (found)
@@ -552,10 +868,125 @@ ir::ec ir::S2STDatabase::insert(Block key, Block data, insert_mode mode) noexcep
 	return ec::ok;
 }
 
+ir::ec ir::S2STDatabase::read_range(Block key, uint32 offset, uint32 size, Block *data) noexcept
+{
+	if (!_ok) return ec::object_not_inited;
+	if (data == nullptr) return ec::null;
+	ec code = _refresh(this, false);
+	if (code != ec::ok) return code;
+
+	//Find key
+	uint32 index = 0;
+	MetaCell cell;
+	code = _find(key, &index, &cell);
+	if (code != ec::ok) return _unstable() ? read_range(key, offset, size, data) : code;
+	if (cell.offset == 0 || cell.deleted > 0) return ec::key_not_exists;
+	if (offset > cell.datasize || size > cell.datasize - offset) return ec::invalid_input;
+
+	//Read data
+	void *readdata = nullptr;
+	uint32 alignoffset = _align(cell.offset + cell.keysize);
+	code = _readpointer(&readdata, alignoffset + offset, size);
+	if (_unstable()) return read_range(key, offset, size, data);
+	if (code != ec::ok) return code;
+	if (_logging && !_file.hold) _log_touch(&_log, alignoffset + offset, size);
+
+	*data = Block(readdata, size);
+	return ec::ok;
+}
+
+ir::ec ir::S2STDatabase::write_range(Block key, uint32 offset, Block data) noexcept
+{
+	if (!_ok) return ec::object_not_inited;
+	if (!_writeaccess) return ec::write_file;
+	Modification modification(this, !_file.hold && !_meta.hold);
+
+	//Find key
+	uint32 index = 0;
+	MetaCell cell;
+	ec code = _find(key, &index, &cell);
+	if (code != ec::ok) return code;
+	if (cell.offset == 0 || cell.deleted > 0) return ec::key_not_exists;
+	if (offset > cell.datasize || data.size() > cell.datasize - offset) return ec::invalid_input;
+
+	uint32 alignoffset = _align(cell.offset + cell.keysize);
+	return _write(data.data(), alignoffset + offset, (uint32)data.size());
+}
+
+ir::ec ir::S2STDatabase::append(Block key, Block data, uint32 reserve) noexcept
+{
+	if (!_ok) return ec::object_not_inited;
+	if (!_writeaccess) return ec::write_file;
+	Modification modification(this, !_file.hold && !_meta.hold);
+
+	//Find cell
+	MetaCell cell;
+	uint32 index = 0;
+	ec code = _find(key, &index, &cell);
+	if (code != ec::ok) return code;
+
+	bool found = cell.offset != 0 && cell.deleted == 0;
+	bool deleted = cell.offset != 0 && cell.deleted > 0;
+	uint32 oldsize = found ? cell.datasize : 0;
+	if ((uint64)oldsize + data.size() + reserve > 0xFFFFFFFF) return ec::invalid_input;
+	uint32 newsize = oldsize + (uint32)data.size();
+
+	if (cell.offset != 0 && cell.datacapacity >= newsize)
+	{
+		//Value has enough space
+	}
+	else if (cell.offset != 0 && _align(cell.offset + cell.keysize) + cell.datacapacity >= _file.size)
+	{
+		//Value is last in main file and can be grown
+		cell.datacapacity = newsize + reserve;
+	}
+	else
+	{
+		//Key and value need to be moved
+		uint32 newoffset = _align(_file.size);
+		if (cell.offset != 0)
+		{
+			code = _copy(cell.offset, newoffset, _align(cell.keysize) + oldsize);
+			if (code != ec::ok) return code;
+		}
+		else
+		{
+			cell.keysize = (uint32)key.size();
+			code = _write(key.data(), newoffset, (uint32)key.size());
+			if (code != ec::ok) return code;
+		}
+		cell.offset = newoffset;
+		cell.datacapacity = newsize + reserve;
+	}
+	cell.datasize = newsize;
+	cell.deleted = 0;
+	code = _metawrite(cell, index);
+	if (code != ec::ok) return code;
+	uint32 alignoffset = _align(cell.offset + cell.keysize);
+	code = _write(data.data(), alignoffset + oldsize, (uint32)data.size());
+	if (code != ec::ok) return code;
+	code = _reserve(alignoffset + cell.datacapacity);
+	if (code != ec::ok) return code;
+
+	if (found)
+	{
+		_file.used += (uint32)data.size();
+	}
+	else
+	{
+		if (deleted) _meta.delcount--;
+		_file.used += (uint32)(data.size() + key.size());
+		_meta.count++;
+	}
+	if (2 * (_meta.count + _meta.delcount) > _meta.size) return _rehash(2 * _meta.size);
+	return ec::ok;
+}
+
 ir::ec ir::S2STDatabase::delet(Block key, delete_mode mode) noexcept
 {
 	if (!_ok) return ec::object_not_inited;
 	if (!_writeaccess) return ec::write_file;
+	Modification modification(this, !_file.hold && !_meta.hold);
 
 	//Find cell
 	MetaCell cell;
@@ -572,7 +1003,10 @@ ir::ec ir::S2STDatabase::delet(Block key, delete_mode mode) noexcept
 
 	cell.deleted = 1;
 	code = _metawrite(cell, index);
+	if (code != ec::ok) return code;
+	_meta.count--;
 	_meta.delcount++;
+	_file.used -= cell.keysize + cell.datasize;
 
 	return ec::ok;
 }
@@ -623,14 +1057,27 @@ ir::ec ir::S2STDatabase::set_file_size(uint32 newfilesize) noexcept
 ir::ec ir::S2STDatabase::set_ram_mode(bool holdfile, bool holdmeta) noexcept
 {
 	if (!_ok) return ec::object_not_inited;
+	Modification modification(this, _writeaccess && !holdfile && !holdmeta && (_file.hold || _meta.hold));
 
 	//Read meta
 	if (holdmeta && !_meta.hold)
 	{
 		if (!_meta.ram.resize(_meta.size)) return ec::alloc;
-		if (fseek(_meta.file, sizeof(MetaHeader), SEEK_SET) != 0) return ec::seek_file;;
-		if (fread(&_meta.ram[0], sizeof(MetaCell), _meta.size, _meta.file) < _meta.size) return ec::read_file;
-		_meta.pointer = _meta.size;
+		if (_legacy)
+		{
+			for (uint32 i = 0; i < _meta.size; i++)
+			{
+				ec code = _metaread(&_meta.ram[i], i);
+				if (code != ec::ok) return code;
+			}
+		}
+		else
+		{
+			if (fseek(_meta.file, sizeof(MetaHeader), SEEK_SET) != 0) return ec::seek_file;;
+			if (fread(&_meta.ram[0], sizeof(MetaCell), _meta.size, _meta.file) < _meta.size) return ec::read_file;
+			_meta.pointer = _meta.size;
+			_meta.written = false;
+		}
 	}
 	//Write meta
 	else if (!holdmeta && _meta.hold)
@@ -640,6 +1087,7 @@ ir::ec ir::S2STDatabase::set_ram_mode(bool holdfile, bool holdmeta) noexcept
 			if (fseek(_meta.file, sizeof(MetaHeader), SEEK_SET) != 0) return ec::seek_file;
 			if (fwrite(&_meta.ram[0], sizeof(MetaCell), _meta.size, _meta.file) < _meta.size) return ec::write_file;
 			_meta.pointer = _meta.size;
+			_meta.written = true;
 		}
 		_meta.ram.clear();
 	}
@@ -653,6 +1101,7 @@ ir::ec ir::S2STDatabase::set_ram_mode(bool holdfile, bool holdmeta) noexcept
 		if (fseek(_file.file, 0, SEEK_SET) != 0) return ec::seek_file;
 		if (fread(&_file.ram[0], 1, _file.size, _file.file) < _file.size) return ec::read_file;
 		_file.pointer = _file.size;
+		_file.written = false;
 	}
 	//Write data
 	else if (!holdfile && _file.hold)
@@ -662,6 +1111,7 @@ ir::ec ir::S2STDatabase::set_ram_mode(bool holdfile, bool holdmeta) noexcept
 			if (fseek(_file.file, 0, SEEK_SET) != 0) return ec::seek_file;;
 			if (fwrite(&_file.ram[0], 1, _file.size, _file.file) < _file.size) return ec::write_file;
 			_file.pointer = _file.size;
+			_file.written = true;
 		}
 		_file.ram.clear();
 	}
@@ -671,27 +1121,89 @@ ir::ec ir::S2STDatabase::set_ram_mode(bool holdfile, bool holdmeta) noexcept
 	return ec::ok;
 }
 
+ir::ec ir::S2STDatabase::hint(access_pattern pattern) noexcept
+{
+	if (!_ok) return ec::object_not_inited;
+	_pattern = pattern;
+	_mapping.hint(pattern);
+	ec code = _advise(_file.file, pattern);
+	if (code != ec::ok) return code;
+	return _advise(_meta.file, pattern);
+}
+
+ir::ec ir::S2STDatabase::set_access_log(bool log) noexcept
+{
+	if (!_ok) return ec::object_not_inited;
+	_logging = log;
+	if (!log) _log.clear();
+	return ec::ok;
+}
+
+ir::ec ir::S2STDatabase::warm_up(bool data) noexcept
+{
+	if (!_ok) return ec::object_not_inited;
+	if (_file.hold && _meta.hold) return ec::ok;
+	return _warm_up(&_path, _beta ? 'd' : 'b', _beta ? 'c' : 'a', data && !_file.hold);
+}
+
+ir::ec ir::S2STDatabase::set_parallel(Parallel *parallel) noexcept
+{
+	if (!_ok) return ec::object_not_inited;
+	_parallel = parallel;
+	return ec::ok;
+}
+
 ir::ec ir::S2STDatabase::optimize() noexcept
 {
 	if (!_ok) return ec::object_not_inited;
 	if (!_writeaccess) return ec::write_file;
+	Modification modification(this, !_file.hold && !_meta.hold);
+	bool holdfile = _file.hold;
+	bool holdmeta = _meta.hold;
+	bool logging;
+	access_pattern pattern;
+	Parallel *parallel = _parallel;
 	{
-		_path[_path.size() - 2] = '\0';
+		_path[_path.size() - 3] = '\0';
 		ec code;
 		S2STDatabase beta(_path.data(), create_mode::neww, &code, true);
-		for (uint32 i = 0; i < get_table_size(); i++)
+		_path[_path.size() - 3] = '~';
+		if (code != ec::ok) return code;
+		beta._parallel = parallel;
+		if (holdfile || holdmeta)
+		{
+			code = beta.set_ram_mode(holdfile, holdmeta);
+			if (code != ec::ok) return code;
+		}
+		if (_parallel_possible())
+		{
+			code = _parallel_optimize(&beta);
+			if (code != ec::ok) return code;
+		}
+		else for (uint32 i = 0; i < _meta.size; i++)
 		{
 			ir::Block key, data;
 			code = read_direct(i, &key, &data);
+			if (code == ec::key_not_exists) continue;
 			if (code != ec::ok) return code;
 			code = beta.insert(key, data);
 			if (code != ec::ok) return code;
 		}
+		logging = _logging;
+		pattern = _pattern;
+		_logging = false;
 		char buffer[sizeof(S2STDatabase)];
 		memcpy(buffer, this, sizeof(S2STDatabase));
 		memcpy(this, &beta, sizeof(S2STDatabase));
 		memcpy(&beta, buffer, sizeof(S2STDatabase));
+		Shared shared = _shared;
+		_shared = beta._shared;
+		beta._shared = shared;
+		_shared.rebuild++;
 	}
+	_logging = logging;
+	_parallel = parallel;
+	if (pattern != access_pattern::normal) hint(pattern);
 	#ifdef _WIN32
 		_path[_path.size() - 2] = _beta ? 'a' : 'c';
 		_wunlink(_path.data());
@@ -709,11 +1221,13 @@ ir::ec ir::S2STDatabase::optimize() noexcept
 void ir::S2STDatabase::finalize() noexcept
 {
 	_mapping.close();
+	_mapping.hint(access_pattern::normal);
+	if (_logging && _log.size() > 0) _log_save(&_path, _log);
 	set_ram_mode(false, false);
 	if (_file.file != nullptr) fclose(_file.file);
 	if (_meta.file != nullptr)
 	{
-		if (_writeaccess)
+		if (_writeaccess && !_legacy)
 		{
 			MetaHeader header;
 			header.count = _meta.count;
@@ -728,6 +1242,7 @@ void ir::S2STDatabase::finalize() noexcept
 	
 	_file.hold = false;
 	_file.pointer = 0;
+	_file.written = false;
 	_file.size = 0;
 	_file.file = nullptr;
 	_file.changed = false;
@@ -735,6 +1250,7 @@ void ir::S2STDatabase::finalize() noexcept
 	_file.used = 0;
 	_meta.hold = false;
 	_meta.pointer = 0;
+	_meta.written = false;
 	_meta.size = 0;
 	_meta.file = nullptr;
 	_meta.changed = false;
@@ -745,6 +1261,13 @@ void ir::S2STDatabase::finalize() noexcept
 	_beta = false;
 	_ok = false;
 	_writeaccess = false;
+	_legacy = false;
+	_pattern = access_pattern::normal;
+	_logging = false;
+	_log.clear();
+	_readbuffer.clear();
+	_parallel = nullptr;
+	_shared_close(&_shared);
 }
 
 ir::S2STDatabase::~S2STDatabase() noexcept
@@ -12,6 +12,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <random>
+#include <utility>
 
 template <class T, size_t A>
 ir::Matrix<T, A>::Matrix() noexcept
@@ -29,7 +30,7 @@ bool ir::Matrix<T, A>::init(size_t height, size_t width) noexcept
 {
 	finalize();
 	size_t aligned_width = (width + A - 1) / A *A;
-	size_t size = height *aligned_width *sizeof(T) + (A - 1) *sizeof(T);
+	size_t size = height *aligned_width *sizeof(T) + _alignment - 1;
 	_data = malloc(size);
 	if (_data != nullptr)
 	{
@@ -40,6 +41,19 @@ bool ir::Matrix<T, A>::init(size_t height, size_t width) noexcept
 	return _data != nullptr;
 }
 
+template <class T, size_t A>
+bool ir::Matrix<T, A>::init(size_t height, size_t width, void *data) noexcept
+{
+	finalize();
+	assert(data != nullptr);
+	if ((size_t)data % _alignment != 0) return false;
+	_data = data;
+	_external = true;
+	_height = height;
+	_width = width;
+	return true;
+}
+
 template <class T, size_t A>
 bool ir::Matrix<T, A>::ok() const noexcept
 {
@@ -51,26 +65,35 @@ void ir::Matrix<T, A>::finalize() noexcept
 {
 	if (_data != nullptr)
 	{
-		free(_data);
+		if (!_external) free(_data);
 		_data = nullptr;
 	}
+	_external = false;
 	_height = 0;
 	_width = 0;
 }
 
+template <class T, size_t A>
+void ir::Matrix<T, A>::swap(Matrix *other) noexcept
+{
+	std::swap(_data, other->_data);
+	std::swap(_width, other->_width);
+	std::swap(_height, other->_height);
+	std::swap(_external, other->_external);
+}
+
 template <class T, size_t A>
 ir::Matrix<T, A>::~Matrix() noexcept
 {
 	finalize();
 }
 
-template<class T, size_t A>
-void ir::Matrix<T, A>::zero() noexcept
+template <class T, size_t A>
+template <class S, size_t B>
+void ir::Matrix<T, A>::convert(const Matrix<S, B> *IR_RESTRICT source) noexcept
 {
-	assert(_data != nullptr);
-	size_t aligned_width = (width + A - 1) / A *A;
-	size_t size = height *aligned_width *sizeof(T) + (A - 1) *sizeof(T);
-	memset(_data, 0, size);
+	assert(source != nullptr && _height == source->height() && _width == source->width());
+	for (size_t i = 0; i < _height; i++) simd_kernels::convert(_width, source->data(i), data(i));
 }
 
 template <class T, size_t A>
@@ -88,43 +111,116 @@ void ir::Matrix<T, A>::random(T low, T high) noexcept
 	}
 }
 
+//Splits count items between threads of pool P, chunks are multiples of quantum. Returns false if pool is not initialized, caller then runs work serially
 template<class T, size_t A>
-void ir::Matrix<T, A>::add(const Matrix<T, A> *IR_RESTRICT b) noexcept
+template<class P>
+bool ir::Matrix<T, A>::_run(void *parallel, size_t count, size_t quantum, const void *user, Range *body) noexcept
 {
-	assert(b != nullptr && b != this && _height == b->_height && _width == b->_width);
-	for (size_t row = 0; row < _height; row++)
+	P *pool = (P*)parallel;
+	const size_t n = (pool->n() > 0) ? pool->n() : 1;
+	size_t grain = (count / (8 * n) + quantum - 1) / quantum * quantum;
+	if (grain == 0) grain = quantum;
+	return pool->parallel_for(0, count, grain, user, body);
+}
+
+template<class T, size_t A>
+template<class P>
+ir::uint32 ir::Matrix<T, A>::_threads(void *parallel) noexcept
+{
+	return ((P*)parallel)->n();
+}
+
+template<class T, size_t A>
+void ir::Matrix<T, A>::_element(const void *user, uint32, size_t begin, size_t end) noexcept
+{
+	const ElementContext *context = (const ElementContext*)user;
+	Chunk<T, A> *IR_RESTRICT c = context->c;
+	const Chunk<T, A> *IR_RESTRICT a = context->a;
+	const Chunk<T, A> *IR_RESTRICT b = context->b;
+	switch (context->operation)
 	{
-		for (size_t column = 0; column < _width; column += A)
-		{
-			chunk_at(row, column) += b->chunk(row, column);
-		}
+	case Operation::zero:		for (size_t i = begin; i < end; i++) c[i].zero(); break;
+	case Operation::add:		for (size_t i = begin; i < end; i++) c[i] += a[i]; break;
+	case Operation::subtract:	for (size_t i = begin; i < end; i++) c[i] -= a[i]; break;
+	case Operation::multiply:	for (size_t i = begin; i < end; i++) c[i] *= a[i]; break;
+	case Operation::sum:		for (size_t i = begin; i < end; i++) c[i] = a[i] + b[i]; break;
+	case Operation::difference:	for (size_t i = begin; i < end; i++) c[i] = a[i] - b[i]; break;
+	case Operation::product:	for (size_t i = begin; i < end; i++) c[i] = a[i] * b[i]; break;
 	}
 }
 
+//Rows are stored contiguously and padding is zero, so element-wise operations process whole storage as one array of chunks
+//Threads get ranges that start on cache lines
+template<class T, size_t A>
+void ir::Matrix<T, A>::_elementwise(Operation operation, const Matrix *IR_RESTRICT a, const Matrix *IR_RESTRICT b, void *parallel, Runner *runner) noexcept
+{
+	assert(_data != nullptr);
+	if (_height == 0) return;
+	ElementContext context;
+	context.operation = operation;
+	context.c = chunk_data(0);
+	context.a = (a != nullptr) ? a->chunk_data(0) : nullptr;
+	context.b = (b != nullptr) ? b->chunk_data(0) : nullptr;
+	const size_t count = _height * ((_width + A - 1) / A);
+	if (runner == nullptr || !runner(parallel, count, _line, &context, _element)) _element(&context, 0, 0, count);
+}
+
+template<class T, size_t A>
+void ir::Matrix<T, A>::zero() noexcept
+{
+	_elementwise(Operation::zero, nullptr, nullptr, nullptr, nullptr);
+}
+
+template<class T, size_t A>
+void ir::Matrix<T, A>::zero(Parallel *parallel) noexcept
+{
+	assert(parallel != nullptr);
+	_elementwise(Operation::zero, nullptr, nullptr, parallel, _run<Parallel>);
+}
+
+template<class T, size_t A>
+void ir::Matrix<T, A>::add(const Matrix<T, A> *IR_RESTRICT b) noexcept
+{
+	assert(b != nullptr && b != this && _height == b->_height && _width == b->_width);
+	_elementwise(Operation::add, b, nullptr, nullptr, nullptr);
+}
+
+template<class T, size_t A>
+void ir::Matrix<T, A>::add(const Matrix<T, A> *IR_RESTRICT b, Parallel *parallel) noexcept
+{
+	assert(b != nullptr && b != this && _height == b->_height && _width == b->_width);
+	assert(parallel != nullptr);
+	_elementwise(Operation::add, b, nullptr, parallel, _run<Parallel>);
+}
+
 template<class T, size_t A>
 void ir::Matrix<T, A>::subtract(const Matrix<T, A> *IR_RESTRICT b) noexcept
 {
 	assert(b != nullptr && b != this && _height == b->_height && _width == b->_width);
-	for (size_t row = 0; row < _height; row++)
-	{
-		for (size_t column = 0; column < _width; column += A)
-		{
-			chunk_at(row, column) -= b->chunk(row, column);
-		}
-	}
+	_elementwise(Operation::subtract, b, nullptr, nullptr, nullptr);
+}
+
+template<class T, size_t A>
+void ir::Matrix<T, A>::subtract(const Matrix<T, A> *IR_RESTRICT b, Parallel *parallel) noexcept
+{
+	assert(b != nullptr && b != this && _height == b->_height && _width == b->_width);
+	assert(parallel != nullptr);
+	_elementwise(Operation::subtract, b, nullptr, parallel, _run<Parallel>);
 }
 
 template<class T, size_t A>
 void ir::Matrix<T, A>::element_multiply(const Matrix<T, A> *IR_RESTRICT b) noexcept
 {
 	assert(b != nullptr && b != this && _height == b->_height && _width == b->_width);
-	for (size_t row = 0; row < _height; row++)
-	{
-		for (size_t column = 0; column < _width; column += A)
-		{
-			chunk_at(row, column) *= b->chunk(row, column);
-		}
-	}
+	_elementwise(Operation::multiply, b, nullptr, nullptr, nullptr);
+}
+
+template<class T, size_t A>
+void ir::Matrix<T, A>::element_multiply(const Matrix<T, A> *IR_RESTRICT b, Parallel *parallel) noexcept
+{
+	assert(b != nullptr && b != this && _height == b->_height && _width == b->_width);
+	assert(parallel != nullptr);
+	_elementwise(Operation::multiply, b, nullptr, parallel, _run<Parallel>);
 }
 
 template<class T, size_t A>
@@ -133,13 +229,17 @@ void ir::Matrix<T, A>::sum(const Matrix<T, A> *IR_RESTRICT a, const Matrix<T, A>
 	assert(a != nullptr && a != this && _height == a->_height && _width == a->_width);
 	assert(b != nullptr && b != this && _height == b->_height && _width == b->_width);
 	assert(a != b);
-	for (size_t row = 0; row < _height; row++)
-	{
-		for (size_t column = 0; column < _width; column += A)
-		{
-			chunk_at(row, column) = a->chunk(row, column) + b->chunk(row, column);
-		}
-	}
+	_elementwise(Operation::sum, a, b, nullptr, nullptr);
+}
+
+template<class T, size_t A>
+void ir::Matrix<T, A>::sum(const Matrix<T, A> *IR_RESTRICT a, const Matrix<T, A> *IR_RESTRICT b, Parallel *parallel) noexcept
+{
+	assert(a != nullptr && a != this && _height == a->_height && _width == a->_width);
+	assert(b != nullptr && b != this && _height == b->_height && _width == b->_width);
+	assert(a != b);
+	assert(parallel != nullptr);
+	_elementwise(Operation::sum, a, b, parallel, _run<Parallel>);
 }
 
 template<class T, size_t A>
@@ -148,13 +248,17 @@ void ir::Matrix<T, A>::difference(const Matrix<T, A> *IR_RESTRICT a, const Matri
 	assert(a != nullptr && a != this && _height == a->_height && _width == a->_width);
 	assert(b != nullptr && b != this && _height == b->_height && _width == b->_width);
 	assert(a != b);
-	for (size_t row = 0; row < _height; row++)
-	{
-		for (size_t column = 0; column < _width; column += A)
-		{
-			chunk_at(row, column) = a->chunk(row, column) + b->chunk(row, column);
-		}
-	}
+	_elementwise(Operation::difference, a, b, nullptr, nullptr);
+}
+
+template<class T, size_t A>
+void ir::Matrix<T, A>::difference(const Matrix<T, A> *IR_RESTRICT a, const Matrix<T, A> *IR_RESTRICT b, Parallel *parallel) noexcept
+{
+	assert(a != nullptr && a != this && _height == a->_height && _width == a->_width);
+	assert(b != nullptr && b != this && _height == b->_height && _width == b->_width);
+	assert(a != b);
+	assert(parallel != nullptr);
+	_elementwise(Operation::difference, a, b, parallel, _run<Parallel>);
 }
 
 template<class T, size_t A>
@@ -163,36 +267,231 @@ void ir::Matrix<T, A>::element_product(const Matrix<T, A> *IR_RESTRICT a, const
 	assert(a != nullptr && a != this && _height == a->_height && _width == a->_width);
 	assert(b != nullptr && b != this && _height == b->_height && _width == b->_width);
 	assert(a != b);
-	for (size_t row = 0; row < _height; row++)
+	_elementwise(Operation::product, a, b, nullptr, nullptr);
+}
+
+template<class T, size_t A>
+void ir::Matrix<T, A>::element_product(const Matrix<T, A> *IR_RESTRICT a, const Matrix<T, A> *IR_RESTRICT b, Parallel *parallel) noexcept
+{
+	assert(a != nullptr && a != this && _height == a->_height && _width == a->_width);
+	assert(b != nullptr && b != this && _height == b->_height && _width == b->_width);
+	assert(a != b);
+	assert(parallel != nullptr);
+	_elementwise(Operation::product, a, b, parallel, _run<Parallel>);
+}
+
+//Computes _mr x _nr block of product from packed slivers of a and b
+//Rows are unrolled manually, otherwise compilers tend to vectorize across rows instead of chunks
+template<class T, size_t A>
+void ir::Matrix<T, A>::_kernel(size_t depth, const T *IR_RESTRICT a, const Chunk<T, A> *IR_RESTRICT b, Chunk<T, A> *IR_RESTRICT c) noexcept
+{
+	static_assert(_mr == 4, "Micro-kernel is unrolled for four rows");
+	const size_t n = _nr / A;
+	Chunk<T, A> sum0[n], sum1[n], sum2[n], sum3[n];
+	for (size_t j = 0; j < n; j++) { sum0[j].zero(); sum1[j].zero(); sum2[j].zero(); sum3[j].zero(); }
+	for (size_t p = 0; p < depth; p++)
 	{
-		for (size_t column = 0; column < _width; column += A)
+		Chunk<T, A> a0, a1, a2, a3;
+		a0.fill(a[0]);
+		a1.fill(a[1]);
+		a2.fill(a[2]);
+		a3.fill(a[3]);
+		for (size_t j = 0; j < n; j++)
 		{
-			chunk_at(row, column) = a->chunk(row, column) * b->chunk(row, column);
+			sum0[j] += a0 * b[j];
+			sum1[j] += a1 * b[j];
+			sum2[j] += a2 * b[j];
+			sum3[j] += a3 * b[j];
 		}
+		a += _mr;
+		b += n;
+	}
+	for (size_t j = 0; j < n; j++)
+	{
+		c[j] = sum0[j];
+		c[n + j] = sum1[j];
+		c[2 * n + j] = sum2[j];
+		c[3 * n + j] = sum3[j];
 	}
 }
 
+//Packs slivers of b panel from begin to end, padded with zeros
 template<class T, size_t A>
-void ir::Matrix<T, A>::matrix_product_transposed(const Matrix<T, A> *IR_RESTRICT a, const Matrix<T, A> *IR_RESTRICT b) noexcept
+void ir::Matrix<T, A>::_pack(const void *user, uint32, size_t begin, size_t end) noexcept
 {
-	assert(a != nullptr && a != this);
-	assert(b != nullptr && b != this);
-	assert(a != b);
-	assert(a->_width == b->_width);
-	assert(a->_height == _height);
-	assert(b->_height == _width);
+	const ProductContext *context = (const ProductContext*)user;
+	const Matrix *IR_RESTRICT b = context->b;
+	const size_t n = context->c->_width;
+	const size_t kc = context->kc;
+	for (size_t s = begin; s < end; s++)
+	{
+		T *sliver = context->packed_b + s * _nr * kc;
+		for (size_t j = 0; j < _nr; j++)
+		{
+			const size_t column = context->jc + s * _nr + j;
+			if (column >= n) { for (size_t p = 0; p < kc; p++) sliver[p * _nr + j] = (T)0; }
+			else if (context->transposed) { const T *source = b->data(column) + context->pc; for (size_t p = 0; p < kc; p++) sliver[p * _nr + j] = source[p]; }
+			else { for (size_t p = 0; p < kc; p++) sliver[p * _nr + j] = b->data(context->pc + p)[column]; }
+		}
+	}
+}
 
-	for (size_t row = 0; row < _height; row++)
+//Multiplies blocks of _mc rows from begin to end by packed b panel
+//_mc rows span whole cache lines for any width, so threads never write to the same line
+template<class T, size_t A>
+void ir::Matrix<T, A>::_block(const void *user, uint32 id, size_t begin, size_t end) noexcept
+{
+	static_assert(_mc % 64 == 0, "Blocks of rows need to start on cache lines");
+	const ProductContext *context = (const ProductContext*)user;
+	Matrix *IR_RESTRICT c = context->c;
+	const Matrix *IR_RESTRICT a = context->a;
+	const size_t m = c->_height;
+	const size_t nc = context->nc;
+	const size_t kc = context->kc;
+	T *packed_a = context->packed_a + id * _mc * _kc;
+	const T *packed_b = context->packed_b;
+	for (size_t ib = begin; ib < end; ib++)
 	{
-		for (size_t column = 0; column < _width; column++)
+		const size_t ic = ib * _mc;
+		const size_t mc = (m - ic < _mc) ? m - ic : _mc;
+
+		//Pack a into slivers of _mr rows, padded with zeros
+		for (size_t ir = 0; ir < mc; ir += _mr)
 		{
-			Chunk<T, A> sum;
-			sum.zero();
-			for (size_t i = 0; i < _width; i += A)
+			T *sliver = packed_a + ir * kc;
+			for (size_t r = 0; r < _mr; r++)
 			{
-				sum += a->chunk_at(row, i) * b->chunk_at(column, i);
+				const size_t row = ic + ir + r;
+				if (row >= m) { for (size_t p = 0; p < kc; p++) sliver[p * _mr + r] = (T)0; }
+				else { const T *source = a->data(row) + context->pc; for (size_t p = 0; p < kc; p++) sliver[p * _mr + r] = source[p]; }
+			}
+		}
+
+		//Multiply slivers and accumulate into result
+		for (size_t jr = 0; jr < nc; jr += _nr)
+		{
+			const size_t columns = (nc - jr < _nr) ? nc - jr : _nr;
+			for (size_t ir = 0; ir < mc; ir += _mr)
+			{
+				const size_t rows = (mc - ir < _mr) ? mc - ir : _mr;
+				alignas(64) Chunk<T, A> block[_mr * (_nr / A)];
+				if (context->dispatch) context->kernels->block(kc, packed_a + ir * kc, packed_b + jr * kc, _nr, (T*)block);
+				else _kernel(kc, packed_a + ir * kc, (const Chunk<T, A>*)(packed_b + jr * kc), block);
+				for (size_t r = 0; r < rows; r++)
+				{
+					if (columns == _nr)
+					{
+						Chunk<T, A> *destination = c->chunk_data(ic + ir + r) + (context->jc + jr) / A;
+						for (size_t j = 0; j < _nr / A; j++) destination[j] += block[r * (_nr / A) + j];
+					}
+					else
+					{
+						T *destination = c->data(ic + ir + r) + context->jc + jr;
+						for (size_t j = 0; j < columns; j++) destination[j] += block[r * (_nr / A) + j / A].r[j % A];
+					}
+				}
 			}
-			at(row, column) = sum.sum();
 		}
 	}
-}
\ No newline at end of file
+}
+
+//Blocked matrix product: b is packed into panels of _kc x _nc, a into blocks of _mc x _kc, both are multiplied by micro-kernel
+//Micro-kernel is dispatched at runtime for float and double, _kernel is used otherwise
+//With threads, slivers of every panel are packed in parallel, then blocks of rows are distributed between threads
+template<class T, size_t A>
+void ir::Matrix<T, A>::_product(const Matrix<T, A> *IR_RESTRICT a, const Matrix<T, A> *IR_RESTRICT b, bool transposed, void *parallel, Runner *runner, uint32 threads) noexcept
+{
+	const size_t m = _height;
+	const size_t n = _width;
+	const size_t k = a->_width;
+	_elementwise(Operation::zero, nullptr, nullptr, parallel, runner);
+	if (threads == 0) threads = 1;
+
+	//Packed panels are aligned to cache line, as dispatched kernels use aligned loads
+	char *memory = (char*)malloc((threads * _mc * _kc + _kc * _nc) * sizeof(T) + _alignment);
+	if (memory == nullptr)
+	{
+		//Not enough memory for packing, fall back to straightforward product
+		for (size_t row = 0; row < m; row++)
+		{
+			for (size_t column = 0; column < n; column++)
+			{
+				T sum = (T)0;
+				for (size_t i = 0; i < k; i++) sum += a->at(row, i) * (transposed ? b->at(column, i) : b->at(i, column));
+				at(row, column) = sum;
+			}
+		}
+		return;
+	}
+	ProductContext context;
+	context.c = this;
+	context.a = a;
+	context.b = b;
+	context.transposed = transposed;
+	context.kernels = Kernels<T>::get();
+	context.dispatch = context.kernels->level != simd::none && (_nr * sizeof(T)) % 64 == 0;
+	context.packed_a = (T*)(((size_t)memory + _alignment - 1) / _alignment * _alignment);
+	context.packed_b = context.packed_a + threads * _mc * _kc;
+	const size_t blocks = (m + _mc - 1) / _mc;
+
+	for (size_t jc = 0; jc < n; jc += _nc)
+	{
+		context.jc = jc;
+		context.nc = (n - jc < _nc) ? n - jc : _nc;
+		const size_t slivers = (context.nc + _nr - 1) / _nr;
+		for (size_t pc = 0; pc < k; pc += _kc)
+		{
+			context.pc = pc;
+			context.kc = (k - pc < _kc) ? k - pc : _kc;
+			if (runner == nullptr || !runner(parallel, slivers, 1, &context, _pack)) _pack(&context, 0, 0, slivers);
+			if (runner == nullptr || !runner(parallel, blocks, 1, &context, _block)) _block(&context, 0, 0, blocks);
+		}
+	}
+	free(memory);
+}
+
+template<class T, size_t A>
+void ir::Matrix<T, A>::matrix_product(const Matrix<T, A> *IR_RESTRICT a, const Matrix<T, A> *IR_RESTRICT b) noexcept
+{
+	assert(a != nullptr && a != this);
+	assert(b != nullptr && b != this);
+	assert(a->_width == b->_height);
+	assert(a->_height == _height);
+	assert(b->_width >= _width);
+	_product(a, b, false, nullptr, nullptr, 1);
+}
+
+template<class T, size_t A>
+void ir::Matrix<T, A>::matrix_product(const Matrix<T, A> *IR_RESTRICT a, const Matrix<T, A> *IR_RESTRICT b, Parallel *parallel) noexcept
+{
+	assert(a != nullptr && a != this);
+	assert(b != nullptr && b != this);
+	assert(a->_width == b->_height);
+	assert(a->_height == _height);
+	assert(b->_width >= _width);
+	assert(parallel != nullptr);
+	_product(a, b, false, parallel, _run<Parallel>, _threads<Parallel>(parallel));
+}
+
+template<class T, size_t A>
+void ir::Matrix<T, A>::matrix_product_transposed(const Matrix<T, A> *IR_RESTRICT a, const Matrix<T, A> *IR_RESTRICT b) noexcept
+{
+	assert(a != nullptr && a != this);
+	assert(b != nullptr && b != this);
+	assert(a->_width <= b->_width);
+	assert(a->_height == _height);
+	assert(b->_height == _width);
+	_product(a, b, true, nullptr, nullptr, 1);
+}
+
+template<class T, size_t A>
+void ir::Matrix<T, A>::matrix_product_transposed(const Matrix<T, A> *IR_RESTRICT a, const Matrix<T, A> *IR_RESTRICT b, Parallel *parallel) noexcept
+{
+	assert(a != nullptr && a != this);
+	assert(b != nullptr && b != this);
+	assert(a->_width <= b->_width);
+	assert(a->_height == _height);
+	assert(b->_height == _width);
+	assert(parallel != nullptr);
+	_product(a, b, true, parallel, _run<Parallel>, _threads<Parallel>(parallel));
+}
@@ -9,12 +9,15 @@
 */
 
 #include "../../include/ir/file.h"
+#include "../../include/ir/mapping.h"
+#include "../../include/ir/parallel.h"
 #include <stdlib.h>
+#include <string.h>
 #include <random>
 #include <time.h>
 
 template <class T, size_t A, class F>
-ir::ec ir::Neuro<T, A, F>::_init(T amplitude, FILE *file) noexcept
+ir::ec ir::Neuro<T, A, F>::_init_buffers() noexcept
 {
 	//Init vectors
 	try { _vectors = std::vector<Matrix<T, A>>(_layers.size()); } catch (...) { return ec::alloc; }
@@ -29,6 +32,17 @@ ir::ec ir::Neuro<T, A, F>::_init(T amplitude, FILE *file) noexcept
 	{
 		if (!_errors[i].init(1, _layers[i + 1])) return ec::alloc;
 	}
+
+	//Init goal
+	if (!_goal.init(1, _layers.back())) return ec::alloc;
+	return ec::ok;
+}
+
+template <class T, size_t A, class F>
+ir::ec ir::Neuro<T, A, F>::_init(T amplitude, FILE *file) noexcept
+{
+	const ec code = _init_buffers();
+	if (code != ec::ok) return code;
 	
 	//Init weights
 	std::default_random_engine generator;
@@ -65,9 +79,88 @@ ir::ec ir::Neuro<T, A, F>::_init(T amplitude, FILE *file) noexcept
 		}
 	}
 
-	//Init goal
-	if (!_goal.init(1, _layers.back())) return ec::alloc;
+	_ok = true;
+	return ec::ok;
+}
+
+template <class T, size_t A, class F>
+void ir::Neuro<T, A, F>::_offsets(uint32 type_size, uint32 alignment, const std::vector<uint32> &layers, uint64 *offsets) noexcept
+{
+	//Matrixes are aligned like data of ir::Matrix with given type and alignment, mapping itself is aligned to page
+	const uint64 line = (alignment * type_size > 64) ? alignment * type_size : 64;
+	uint64 offset = sizeof(FileHeader) + sizeof(FileLayout) + sizeof(uint32) * layers.size();
+	for (size_t i = 0; i < layers.size() - 1; i++)
+	{
+		offsets[i] = (offset + line - 1) / line * line;
+		const uint64 padded = ((uint64)layers[i] + 1 + alignment - 1) / alignment * alignment;
+		offset = offsets[i] + layers[i + 1] * padded * type_size;
+	}
+	offsets[layers.size() - 1] = offset;
+}
 
+template <class T, size_t A, class F>
+ir::ec ir::Neuro<T, A, F>::_load(File *file, bool map) noexcept
+{
+	FileLayout layout;
+	if (file->read(&layout, sizeof(FileLayout)) < sizeof(FileLayout)) return ec::read_file;
+	if (layout.nlayers < 2 || layout.alignment == 0 || (layout.type_size != sizeof(float) && layout.type_size != sizeof(double))) return ec::invalid_signature;
+	std::vector<uint64> offsets;
+	try
+	{
+		_layers.resize(layout.nlayers);
+		offsets.resize(layout.nlayers);
+		_weights = std::vector<Matrix<T, A>>(_layers.size() - 1);
+	}
+	catch (...) { return ec::alloc; }
+	if (file->read(&_layers[0], sizeof(uint32) * _layers.size()) < sizeof(uint32) * _layers.size()) return ec::read_file;
+	_offsets(layout.type_size, layout.alignment, _layers, offsets.data());
+	if (file->size() < offsets.back()) return ec::invalid_signature;
+	const ec code = _init_buffers();
+	if (code != ec::ok) return code;
+
+	//Mapped weights, emulated mapping may be not aligned, then weights are read
+	const bool native = layout.type_size == sizeof(T) && layout.alignment == A;
+	if (map && native)
+	{
+		_mapping = new(std::nothrow) Mapping;
+		if (_mapping == nullptr) return ec::alloc;
+		char *data = (char*)_mapping->map(file->file(), 0, (size_t)offsets.back(), Mapping::map_mode::copy);
+		if (data == nullptr) return ec::mapping;
+		bool mapped = true;
+		for (size_t i = 0; i < _layers.size() - 1 && mapped; i++)
+		{
+			mapped = _weights[i].init(_layers[i + 1], _layers[i] + 1, data + offsets[i]);
+		}
+		if (mapped) { _ok = true; return ec::ok; }
+		for (size_t i = 0; i < _layers.size() - 1; i++) _weights[i].finalize();
+		delete _mapping;
+		_mapping = nullptr;
+	}
+
+	//Read weights, weights of same type and alignment are read with one call per matrix
+	std::vector<char> row;
+	for (size_t i = 0; i < _layers.size() - 1; i++)
+	{
+		if (!_weights[i].init(_layers[i + 1], _layers[i] + 1)) return ec::alloc;
+		if (!file->seek(offsets[i], SEEK_SET)) return ec::seek_file;
+		if (native)
+		{
+			const size_t size = (size_t)_layers[i + 1] * ((_layers[i] + A) / A * A) * sizeof(T);
+			if (file->read(_weights[i].data(0), size) < size) return ec::read_file;
+			continue;
+		}
+		const size_t padded = ((size_t)_layers[i] + layout.alignment) / layout.alignment * layout.alignment;
+		try { row.resize(padded * layout.type_size); } catch (...) { return ec::alloc; }
+		for (size_t j = 0; j < _layers[i + 1]; j++)
+		{
+			if (file->read(row.data(), row.size()) < row.size()) return ec::read_file;
+			for (size_t k = 0; k < _layers[i] + 1; k++)
+			{
+				if (layout.type_size == sizeof(float)) { float f; memcpy(&f, row.data() + k * sizeof(float), sizeof(float)); _weights[i].at(j, k) = (T)f; }
+				else { double d; memcpy(&d, row.data() + k * sizeof(double), sizeof(double)); _weights[i].at(j, k) = (T)d; }
+			}
+		}
+	}
 	_ok = true;
 	return ec::ok;
 }
@@ -83,13 +176,25 @@ ir::Neuro<T, A, F>::Neuro(size_t nlayers, const uint32 *layers, T amplitude, ec
 }
 
 template <class T, size_t A, class F>
-ir::Neuro<T, A, F>::Neuro(const schar *filepath, ec *code) noexcept
+ir::Neuro<T, A, F>::Neuro(const schar *filepath, ec *code) noexcept : Neuro(filepath, false, code)
+{
+}
+
+template <class T, size_t A, class F>
+ir::Neuro<T, A, F>::Neuro(const schar *filepath, bool map, ec *code) noexcept
 {
 	File file(filepath, SS("rb"));
 	if (!file.ok())																	{ if (code != nullptr) *code = ec::open_file; return; }
 	FileHeader header, sample;
 	if (file.read(&header, sizeof(FileHeader)) == 0)								{ if (code != nullptr) *code = ec::read_file; return; }
-	if (memcmp(&header, &sample, sizeof(FileHeader)) != 0)							{ if (code != nullptr) *code = ec::invalid_signature; return; }
+	if (memcmp(header.signature, sample.signature, sizeof(header.signature)) != 0
+		|| (header.version != 4 && header.version != 5))							{ if (code != nullptr) *code = ec::invalid_signature; return; }
+	if (header.version == 5)
+	{
+		ec c = _load(&file, map);
+		if (code != nullptr) *code = c;
+		return;
+	}
 	uint32 nlayers;
 	if (file.read(&nlayers, sizeof(uint32)) == 0)									{ if (code != nullptr) *code = ec::read_file; return; }
 	_layers.resize(nlayers);
@@ -104,6 +209,126 @@ bool ir::Neuro<T, A, F>::ok() const noexcept
 	return _ok;
 }
 
+template <class T, size_t A, class F>
+ir::ec ir::Neuro<T, A, F>::set_batch(uint32 batch) noexcept
+{
+	assert(_ok);
+	assert(batch > 0);
+	//Buffers are allocated aside and swapped in when all allocations succeeded, so error keeps previous batch
+	std::vector<Matrix<T, A>> vectors, errors, transposed_vectors, transposed_errors, gradients;
+	Matrix<T, A> goal;
+	std::vector<Worker> workers;
+	try
+	{
+		vectors = std::vector<Matrix<T, A>>(_layers.size());
+		errors = std::vector<Matrix<T, A>>(_layers.size() - 1);
+	}
+	catch (...) { return ec::alloc; }
+	for (size_t i = 0; i < _layers.size(); i++)
+	{
+		if (!vectors[i].init(batch, _layers[i])) return ec::alloc;
+	}
+	for (size_t i = 0; i < _layers.size() - 1; i++)
+	{
+		if (!errors[i].init(batch, _layers[i + 1])) return ec::alloc;
+	}
+	if (!goal.init(batch, _layers.back())) return ec::alloc;
+
+	//Correction of batch needs transposed vectors and errors and gradients of weights
+	ec code = ec::ok;
+	if (batch > 1) code = _init_correction(batch, &transposed_vectors, &transposed_errors, &gradients);
+	if (code == ec::ok) code = _init_workers(batch, _parallel, &workers);
+	if (code != ec::ok) return code;
+
+	//Matrixes are swapped one by one, so pointers returned by get_input, get_output and get_goal stay valid
+	for (size_t i = 0; i < _layers.size(); i++) _vectors[i].swap(&vectors[i]);
+	for (size_t i = 0; i < _layers.size() - 1; i++) _errors[i].swap(&errors[i]);
+	_goal.swap(&goal);
+	_transposed_vectors.swap(transposed_vectors);
+	_transposed_errors.swap(transposed_errors);
+	_gradients.swap(gradients);
+	_workers.swap(workers);
+	_batch = batch;
+	return ec::ok;
+}
+
+template <class T, size_t A, class F>
+ir::ec ir::Neuro<T, A, F>::_init_correction(uint32 batch, std::vector<Matrix<T, A>> *pvt, std::vector<Matrix<T, A>> *net, std::vector<Matrix<T, A>> *g) const noexcept
+{
+	try
+	{
+		*pvt = std::vector<Matrix<T, A>>(_layers.size() - 1);
+		*net = std::vector<Matrix<T, A>>(_layers.size() - 1);
+		*g = std::vector<Matrix<T, A>>(_layers.size() - 1);
+	}
+	catch (...) { return ec::alloc; }
+	for (size_t i = 0; i < _layers.size() - 1; i++)
+	{
+		if (!(*pvt)[i].init(_layers[i] + 1, batch)) return ec::alloc;
+		for (size_t sample = 0; sample < batch; sample++) (*pvt)[i].at(_layers[i], sample) = (T)1;
+		if (!(*net)[i].init(_layers[i + 1], batch)) return ec::alloc;
+		if (!(*g)[i].init(_layers[i + 1], _layers[i] + 1)) return ec::alloc;
+	}
+	return ec::ok;
+}
+
+//Allocates buffers of workers for batch into workers, leaves workers empty if parallel is nullptr
+template <class T, size_t A, class F>
+ir::ec ir::Neuro<T, A, F>::_init_workers(uint32 batch, Parallel *parallel, std::vector<Worker> *workers) const noexcept
+{
+	workers->clear();
+	if (parallel == nullptr) return ec::ok;
+	const uint32 n = (parallel->n() < batch) ? parallel->n() : batch;
+	try { *workers = std::vector<Worker>(n); } catch (...) { return ec::alloc; }
+	for (uint32 id = 0; id < n; id++)
+	{
+		Worker *worker = &(*workers)[id];
+		worker->begin = (uint32)((uint64)batch * id / n);
+		worker->end = (uint32)((uint64)batch * (id + 1) / n);
+		const uint32 rows = worker->end - worker->begin;
+		ec code = ec::ok;
+		try
+		{
+			worker->vectors = std::vector<Matrix<T, A>>(_layers.size());
+			worker->errors = std::vector<Matrix<T, A>>(_layers.size() - 1);
+		}
+		catch (...) { code = ec::alloc; }
+		for (size_t i = 0; i < _layers.size() && code == ec::ok; i++)
+		{
+			if (!worker->vectors[i].init(rows, _layers[i])) code = ec::alloc;
+		}
+		for (size_t i = 0; i < _layers.size() - 1 && code == ec::ok; i++)
+		{
+			if (!worker->errors[i].init(rows, _layers[i + 1])) code = ec::alloc;
+		}
+		if (code == ec::ok && !worker->goal.init(rows, _layers.back())) code = ec::alloc;
+		if (code == ec::ok) code = _init_correction(rows, &worker->transposed_vectors, &worker->transposed_errors, &worker->gradients);
+		if (code != ec::ok) { workers->clear(); return code; }
+	}
+	return ec::ok;
+}
+
+template <class T, size_t A, class F>
+ir::ec ir::Neuro<T, A, F>::set_parallel(Parallel *parallel, bool hogwild) noexcept
+{
+	assert(_ok);
+	assert(parallel == nullptr || parallel->ok());
+	std::vector<Worker> workers;
+	const ec code = _init_workers(_batch, parallel, &workers);
+	if (code != ec::ok) return code;
+	_parallel = parallel;
+	_hogwild = hogwild;
+	_workers.swap(workers);
+	return ec::ok;
+}
+
+template <class T, size_t A, class F>
+ir::uint32 ir::Neuro<T, A, F>::get_batch() const noexcept
+{
+	assert(_ok);
+	return _batch;
+}
+
 template <class T, size_t A, class F>
 ir::Matrix<T, A> *ir::Neuro<T, A, F>::get_input() noexcept
 {
@@ -144,6 +369,7 @@ template <class T, size_t A, class F>
 void ir::Neuro<T, A, F>::forward() noexcept
 {
 	assert(_ok);
+	if (_parallel != nullptr && _parallel->parallel(this, _forward_worker)) return;
 	for (uint32 i = 0; i < (_layers.size() - 1); i++)
 		_forward(&_weights[i], &_vectors[i], &_vectors[i + 1]);
 }
@@ -152,45 +378,143 @@ template <class T, size_t A, class F>
 void ir::Neuro<T, A, F>::backward() noexcept
 {
 	assert(_ok);
+	if (_parallel != nullptr && _parallel->parallel(this, _backward_worker))
+	{
+		if (_hogwild) return;
+
+		//Gradients of threads are reduced and applied row by row, all layers in one loop
+		size_t rows = 0;
+		for (uint32 i = 0; i < (_layers.size() - 1); i++) rows += _layers[i + 1];
+		if (!_parallel->parallel_for(0, rows, 0, this, _reduce)) _reduce(this, 0, 0, rows);
+		return;
+	}
+
 	_lastbackward(&_goal, &_vectors[_layers.size() - 1], &_errors[_layers.size() - 2]);
 
-	for (uint32 i = (uint32)_layers.size() - 2; i > 0; i--)
-		_backward(&_weights[i], &_errors[i], &_vectors[i], &_errors[i - 1]);
+	if (_batch == 1)
+	{
+		//Every layer is swept once, errors are propagated through weights before they are corrected
+		for (uint32 i = (uint32)_layers.size() - 2; i > 0; i--)
+			_backward_corrigate(_coefficient, &_weights[i], &_errors[i], &_vectors[i], &_errors[i - 1]);
+		_corrigate(_coefficient, &_vectors[0], &_errors[0], &_weights[0]);
+	}
+	else
+	{
+		for (uint32 i = (uint32)_layers.size() - 2; i > 0; i--)
+			_backward(&_weights[i], &_errors[i], &_vectors[i], &_errors[i - 1]);
+
+		//Gradient is summed over samples, coefficient is divided by batch to apply their mean
+		for (uint32 i = 0; i < (_layers.size() - 1); i++)
+			_corrigate_batch(_coefficient / _batch, &_vectors[i], &_errors[i], &_transposed_vectors[i], &_transposed_errors[i], &_gradients[i], &_weights[i]);
+	}
+}
 
+template <class T, size_t A, class F>
+void ir::Neuro<T, A, F>::forward(Inference *inference) const noexcept
+{
+	assert(_ok);
+	assert(inference != nullptr && inference->ok());
+	assert(inference->_vectors.size() == _layers.size());
 	for (uint32 i = 0; i < (_layers.size() - 1); i++)
-		_corrigate(_coefficient, &_vectors[i], &_errors[i], &_weights[i]);
+		_forward(&_weights[i], &inference->_vectors[i], &inference->_vectors[i + 1]);
 }
 
 template <class T, size_t A, class F>
 ir::ec ir::Neuro<T, A, F>::save(const schar *filepath) const noexcept
 {
 	assert(_ok);
+	std::vector<uint64> offsets;
+	try { offsets.resize(_layers.size()); } catch (...) { return ec::alloc; }
+	_offsets(sizeof(T), A, _layers, offsets.data());
 	File file(filepath, SS("wb"));
 	if (!file.ok()) return ec::create_file;
 
 	FileHeader header;
 	if (file.write(&header, sizeof(FileHeader)) < sizeof(FileHeader)) return ec::write_file;
-
-	size_t nlayers = _layers.size();
-	if (file.write(&nlayers, sizeof(uint32)) < sizeof(uint32)) return ec::write_file;
+	FileLayout layout;
+	layout.nlayers = (uint32)_layers.size();
+	if (file.write(&layout, sizeof(FileLayout)) < sizeof(FileLayout)) return ec::write_file;
 	if (file.write(_layers.data(), sizeof(uint32) * _layers.size()) < sizeof(uint32) * _layers.size()) return ec::write_file;
+	uint64 position = sizeof(FileHeader) + sizeof(FileLayout) + sizeof(uint32) * _layers.size();
+	const char zeros[64] = {};
 	for (size_t i = 0; i < _layers.size() - 1; i++)
 	{
-		for (size_t j = 0; j < _layers[i + 1]; j++)
+		//Rows of matrix are contiguous, so the matrix is written at once
+		while (position < offsets[i])
 		{
-			for (size_t k = 0; k < _layers[i] + 1; k++)
-			{
-				double d = (double)_weights[i].at(j, k);
-				if (file.write(&d, sizeof(double)) < sizeof(double)) return ec::read_file;
-			}
+			const size_t size = (offsets[i] - position < sizeof(zeros)) ? (size_t)(offsets[i] - position) : sizeof(zeros);
+			if (file.write(zeros, size) < size) return ec::write_file;
+			position += size;
 		}
+		const size_t size = (size_t)_layers[i + 1] * ((_layers[i] + A) / A * A) * sizeof(T);
+		if (file.write(_weights[i].data(0), size) < size) return ec::write_file;
+		position += size;
 	}
 	return ec::ok;
 }
 
 template <class T, size_t A, class F>
 ir::Neuro<T, A, F>::~Neuro() noexcept
-{}
+{
+	//Mapped weights do not own their memory, so order of destruction does not matter
+	if (_mapping != nullptr) delete _mapping;
+}
+
+//=============================================================================================
+
+template <class T, size_t A, class F>
+ir::Neuro<T, A, F>::Inference::Inference() noexcept
+{
+}
+
+template <class T, size_t A, class F>
+ir::ec ir::Neuro<T, A, F>::Inference::init(const Neuro *neuro, uint32 batch) noexcept
+{
+	assert(neuro != nullptr && neuro->ok());
+	assert(batch > 0);
+	finalize();
+	try { _vectors = std::vector<Matrix<T, A>>(neuro->_layers.size()); } catch (...) { return ec::alloc; }
+	for (size_t i = 0; i < neuro->_layers.size(); i++)
+	{
+		if (!_vectors[i].init(batch, neuro->_layers[i])) { finalize(); return ec::alloc; }
+	}
+	_batch = batch;
+	return ec::ok;
+}
+
+template <class T, size_t A, class F>
+bool ir::Neuro<T, A, F>::Inference::ok() const noexcept
+{
+	return _batch != 0;
+}
+
+template <class T, size_t A, class F>
+ir::uint32 ir::Neuro<T, A, F>::Inference::get_batch() const noexcept
+{
+	assert(ok());
+	return _batch;
+}
+
+template <class T, size_t A, class F>
+ir::Matrix<T, A> *ir::Neuro<T, A, F>::Inference::get_input() noexcept
+{
+	assert(ok());
+	return &_vectors.front();
+}
+
+template <class T, size_t A, class F>
+ir::Matrix<T, A> *ir::Neuro<T, A, F>::Inference::get_output() noexcept
+{
+	assert(ok());
+	return &_vectors.back();
+}
+
+template <class T, size_t A, class F>
+void ir::Neuro<T, A, F>::Inference::finalize() noexcept
+{
+	_vectors.clear();
+	_batch = 0;
+}
 
 //=============================================================================================
 
@@ -199,16 +523,24 @@ void ir::Neuro<T, A, F>::_forward(const Matrix<T, A> *w, const Matrix<T, A> *pv,
 {
 	assert(w->width() == pv->width() + 1);
 	assert(w->height() == nv->width());
-	for (size_t row = 0; row < nv->width(); row++)
+	assert(pv->height() == nv->height());
+	if (pv->height() == 1)
 	{
-		Chunk<T, A> sum;
-		for (size_t a = 0; a < A; a++) sum.r[a] = (T)0;
-
-		for (size_t column = 0; column < pv->width(); column += A)
+		const Kernels<T> *kernels = Kernels<T>::get();
+		for (size_t row = 0; row < nv->width(); row++)
+		{
+			nv->at(0, row) = F::function(kernels->dot(pv->width(), w->data(row), pv->data(0)) + w->at(row, pv->width()));
+		}
+	}
+	else
+	{
+		//Batch is multiplied by weights without bias column, bias is added afterwards
+		nv->matrix_product_transposed(pv, w);
+		for (size_t sample = 0; sample < nv->height(); sample++)
 		{
-			sum += w->chunk_at(row, column) * pv->chunk_at(0, column);
+			T *IR_RESTRICT vector = nv->data(sample);
+			for (size_t row = 0; row < nv->width(); row++) vector[row] = F::function(vector[row] + w->at(row, pv->width()));
 		}
-		nv->at(0, row) = F::function(sum.sum() + w->at(row, pv->height()));
 	}
 }
 
@@ -217,12 +549,17 @@ void ir::Neuro<T, A, F>::_lastbackward(const Matrix<T, A> *g, const Matrix<T, A>
 {
 	assert(g->width() == l->width());
 	assert(l->width() == e->width());
-	for (size_t column = 0; column < g->width(); column += A)
+	assert(g->height() == l->height());
+	assert(l->height() == e->height());
+	for (size_t sample = 0; sample < g->height(); sample++)
 	{
-		for (size_t p = 0; p < A; p++)
+		for (size_t column = 0; column < g->width(); column += A)
 		{
-			e->chunk_at(0, column).r[p] = F::derivative(l->chunk_at(0, column).r[p])
-				* (g->chunk_at(0, column).r[p] - l->chunk_at(0, column).r[p]);
+			for (size_t p = 0; p < A; p++)
+			{
+				e->chunk_at(sample, column).r[p] = F::derivative(l->chunk_at(sample, column).r[p])
+					* (g->chunk_at(sample, column).r[p] - l->chunk_at(sample, column).r[p]);
+			}
 		}
 	}
 }
@@ -233,22 +570,29 @@ void ir::Neuro<T, A, F>::_backward(const Matrix<T, A> *w, const Matrix<T, A> *ne
 	assert(w->width() == pv->width() + 1);
 	assert(w->height() == ne->width());
 	assert(pv->width() == pe->width());
-	for (size_t column = 0; column < pe->width(); column++)
+	assert(ne->height() == pv->height());
+	assert(pv->height() == pe->height());
+	if (pv->height() == 1)
 	{
-		Chunk<T, A> sum;
-		for (size_t a = 0; a < A; a++) sum.r[a] = (T)0;
-
-		size_t row = 0;
-		for (; row + A <= w->height(); row += A)
+		//Errors are accumulated row by row, so weights are read sequentially
+		const Kernels<T> *kernels = Kernels<T>::get();
+		T *IR_RESTRICT error = pe->data(0);
+		for (size_t column = 0; column < pe->width(); column++) error[column] = (T)0;
+		for (size_t row = 0; row < w->height(); row++)
 		{
-			sum += w->vertical_chunk_at(row, column) * ne->chunk_at(0, row);
+			kernels->axpy(pe->width(), ne->at(0, row), w->data(row), error);
 		}
-		if (row < w->height())
-		{
-			sum += w->vertical_chunk_at_edge(row, column) * ne->chunk_at(0, row);
-		}
-
-		pe->at(0, column) = F::derivative(pv->at(0, column)) * sum.sum();
+	}
+	else
+	{
+		//Bias column of weights is not propagated
+		pe->matrix_product(ne, w);
+	}
+	for (size_t sample = 0; sample < pe->height(); sample++)
+	{
+		T *IR_RESTRICT error = pe->data(sample);
+		const T *IR_RESTRICT vector = pv->data(sample);
+		for (size_t column = 0; column < pe->width(); column++) error[column] *= F::derivative(vector[column]);
 	}
 }
 
@@ -257,15 +601,386 @@ void ir::Neuro<T, A, F>::_corrigate(T coef, const Matrix<T, A> *pv, const Matrix
 {
 	assert(w->width() == pv->width() + 1);
 	assert(w->height() == ne->width());
+	const Kernels<T> *kernels = Kernels<T>::get();
 	for (size_t row = 0; row < ne->width(); row++)
 	{
-		Chunk<T, A> coef_chunk;
-		for (size_t a = 0; a < A; a++) coef_chunk.r[a] = coef * ne->at(0, row);
+		const T factor = coef * ne->at(0, row);
+		kernels->axpy(pv->width(), factor, pv->data(0), w->data(row));
+		w->at(row, pv->width()) += factor;
+	}
+}
+
+//Fused _backward and _corrigate for one sample, every row of weights is loaded once, used for propagation and then corrected
+template<class T, size_t A, class F>
+void ir::Neuro<T, A, F>::_backward_corrigate(T coef, Matrix<T, A> *w, const Matrix<T, A> *ne, const Matrix<T, A> *pv, Matrix<T, A> *pe) noexcept
+{
+	assert(w->width() == pv->width() + 1);
+	assert(w->height() == ne->width());
+	assert(pv->width() == pe->width());
+	assert(ne->height() == 1 && pv->height() == 1 && pe->height() == 1);
+	const Kernels<T> *kernels = Kernels<T>::get();
+	const size_t n = pv->width();
+	const T *IR_RESTRICT vector = pv->data(0);
+	T *IR_RESTRICT error = pe->data(0);
+	for (size_t column = 0; column < n; column++) error[column] = (T)0;
+	for (size_t row = 0; row < w->height(); row++)
+	{
+		const T next_error = ne->at(0, row);
+		T *IR_RESTRICT weights = w->data(row);
+		kernels->axpy(n, next_error, weights, error);
+		const T factor = coef * next_error;
+		kernels->axpy(n, factor, vector, weights);
+		weights[n] += factor;
+	}
+	for (size_t column = 0; column < n; column++) error[column] *= F::derivative(vector[column]);
+}
+
+template<class T, size_t A, class F>
+void ir::Neuro<T, A, F>::_transpose(const Matrix<T, A> *source, Matrix<T, A> *destination) noexcept
+{
+	assert(source->height() == destination->width());
+	assert(source->width() <= destination->height());
+	for (size_t row = 0; row < source->height(); row++)
+	{
+		const T *IR_RESTRICT s = source->data(row);
+		for (size_t column = 0; column < source->width(); column++) destination->at(column, row) = s[column];
+	}
+}
+
+//Gradient of batch is product of transposed errors and vectors, the samples are summed by the product itself
+//Last row of transposed vectors consists of ones, so last column of gradient is gradient of bias
+template<class T, size_t A, class F>
+void ir::Neuro<T, A, F>::_gradient(const Matrix<T, A> *pv, const Matrix<T, A> *ne, Matrix<T, A> *pvt, Matrix<T, A> *net, Matrix<T, A> *g) noexcept
+{
+	assert(pv->height() == ne->height());
+	assert(pvt->height() == pv->width() + 1);
+	assert(g->height() == ne->width() && g->width() == pv->width() + 1);
+	_transpose(pv, pvt);
+	_transpose(ne, net);
+	g->matrix_product_transposed(net, pvt);
+}
+
+template<class T, size_t A, class F>
+void ir::Neuro<T, A, F>::_corrigate_batch(T coef, const Matrix<T, A> *pv, const Matrix<T, A> *ne,
+	Matrix<T, A> *pvt, Matrix<T, A> *net, Matrix<T, A> *g, Matrix<T, A> *w) noexcept
+{
+	assert(w->width() == pv->width() + 1);
+	assert(w->height() == ne->width());
+	_gradient(pv, ne, pvt, net, g);
+	const Kernels<T> *kernels = Kernels<T>::get();
+	for (size_t row = 0; row < w->height(); row++) kernels->axpy(w->width(), coef, g->data(row), w->data(row));
+}
+
+template<class T, size_t A, class F>
+void ir::Neuro<T, A, F>::_copy(const Matrix<T, A> *source, size_t source_row, Matrix<T, A> *destination, size_t destination_row, size_t count) noexcept
+{
+	assert(source->width() == destination->width());
+	for (size_t row = 0; row < count; row++)
+	{
+		memcpy(destination->data(destination_row + row), source->data(source_row + row), source->width() * sizeof(T));
+	}
+}
+
+template<class T, size_t A, class F>
+void ir::Neuro<T, A, F>::_forward_worker(const void *user, uint32 id, uint32) noexcept
+{
+	Neuro *neuro = (Neuro*)user;
+	if (id >= neuro->_workers.size()) return;
+	Worker *worker = &neuro->_workers[id];
+	const size_t last = neuro->_layers.size() - 1;
+	_copy(&neuro->_vectors[0], worker->begin, &worker->vectors[0], 0, worker->end - worker->begin);
+	for (size_t i = 0; i < last; i++)
+		_forward(&neuro->_weights[i], &worker->vectors[i], &worker->vectors[i + 1]);
+	_copy(&worker->vectors[last], 0, &neuro->_vectors[last], worker->begin, worker->end - worker->begin);
+}
+
+//Works with vectors computed by _forward_worker
+template<class T, size_t A, class F>
+void ir::Neuro<T, A, F>::_backward_worker(const void *user, uint32 id, uint32) noexcept
+{
+	Neuro *neuro = (Neuro*)user;
+	if (id >= neuro->_workers.size()) return;
+	Worker *worker = &neuro->_workers[id];
+	const size_t last = neuro->_layers.size() - 1;
+	_copy(&neuro->_goal, worker->begin, &worker->goal, 0, worker->end - worker->begin);
+	_lastbackward(&worker->goal, &worker->vectors[last], &worker->errors[last - 1]);
+	for (size_t i = last - 1; i > 0; i--)
+		_backward(&neuro->_weights[i], &worker->errors[i], &worker->vectors[i], &worker->errors[i - 1]);
+	for (size_t i = 0; i < last; i++)
+	{
+		if (neuro->_hogwild) _corrigate_batch(neuro->_coefficient / neuro->_batch, &worker->vectors[i], &worker->errors[i],
+			&worker->transposed_vectors[i], &worker->transposed_errors[i], &worker->gradients[i], &neuro->_weights[i]);
+		else _gradient(&worker->vectors[i], &worker->errors[i], &worker->transposed_vectors[i], &worker->transposed_errors[i], &worker->gradients[i]);
+	}
+}
+
+//Rows of all layers are numbered one after another
+//Gradients of threads are summed pairwise (tree reduction) into gradient of first thread, then their mean is added to weights
+template<class T, size_t A, class F>
+void ir::Neuro<T, A, F>::_reduce(const void *user, uint32, size_t begin, size_t end) noexcept
+{
+	Neuro *neuro = (Neuro*)user;
+	const Kernels<T> *kernels = Kernels<T>::get();
+	const size_t n = neuro->_workers.size();
+	size_t layer = 0;
+	size_t first = 0;
+	for (size_t index = begin; index < end; index++)
+	{
+		while (index - first >= neuro->_layers[layer + 1]) { first += neuro->_layers[layer + 1]; layer++; }
+		const size_t row = index - first;
+		const size_t width = neuro->_layers[layer] + 1;
+		for (size_t stride = 1; stride < n; stride *= 2)
+		{
+			for (size_t id = 0; id + stride < n; id += 2 * stride)
+			{
+				kernels->axpy(width, (T)1, neuro->_workers[id + stride].gradients[layer].data(row), neuro->_workers[id].gradients[layer].data(row));
+			}
+		}
+		kernels->axpy(width, neuro->_coefficient / neuro->_batch, neuro->_workers[0].gradients[layer].data(row), neuro->_weights[layer].data(row));
+	}
+}
+
+//=============================================================================================
+
+template <class T, size_t A, class F>
+inline ir::int8 ir::Int8Neuro<T, A, F>::_quantize(T value) noexcept
+{
+	//-128 is not used, so integer kernels can move sign between operands
+	if (value >= (T)127) return 127;
+	if (value <= (T)-127) return -127;
+	return (int8)(value >= 0 ? value + (T)0.5 : value - (T)0.5);
+}
+
+template <class T, size_t A, class F>
+ir::Int8Neuro<T, A, F>::Int8Neuro() noexcept
+{
+}
+
+template <class T, size_t A, class F>
+ir::ec ir::Int8Neuro<T, A, F>::init(const Neuro<T, A, F> *neuro, uint32 batch) noexcept
+{
+	assert(neuro != nullptr && neuro->ok());
+	assert(batch > 0);
+	finalize();
+	const size_t count = neuro->_layers.size();
+	try
+	{
+		_layers = neuro->_layers;
+		_weights = std::vector<Matrix<int8, 64>>(count - 1);
+		_scales = std::vector<std::vector<T>>(count - 1);
+		_biases = std::vector<std::vector<T>>(count - 1);
+		_vectors = std::vector<Matrix<T, A>>(count);
+		for (size_t i = 0; i < count - 1; i++)
+		{
+			_scales[i].resize(_layers[i + 1]);
+			_biases[i].resize(_layers[i + 1]);
+		}
+	}
+	catch (...) { finalize(); return ec::alloc; }
+	for (size_t i = 0; i < count; i++)
+	{
+		if (!_vectors[i].init(batch, _layers[i])) { finalize(); return ec::alloc; }
+	}
+
+	//Weights are quantized symmetrically, maximal absolute value of row becomes 127
+	uint32 widest = 0;
+	for (size_t i = 0; i < count - 1; i++)
+	{
+		const Matrix<T, A> *w = &neuro->_weights[i];
+		const uint32 n = _layers[i];
+		if (n > widest) widest = n;
+		if (!_weights[i].init(_layers[i + 1], n)) { finalize(); return ec::alloc; }
+		for (size_t row = 0; row < _layers[i + 1]; row++)
+		{
+			T maximum = (T)0;
+			for (size_t column = 0; column < n; column++) if (fabs(w->at(row, column)) > maximum) maximum = (T)fabs(w->at(row, column));
+			const T scale = (maximum > (T)0) ? maximum / (T)127 : (T)1;
+			int8 *IR_RESTRICT quantized = _weights[i].data(row);
+			for (size_t column = 0; column < n; column++) quantized[column] = _quantize(w->at(row, column) / scale);
+			_scales[i][row] = scale;
+			_biases[i][row] = w->at(row, n);
+		}
+	}
+	if (!_quantized.init(1, widest)) { finalize(); return ec::alloc; }
+	_ok = true;
+	return ec::ok;
+}
+
+template <class T, size_t A, class F>
+bool ir::Int8Neuro<T, A, F>::ok() const noexcept
+{
+	return _ok;
+}
+
+template <class T, size_t A, class F>
+ir::uint32 ir::Int8Neuro<T, A, F>::get_batch() const noexcept
+{
+	assert(_ok);
+	return (uint32)_vectors[0].height();
+}
+
+template <class T, size_t A, class F>
+ir::Matrix<T, A> *ir::Int8Neuro<T, A, F>::get_input() noexcept
+{
+	assert(_ok);
+	return &_vectors.front();
+}
+
+template <class T, size_t A, class F>
+ir::Matrix<T, A> *ir::Int8Neuro<T, A, F>::get_output() noexcept
+{
+	assert(_ok);
+	return &_vectors.back();
+}
+
+template <class T, size_t A, class F>
+void ir::Int8Neuro<T, A, F>::forward() noexcept
+{
+	assert(_ok);
+	const Int8Kernels *kernels = Int8Kernels::get();
+	for (size_t i = 0; i < _layers.size() - 1; i++)
+	{
+		//Rows are padded with zeros to whole cache lines, so kernels process them without tails
+		const size_t n = _layers[i];
+		const size_t padded = (n + 63) / 64 * 64;
+		for (size_t sample = 0; sample < _vectors[i].height(); sample++)
+		{
+			const T *IR_RESTRICT input = _vectors[i].data(sample);
+			T maximum = (T)0;
+			for (size_t column = 0; column < n; column++) if (fabs(input[column]) > maximum) maximum = (T)fabs(input[column]);
+			const T scale = (maximum > (T)0) ? maximum / (T)127 : (T)1;
+			const T inverse = (T)1 / scale;
+			int8 *IR_RESTRICT quantized = _quantized.data(0);
+			for (size_t column = 0; column < n; column++) quantized[column] = _quantize(input[column] * inverse);
+
+			T *IR_RESTRICT output = _vectors[i + 1].data(sample);
+			const T *IR_RESTRICT scales = _scales[i].data();
+			const T *IR_RESTRICT biases = _biases[i].data();
+			for (size_t row = 0; row < _layers[i + 1]; row++)
+			{
+				const int32 sum = kernels->dot(padded, _weights[i].data(row), quantized);
+				output[row] = F::function((T)sum * scale * scales[row] + biases[row]);
+			}
+		}
+	}
+}
+
+template <class T, size_t A, class F>
+void ir::Int8Neuro<T, A, F>::finalize() noexcept
+{
+	_ok = false;
+	_layers.clear();
+	_weights.clear();
+	_scales.clear();
+	_biases.clear();
+	_vectors.clear();
+	_quantized.finalize();
+}
+
+//=============================================================================================
+
+template <class T, size_t A, class F, class H>
+ir::HalfNeuro<T, A, F, H>::HalfNeuro() noexcept
+{
+}
+
+template <class T, size_t A, class F, class H>
+ir::ec ir::HalfNeuro<T, A, F, H>::init(const Neuro<T, A, F> *neuro, uint32 batch) noexcept
+{
+	assert(neuro != nullptr && neuro->ok());
+	assert(batch > 0);
+	finalize();
+	const size_t count = neuro->_layers.size();
+	try
+	{
+		_layers = neuro->_layers;
+		_weights = std::vector<Matrix<H, 32>>(count - 1);
+		_biases = std::vector<std::vector<float>>(count - 1);
+		_vectors = std::vector<Matrix<T, A>>(count);
+		for (size_t i = 0; i < count - 1; i++) _biases[i].resize(_layers[i + 1]);
+	}
+	catch (...) { finalize(); return ec::alloc; }
+	for (size_t i = 0; i < count; i++)
+	{
+		if (!_vectors[i].init(batch, _layers[i])) { finalize(); return ec::alloc; }
+	}
+	uint32 widest = 0;
+	for (size_t i = 0; i < count - 1; i++) if (_layers[i] > widest) widest = _layers[i];
+	if (!_input.init(1, widest)) { finalize(); return ec::alloc; }
 
-		for (size_t column = 0; column < pv->height(); column += A)
+	//Weights of any T are converted through float
+	for (size_t i = 0; i < count - 1; i++)
+	{
+		const Matrix<T, A> *w = &neuro->_weights[i];
+		const uint32 n = _layers[i];
+		if (!_weights[i].init(_layers[i + 1], n)) { finalize(); return ec::alloc; }
+		for (size_t row = 0; row < _layers[i + 1]; row++)
 		{
-			w->chunk_at(row, column) += coef_chunk * pv->chunk_at(0, column);
+			simd_kernels::convert(n, w->data(row), _input.data(0));
+			simd_kernels::convert(n, _input.data(0), _weights[i].data(row));
+			_biases[i][row] = (float)w->at(row, n);
 		}
-		w->at(row, pv->height()) += coef * ne->at(0, row);
 	}
-}
\ No newline at end of file
+	_ok = true;
+	return ec::ok;
+}
+
+template <class T, size_t A, class F, class H>
+bool ir::HalfNeuro<T, A, F, H>::ok() const noexcept
+{
+	return _ok;
+}
+
+template <class T, size_t A, class F, class H>
+ir::uint32 ir::HalfNeuro<T, A, F, H>::get_batch() const noexcept
+{
+	assert(_ok);
+	return (uint32)_vectors[0].height();
+}
+
+template <class T, size_t A, class F, class H>
+ir::Matrix<T, A> *ir::HalfNeuro<T, A, F, H>::get_input() noexcept
+{
+	assert(_ok);
+	return &_vectors.front();
+}
+
+template <class T, size_t A, class F, class H>
+ir::Matrix<T, A> *ir::HalfNeuro<T, A, F, H>::get_output() noexcept
+{
+	assert(_ok);
+	return &_vectors.back();
+}
+
+template <class T, size_t A, class F, class H>
+void ir::HalfNeuro<T, A, F, H>::forward() noexcept
+{
+	assert(_ok);
+	const HalfKernels<H> *kernels = HalfKernels<H>::get();
+	for (size_t i = 0; i < _layers.size() - 1; i++)
+	{
+		const size_t n = _layers[i];
+		for (size_t sample = 0; sample < _vectors[i].height(); sample++)
+		{
+			float *IR_RESTRICT input = _input.data(0);
+			simd_kernels::convert(n, _vectors[i].data(sample), input);
+			T *IR_RESTRICT output = _vectors[i + 1].data(sample);
+			const float *IR_RESTRICT biases = _biases[i].data();
+			for (size_t row = 0; row < _layers[i + 1]; row++)
+			{
+				output[row] = F::function((T)(kernels->dot(n, _weights[i].data(row), input) + biases[row]));
+			}
+		}
+	}
+}
+
+template <class T, size_t A, class F, class H>
+void ir::HalfNeuro<T, A, F, H>::finalize() noexcept
+{
+	_ok = false;
+	_layers.clear();
+	_weights.clear();
+	_biases.clear();
+	_vectors.clear();
+	_input.finalize();
+}
@@ -0,0 +1,159 @@
+/*
+	Part of the Ironic Project. Distributed under MIT License, which means:
+		- Do whatever you want
+		- Keep this notice and include the license file to your project
+		- I provide no warranty
+	To get help with installation, visit README
+	Created by Kyrylo Sovailo, github.com/Meta-chan, k.sovailo@gmail.com
+	Reinventing bicycles since 2020
+*/
+
+#include <stdlib.h>
+#include <new>
+
+template<class T>
+ir::QuietAtomicRing<T>::QuietAtomicRing() noexcept
+{
+	_head = 0;
+	_tail = 0;
+}
+
+template<class T>
+ir::QuietAtomicRing<T>::QuietAtomicRing(size_t size) noexcept
+{
+	_head = 0;
+	_tail = 0;
+	init(size);
+}
+
+template<class T>
+bool ir::QuietAtomicRing<T>::init(size_t size) noexcept
+{
+	clear();
+	if (size == 0) return false;
+	size_t newsize = 1;
+	while (newsize < size) newsize *= 2;
+	_data = (Cell*)malloc(newsize * sizeof(Cell));
+	if (_data == nullptr) return false;
+	for (size_t i = 0; i < newsize; i++)
+	{
+		new(&_data[i].sequence) std::atomic<size_t>(i);
+		new(&_data[i].data) T();
+	}
+	_size = newsize;
+	return true;
+}
+
+template<class T>
+bool ir::QuietAtomicRing<T>::ok() const noexcept
+{
+	return _data != nullptr;
+}
+
+template<class T>
+bool ir::QuietAtomicRing<T>::write(const T &data) noexcept
+{
+	return write(1, &data) == 1;
+}
+
+template<class T>
+size_t ir::QuietAtomicRing<T>::write(size_t count, const T *data) noexcept
+{
+	if (_data == nullptr || count == 0) return 0;
+	size_t position = _head.load(std::memory_order_relaxed);
+	while (true)
+	{
+		//Counting free cells after head, they can be taken only by moving head
+		size_t free = 0;
+		while (free < count && free < _size
+		&& _data[(position + free) & (_size - 1)].sequence.load(std::memory_order_acquire) == position + free) free++;
+		
+		if (free == 0)
+		{
+			const size_t sequence = _data[position & (_size - 1)].sequence.load(std::memory_order_acquire);
+			if ((ptrdiff_t)(sequence - position) < 0) return 0;	//Full
+			position = _head.load(std::memory_order_relaxed);	//Other writer was faster
+		}
+		else if (_head.compare_exchange_weak(position, position + free, std::memory_order_relaxed))
+		{
+			for (size_t i = 0; i < free; i++)
+			{
+				Cell *cell = &_data[(position + i) & (_size - 1)];
+				cell->data = data[i];
+				cell->sequence.store(position + i + 1, std::memory_order_release);
+			}
+			return free;
+		}
+	}
+}
+
+template<class T>
+bool ir::QuietAtomicRing<T>::read(T *data) noexcept
+{
+	return read(1, data) == 1;
+}
+
+template<class T>
+size_t ir::QuietAtomicRing<T>::read(size_t count, T *data) noexcept
+{
+	if (_data == nullptr || count == 0) return 0;
+	size_t position = _tail.load(std::memory_order_relaxed);
+	while (true)
+	{
+		//Counting written cells after tail, they can be taken only by moving tail
+		size_t written = 0;
+		while (written < count && written < _size
+		&& _data[(position + written) & (_size - 1)].sequence.load(std::memory_order_acquire) == position + written + 1) written++;
+
+		if (written == 0)
+		{
+			const size_t sequence = _data[position & (_size - 1)].sequence.load(std::memory_order_acquire);
+			if ((ptrdiff_t)(sequence - (position + 1)) < 0) return 0;	//Empty
+			position = _tail.load(std::memory_order_relaxed);			//Other reader was faster
+		}
+		else if (_tail.compare_exchange_weak(position, position + written, std::memory_order_relaxed))
+		{
+			for (size_t i = 0; i < written; i++)
+			{
+				Cell *cell = &_data[(position + i) & (_size - 1)];
+				data[i] = cell->data;
+				cell->sequence.store(position + i + _size, std::memory_order_release);
+			}
+			return written;
+		}
+	}
+}
+
+template<class T>
+size_t ir::QuietAtomicRing<T>::count() const noexcept
+{
+	const size_t head = _head.load(std::memory_order_relaxed);
+	const size_t tail = _tail.load(std::memory_order_relaxed);
+	return ((ptrdiff_t)(head - tail) > 0) ? head - tail : 0;
+}
+
+template<class T>
+size_t ir::QuietAtomicRing<T>::size() const noexcept
+{
+	return _size;
+}
+
+template<class T>
+void ir::QuietAtomicRing<T>::clear() noexcept
+{
+	if (_data != nullptr)
+	{
+		for (size_t i = 0; i < _size; i++) _data[i].data.~T();
+		free(_data);
+		_data = nullptr;
+	}
+	_size = 0;
+	_head = 0;
+	_tail = 0;
+}
+
+template<class T>
+ir::QuietAtomicRing<T>::~QuietAtomicRing() noexcept
+{
+	clear();
+}
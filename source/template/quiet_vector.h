@@ -36,13 +36,15 @@ bool ir::QuietVector<T>::_detach(size_t newcapacity) noexcept
 	else if (_header->refcount == 1)
 	{
 		//TODO: Should allocate more memory then needed
-		if (newcapacity < _header->capacity)
+		if (newcapacity > _header->capacity)
 		{
-			_header = (Header*)realloc(_header, sizeof(Header) + newcapacity * sizeof(T));
+			Header *newheader = (Header*)realloc(_header, sizeof(Header) + newcapacity * sizeof(T));
+			if (newheader == nullptr) return false;
+			_header = newheader;
 			#ifdef _DEBUG
-				_debugarray = _header == nullptr ? nullptr : (T*)(_header + 1);
+				_debugarray = (T*)(_header + 1);
 			#endif
-			if (_header == nullptr) return false;
+			_header->capacity = newcapacity;
 		}
 	}
 	else